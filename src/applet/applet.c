@@ -48,9 +48,21 @@
 
 #define NOTIFICATION_ICON_NAME "face-sad-symbolic"
 
+/* Crash signals received within this window are processed together */
+#define CRASH_BATCH_WINDOW_MS 500
+/* Process the batch immediately once it grows to this size */
+#define CRASH_BATCH_MAX_SIZE 50
+/* Maximum number of simultaneously running event handler children */
+#define MAX_EVENT_CHILDREN 2
+
 static GNetworkMonitor *netmon;
 static GList *g_deferred_crash_queue;
 static guint g_deferred_timeout;
+static GList *g_crash_batch;
+static guint g_crash_batch_size;
+static guint g_crash_batch_timeout;
+static GQueue g_pending_events = G_QUEUE_INIT;
+static unsigned g_running_event_children;
 static bool g_gnome_abrt_available;
 static bool g_user_is_admin;
 
@@ -312,6 +324,7 @@ static problem_info_t* problem_info_ref(problem_info_t *pi)
 }
 
 static void run_event_async(problem_info_t *pi, const char *event_name);
+static void start_pending_events(void);
 
 struct event_processing_state
 {
@@ -879,6 +892,9 @@ static gboolean handle_event_output_cb(GIOChannel *gio, GIOCondition condition,
     /* We stop using this channel */
     g_io_channel_unref(gio);
 
+    --g_running_event_children;
+    start_pending_events();
+
     return FALSE;
 }
 
@@ -922,7 +938,7 @@ static void export_event_configuration(const char *event_name)
     g_list_free(ex_env);
 }
 
-static void run_event_async(problem_info_t *pi, const char *event_name)
+static void start_event_async(problem_info_t *pi, const char *event_name)
 {
     if (!problem_info_ensure_writable(pi))
     {
@@ -937,11 +953,47 @@ static void run_event_async(problem_info_t *pi, const char *event_name)
 
     state->child_pid = spawn_event_handler_child(problem_info_get_dir(state->pi), event_name, &state->child_stdout_fd);
 
+    ++g_running_event_children;
+
     GIOChannel *channel_event_output = my_io_channel_unix_new(state->child_stdout_fd);
     g_io_add_watch(channel_event_output, G_IO_IN | G_IO_PRI | G_IO_HUP,
                    handle_event_output_cb, state);
 }
 
+struct pending_event
+{
+    problem_info_t *pi;
+    char *event_name;
+};
+
+/* Starts the queued events while there are free slots */
+static void start_pending_events(void)
+{
+    while (g_running_event_children < MAX_EVENT_CHILDREN && !g_queue_is_empty(&g_pending_events))
+    {
+        struct pending_event *pending = g_queue_pop_head(&g_pending_events);
+        start_event_async(pending->pi, pending->event_name);
+        free(pending->event_name);
+        free(pending);
+    }
+}
+
+/* Crash storms would fork one event handler per problem, hence the number of
+ * simultaneously running children is limited and the rest is queued.
+ */
+static void run_event_async(problem_info_t *pi, const char *event_name)
+{
+    struct pending_event *pending = xmalloc(sizeof(*pending));
+    pending->pi = pi;
+    pending->event_name = xstrdup(event_name);
+    g_queue_push_tail(&g_pending_events, pending);
+
+    log_debug("Queued event '%s' for '%s' (%u running)", event_name,
+            problem_info_get_dir(pi), g_running_event_children);
+
+    start_pending_events();
+}
+
 /*
  * Destroys the problems argument
  */
@@ -984,12 +1036,76 @@ static void show_problem_list_notification(GList *problems)
         notify_problem_list(problems);
 }
 
-static void show_problem_notification(problem_info_t *pi)
+static const char *g_crash_elements[] = {
+    FILENAME_CMDLINE,
+    FILENAME_COUNT,
+    FILENAME_UUID,
+    FILENAME_DUPHASH,
+    FILENAME_COMPONENT,
+    FILENAME_ENVIRON,
+    FILENAME_PID,
+    NULL,
+};
+
+/* Loads the problem data of all batched problems with a single D-Bus call
+ * and shows the notifications.
+ */
+static void process_crash_batch(void)
 {
-    GList *problems = g_list_append(NULL, pi);
+    GList *problems = g_list_reverse(g_crash_batch);
+    g_crash_batch = NULL;
+    g_crash_batch_size = 0;
+
+    if (problems == NULL)
+        return;
+
+    log_debug("Processing %u batched crashes", g_list_length(problems));
+
+    GList *problem_ids = NULL;
+    for (GList *iter = problems; iter; iter = g_list_next(iter))
+        problem_ids = g_list_prepend(problem_ids, (gpointer)problem_info_get_dir(iter->data));
+
+    GHashTable *problems_data = get_problems_data_over_dbus(problem_ids, g_crash_elements);
+    g_list_free(problem_ids);
+
+    for (GList *iter = problems; iter; iter = g_list_next(iter))
+    {
+        problem_info_t *pi = iter->data;
+        const char *dir = problem_info_get_dir(pi);
+
+        if (problems_data == ERR_PTR)
+        {
+            /* Older abrt-dbus, fall back to one call per problem */
+            fill_problem_data_over_dbus(dir, g_crash_elements, pi->problem_data);
+            continue;
+        }
+
+        problem_data_t *pd = g_hash_table_lookup(problems_data, dir);
+        if (pd == NULL)
+            continue;
+
+        GHashTableIter pd_iter;
+        char *name;
+        struct problem_item *item;
+        g_hash_table_iter_init(&pd_iter, pd);
+        while (g_hash_table_iter_next(&pd_iter, (gpointer *)&name, (gpointer *)&item))
+            problem_data_add_text_noteditable(pi->problem_data, name, item->content);
+    }
+
+    if (problems_data != ERR_PTR)
+        g_hash_table_destroy(problems_data);
+
     show_problem_list_notification(problems);
 }
 
+static gboolean crash_batch_timeout_fn(gpointer user_data)
+{
+    g_crash_batch_timeout = 0;
+    process_crash_batch();
+
+    return G_SOURCE_REMOVE;
+}
+
 static void Crash(GVariant *parameters)
 {
     const char *package_name, *dir, *uid_str, *uuid, *duphash;
@@ -1020,19 +1136,7 @@ static void Crash(GVariant *parameters)
     if (foreign_problem && !g_user_is_admin)
         return;
 
-    static const char *elements[] = {
-        FILENAME_CMDLINE,
-        FILENAME_COUNT,
-        FILENAME_UUID,
-        FILENAME_DUPHASH,
-        FILENAME_COMPONENT,
-        FILENAME_ENVIRON,
-        FILENAME_PID,
-        NULL,
-    };
-
     problem_info_t *pi = problem_info_new(dir);
-    fill_problem_data_over_dbus(dir, elements, pi->problem_data);
 
     pi->foreign = foreign_problem;
     pi->is_packaged = (package_name != NULL);
@@ -1043,7 +1147,20 @@ static void Crash(GVariant *parameters)
      * append_dirlist(dir);
      *
      */
-    show_problem_notification(pi);
+
+    /* Crash signals come in storms, load data and notify in batches */
+    g_crash_batch = g_list_prepend(g_crash_batch, pi);
+    if (++g_crash_batch_size >= CRASH_BATCH_MAX_SIZE)
+    {
+        if (g_crash_batch_timeout != 0)
+        {
+            g_source_remove(g_crash_batch_timeout);
+            g_crash_batch_timeout = 0;
+        }
+        process_crash_batch();
+    }
+    else if (g_crash_batch_timeout == 0)
+        g_crash_batch_timeout = g_timeout_add(CRASH_BATCH_WINDOW_MS, crash_batch_timeout_fn, NULL);
 }
 
 static void handle_message(GDBusConnection *connection,
@@ -0,0 +1,152 @@
+import os
+import json
+import logging
+import tempfile
+
+import problem
+import problem.config
+from problem import tools
+
+from abrtcli.utils import HUMAN_IDENTIFIER_FIELDS
+
+INDEX_VERSION = 1
+
+# fields stored in the index, enough to create problem objects
+# and to compute their human identifiers without asking the daemon
+INDEX_FIELDS = ['reason'] + HUMAN_IDENTIFIER_FIELDS
+
+
+def get_index_path(auth=False):
+    '''
+    Return path of the completion index file in user's cache directory
+    '''
+
+    cache_dir = os.environ.get('XDG_CACHE_HOME',
+                               os.path.expanduser('~/.cache'))
+    name = 'cli-index-all.json' if auth else 'cli-index.json'
+    return os.path.join(cache_dir, 'abrt', name)
+
+
+def get_dump_location():
+    '''
+    Return dump location configured in abrt.conf
+    '''
+
+    try:
+        conf = problem.load_conf_file('abrt.conf')
+    except OSError:
+        conf = {}
+
+    return conf.get('DumpLocation', problem.config.DEFAULT_DUMP_LOCATION)
+
+
+def get_mtime(path):
+    '''
+    Return modification time of `path` or None
+    '''
+
+    try:
+        return os.stat(path).st_mtime
+    except OSError:
+        return None
+
+
+def load(auth=False):
+    '''
+    Return problems stored in the completion index or None if the
+    index does not exist or is out of date
+
+    Creating or deleting a problem changes modification time of the
+    dump location, modifying a problem changes modification time
+    of its directory.
+    '''
+
+    try:
+        with open(get_index_path(auth)) as index_file:
+            index = json.load(index_file)
+    except (IOError, OSError, ValueError):
+        return None
+
+    try:
+        if index['version'] != INDEX_VERSION:
+            return None
+
+        dump_location = get_dump_location()
+        if (index['dump_location'] != dump_location or
+                index['mtime'] != get_mtime(dump_location)):
+            return None
+
+        for entry in index['problems']:
+            if entry['mtime'] != get_mtime(entry['path']):
+                return None
+
+        proxy = problem.proxies.get_proxy()
+        return [tools.problemify(entry['path'], proxy, entry['data'])
+                for entry in index['problems']]
+    except (KeyError, TypeError):
+        return None
+
+
+def save(probs, dump_location, mtime, auth=False):
+    '''
+    Store `probs` listed from `dump_location` modified at `mtime`
+    in the completion index
+    '''
+
+    index = {
+        'version': INDEX_VERSION,
+        'dump_location': dump_location,
+        'mtime': mtime,
+        'problems': [],
+    }
+
+    for prob in probs:
+        # not saved yet, hence not in the dump location either
+        if not prob.path:
+            continue
+
+        data = {}
+        for field in INDEX_FIELDS:
+            try:
+                data[field] = str(getattr(prob, field))
+            except AttributeError:
+                data[field] = None
+
+        index['problems'].append({
+            'path': prob.path,
+            'mtime': get_mtime(prob.path),
+            'data': data,
+        })
+
+    index_path = get_index_path(auth)
+    try:
+        index_dir = os.path.dirname(index_path)
+        if not os.path.isdir(index_dir):
+            os.makedirs(index_dir, 0o700)
+
+        fd, tmp_path = tempfile.mkstemp(dir=index_dir)
+        with os.fdopen(fd, 'w') as index_file:
+            json.dump(index, index_file)
+        os.rename(tmp_path, index_path)
+    except (IOError, OSError) as ex:
+        logging.debug('Unable to save completion index: {0}'.format(ex))
+
+
+def list_problems(auth=False):
+    '''
+    Return the list of the problems, from the completion index
+    if it is up to date
+    '''
+
+    probs = load(auth)
+    if probs is not None:
+        return probs
+
+    # stat before listing, a problem created meanwhile
+    # makes the saved index out of date
+    dump_location = get_dump_location()
+    mtime = get_mtime(dump_location)
+
+    probs = problem.list(auth=auth, prefetch=INDEX_FIELDS)
+    save(probs, dump_location, mtime, auth)
+    return probs
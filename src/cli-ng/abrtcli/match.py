@@ -1,6 +1,7 @@
 import sys
 import problem
 
+from abrtcli import index
 from abrtcli.l18n import _
 from abrtcli.utils import get_human_identifier, sort_problems
 
@@ -16,7 +17,7 @@ def get_match_data(auth=False):
     by_human_id = {}
     by_short_id = {}
 
-    for prob in problem.list(auth=auth):
+    for prob in index.list_problems(auth=auth):
         comp_or_exe, val = get_human_identifier(prob)
 
         if val in by_human_id:
@@ -84,7 +85,7 @@ def match_get_problem(problem_match, allow_multiple=False, auth=False):
 
     prob = None
     if problem_match == 'last':
-        probs = sort_problems(problem.list(auth=auth))
+        probs = sort_problems(problem.list(auth=auth, prefetch=['time']))
         if not probs:
             print(_('No problems'))
             sys.exit(0)
@@ -10,6 +10,7 @@ except ImportError:
 
 from abrtcli.l18n import _
 from abrtcli.config import MEDIUM_FMT
+import problem
 import report
 
 braces_re = re.compile(r'\{([^}]+)\}')
@@ -170,15 +171,16 @@ def get_problem_field(prob, field):
         return
 
 
+HUMAN_IDENTIFIER_FIELDS = ['component', 'executable', 'type']
+
+
 def get_human_identifier(prob):
     '''
     Return first found problem field from list of candidate fields
     that will be used as a problem identifier for humans
     '''
 
-    candidates = ['component', 'executable', 'type']
-
-    for c in candidates:
+    for c in HUMAN_IDENTIFIER_FIELDS:
         val = get_problem_field(prob, c)
         if val:
             return c, val
@@ -191,6 +193,9 @@ def sort_problems(probs, recent_first=True):
     Sort problems by time, `recent_first` by default
     '''
 
+    # load time of all problems at once instead of one by one
+    probs = list(probs)
+    problem.prefetch(probs, ['time'])
     return sorted(probs, key=lambda p: p.time, reverse=recent_first)
 
 
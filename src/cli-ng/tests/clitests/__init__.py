@@ -5,6 +5,7 @@ try:
 except ImportError:
     import unittest
 import contextlib
+import tempfile
 
 cpath = os.path.dirname(os.path.realpath(__file__))
 # alter path so we can import cli
@@ -15,12 +16,18 @@ sys.path.insert(0, abrtcli_path)
 sys.path.insert(0, problem_path)
 sys.path.insert(0, pyabrt_path)
 os.environ["PATH"] = "{0}:{1}".format(abrtcli_path, os.environ["PATH"])
+# never use completion index of the user running the tests
+os.environ["XDG_CACHE_HOME"] = tempfile.mkdtemp()
 
 import problem
 from .fake_problems import get_fake_problems
 
 problem.list = get_fake_problems
 
+# fake problems are not stored in the completion index
+from abrtcli import index
+index.list_problems = lambda auth=False: problem.list(auth=auth)
+
 
 
 @contextlib.contextmanager
@@ -0,0 +1,100 @@
+#!/usr/bin/python
+# -*- encoding: utf-8 -*-
+import logging
+try:
+    import unittest2 as unittest
+except ImportError:
+    import unittest
+
+import os
+import shutil
+import tempfile
+
+import clitests
+
+import problem
+from problem import tools
+
+from abrtcli import index
+
+from clitests.fake_problems import FakeProxy
+
+
+class IndexTestCase(clitests.TestCase):
+    '''
+    Tests for the completion index
+    '''
+
+    def setUp(self):
+        self.dump_location = tempfile.mkdtemp()
+        self.probs = []
+        for name, comp in [('ccpp-1', 'pavucontrol'), ('ccpp-2', None)]:
+            path = os.path.join(self.dump_location, name)
+            os.mkdir(path)
+            data = {'type': problem.CCPP, 'reason': name, 'component': comp}
+            self.probs.append(tools.problemify(path, FakeProxy(), data))
+
+    def tearDown(self):
+        shutil.rmtree(self.dump_location)
+
+    def save_and_load(self, modify=None):
+        with clitests.monkey_patch(index, 'get_dump_location',
+                                   lambda: self.dump_location):
+            with clitests.monkey_patch(problem.proxies, 'get_proxy',
+                                       FakeProxy):
+                index.save(self.probs, self.dump_location,
+                           index.get_mtime(self.dump_location))
+                if modify:
+                    modify()
+                return index.load()
+
+    def test_index_roundtrip(self):
+        '''
+        Test that problems are loaded from an up to date index
+        '''
+
+        loaded = self.save_and_load()
+        self.assertEqual([p.path for p in loaded],
+                         [p.path for p in self.probs])
+        self.assertEqual([p.short_id for p in loaded],
+                         [p.short_id for p in self.probs])
+        self.assertEqual(loaded[0].component, 'pavucontrol')
+        self.assertFalse(hasattr(loaded[1], 'component'))
+
+    def test_index_unsaved_problem(self):
+        '''
+        Test that problems which are not saved are left out of the index
+        '''
+
+        unsaved = problem.Runtime(reason='Front fell off')
+        self.probs.append(unsaved)
+
+        loaded = self.save_and_load()
+        self.assertEqual([p.path for p in loaded],
+                         [p.path for p in self.probs[:-1]])
+
+    def test_index_new_problem(self):
+        '''
+        Test that a new problem invalidates the index
+        '''
+
+        def create():
+            os.mkdir(os.path.join(self.dump_location, 'ccpp-3'))
+            os.utime(self.dump_location, (0, 0))
+
+        self.assertIsNone(self.save_and_load(create))
+
+    def test_index_modified_problem(self):
+        '''
+        Test that modification of a problem invalidates the index
+        '''
+
+        def modify():
+            os.utime(self.probs[0].path, (0, 0))
+
+        self.assertIsNone(self.save_and_load(modify))
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    unittest.main()
@@ -196,23 +196,97 @@ static void dup_corebt_fini(void)
     corebt = NULL;
 }
 
+/* Returns the real path of dump_dir_name2 if it is a duplicate of
+ * dump_dir_name, NULL otherwise.
+ */
+static char *is_dup_of(const char *dump_dir_name, const char *dump_dir_name2_path)
+{
+    char *crash_dump_dup = NULL;
+    struct dump_dir *dd = NULL;
+
+    char *dump_dir_name2 = realpath(dump_dir_name2_path, NULL);
+    if (g_verbose > 1 && !dump_dir_name2)
+        perror_msg("realpath(%s)", dump_dir_name2_path);
+
+    if (!dump_dir_name2)
+        return NULL;
+
+    char *dd_uid = NULL, *dd_type = NULL;
+    char *dd_executable = NULL;
+
+    if (strcmp(dump_dir_name, dump_dir_name2) == 0)
+        goto next; /* we are never a dup of ourself */
+
+    int sv_logmode = logmode;
+    /* Silently ignore any error in the silent log level. */
+    logmode = g_verbose == 0 ? 0 : sv_logmode;
+    dd = dd_opendir(dump_dir_name2, /*flags:*/ DD_FAIL_QUIETLY_ENOENT | DD_OPEN_READONLY);
+    logmode = sv_logmode;
+    if (!dd)
+        goto next;
+
+    /* crashes of different users are not considered duplicates */
+    dd_uid = dd_load_text_ext(dd, FILENAME_UID, DD_FAIL_QUIETLY_ENOENT);
+    if (strcmp(uid, dd_uid))
+    {
+        goto next;
+    }
+
+    /* different crash types are not duplicates */
+    dd_type = dd_load_text_ext(dd, FILENAME_TYPE, DD_FAIL_QUIETLY_ENOENT);
+    if (strcmp(type, dd_type))
+    {
+        goto next;
+    }
+
+    /* different executables are not duplicates */
+    dd_executable = dd_load_text_ext(dd, FILENAME_EXECUTABLE, DD_FAIL_QUIETLY_ENOENT);
+    if (     (executable != NULL && dd_executable == NULL)
+         ||  (executable == NULL && dd_executable != NULL)
+         || ((executable != NULL && dd_executable != NULL)
+              && strcmp(executable, dd_executable) != 0))
+    {
+        goto next;
+    }
+
+    if (dup_uuid_compare(dd)
+     || dup_corebt_compare(dd)
+    ) {
+        crash_dump_dup = dump_dir_name2;
+        dump_dir_name2 = NULL;
+    }
+
+next:
+    free(dump_dir_name2);
+    dd_close(dd);
+    free(dd_uid);
+    free(dd_type);
+    free(dd_executable);
+
+    return crash_dump_dup;
+}
+
 /* This function is run after each post-create event is finished (there may be
  * multiple such events).
  *
  * It first checks if there is CORE_BACKTRACE or UUID item in the dump dir
  * we are processing.
  *
- * If there is a CORE_BACKTRACE, it iterates over all other dump
- * directories and computes similarity to their core backtraces (if any).
- * If one of them is similar enough to be considered duplicate, the function
- * saves the path to the dump directory in question and returns 1 to indicate
- * that we have indeed found a duplicate of currently processed dump directory.
- * No more events are processed and program prints the path to the other
- * directory and returns failure.
+ * If there is a CORE_BACKTRACE, it iterates over the other dump directories
+ * whose core backtraces may be similar according to the duplicate index
+ * (see dup_index_find_candidates()) and computes similarity to their core
+ * backtraces. If one of them is similar enough to be considered duplicate,
+ * the function saves the path to the dump directory in question and returns
+ * 1 to indicate that we have indeed found a duplicate of currently processed
+ * dump directory. No more events are processed and program prints the path
+ * to the other directory and returns failure.
  *
  * If there is an UUID item (and no core backtrace), the function again
- * iterates over all other dump directories and compares this UUID to their
- * UUID. If there is a match, the path to the duplicate is saved and 1 is returned.
+ * iterates over the dump directories with the same UUID and compares this
+ * UUID to their UUID. If there is a match, the path to the duplicate is
+ * saved and 1 is returned.
+ *
+ * If the index can't be used, all other dump directories are compared.
  *
  * If duplicate is not found as described above, the function returns 0 and we
  * either process remaining events if there are any, or successfully terminate
@@ -220,8 +294,6 @@ static void dup_corebt_fini(void)
  */
 static int is_crash_a_dup(const char *dump_dir_name, void *param)
 {
-    int retval = 0; /* defaults to no dup found, "run_event, please continue iterating" */
-
     struct dump_dir *dd = dd_opendir(dump_dir_name, DD_OPEN_READONLY);
     if (!dd)
         return 0; /* wtf? (error, but will be handled elsewhere later) */
@@ -236,6 +308,16 @@ static int is_crash_a_dup(const char *dump_dir_name, void *param)
     /* dump_dir_name can be relative */
     dump_dir_name = realpath(dump_dir_name, NULL);
 
+    GList *candidates = NULL;
+    if (dup_index_find_candidates(g_settings_dump_location, dump_dir_name, &candidates) == 0)
+    {
+        log_debug("Comparing with %u candidate duplicates", g_list_length(candidates));
+        for (GList *iter = candidates; iter && crash_dump_dup_name == NULL; iter = g_list_next(iter))
+            crash_dump_dup_name = is_dup_of(dump_dir_name, iter->data);
+        g_list_free_full(candidates, free);
+        goto end;
+    }
+
     DIR *dir = opendir(g_settings_dump_location);
     if (dir == NULL)
         goto end;
@@ -251,77 +333,16 @@ static int is_crash_a_dup(const char *dump_dir_name, void *param)
         if (ext && strcmp(ext, ".new") == 0)
             continue; /* skip anything named "<dirname>.new" */
 
-        dd = NULL;
-
         char *tmp_concat_path = concat_path_file(g_settings_dump_location, dent->d_name);
-
-        char *dump_dir_name2 = realpath(tmp_concat_path, NULL);
-        if (g_verbose > 1 && !dump_dir_name2)
-            perror_msg("realpath(%s)", tmp_concat_path);
-
+        crash_dump_dup_name = is_dup_of(dump_dir_name, tmp_concat_path);
         free(tmp_concat_path);
-
-        if (!dump_dir_name2)
-            continue;
-
-        char *dd_uid = NULL, *dd_type = NULL;
-        char *dd_executable = NULL;
-
-        if (strcmp(dump_dir_name, dump_dir_name2) == 0)
-            goto next; /* we are never a dup of ourself */
-
-        int sv_logmode = logmode;
-        /* Silently ignore any error in the silent log level. */
-        logmode = g_verbose == 0 ? 0 : sv_logmode;
-        dd = dd_opendir(dump_dir_name2, /*flags:*/ DD_FAIL_QUIETLY_ENOENT | DD_OPEN_READONLY);
-        logmode = sv_logmode;
-        if (!dd)
-            goto next;
-
-        /* crashes of different users are not considered duplicates */
-        dd_uid = dd_load_text_ext(dd, FILENAME_UID, DD_FAIL_QUIETLY_ENOENT);
-        if (strcmp(uid, dd_uid))
-        {
-            goto next;
-        }
-
-        /* different crash types are not duplicates */
-        dd_type = dd_load_text_ext(dd, FILENAME_TYPE, DD_FAIL_QUIETLY_ENOENT);
-        if (strcmp(type, dd_type))
-        {
-            goto next;
-        }
-
-        /* different executables are not duplicates */
-        dd_executable = dd_load_text_ext(dd, FILENAME_EXECUTABLE, DD_FAIL_QUIETLY_ENOENT);
-        if (     (executable != NULL && dd_executable == NULL)
-             ||  (executable == NULL && dd_executable != NULL)
-             || ((executable != NULL && dd_executable != NULL)
-                  && strcmp(executable, dd_executable) != 0))
-        {
-            goto next;
-        }
-
-        if (dup_uuid_compare(dd)
-         || dup_corebt_compare(dd)
-        ) {
-            crash_dump_dup_name = dump_dir_name2;
-            dump_dir_name2 = NULL;
-            retval = 1; /* "run_event, please stop iterating" */
-            /* sonce crash_dump_dup_name != NULL now, we exit the loop */
-        }
-
-next:
-        free(dump_dir_name2);
-        dd_close(dd);
-        free(dd_uid);
-        free(dd_type);
     }
     closedir(dir);
 
 end:
     free((char*)dump_dir_name);
-    return retval;
+    /* "run_event, please stop iterating" if a dup was found */
+    return crash_dump_dup_name != NULL;
 }
 
 static void create_lockfile(void)
@@ -466,7 +487,12 @@ int main(int argc, char **argv)
         int r = run_event_on_dir_name(run_state, dump_dir_name, event_name);
 
         if (post_create)
+        {
+            /* The problem stays, the next ones may be its duplicates */
+            if (r == 0 && crash_dump_dup_name == NULL)
+                dup_index_add(g_settings_dump_location, dump_dir_name);
             delete_lockfile();
+        }
 
         const bool no_action_for_event = (r == 0 && run_state->children_count == 0);
 
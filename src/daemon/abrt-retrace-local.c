@@ -0,0 +1,1399 @@
+/*
+    Copyright (C) 2017  ABRT Team
+    Copyright (C) 2017  Red Hat, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <sys/resource.h>
+#include <sys/un.h>
+#include <ftw.h>
+
+#include "abrt_glib.h"
+#include "libabrt.h"
+
+/* A retrace server for the local machine. It speaks the subset of the Retrace
+ * server protocol used by abrt-retrace-client over a Unix socket and retraces
+ * the uploaded coredumps with the locally installed binaries, gdb and
+ * the debuginfo caches:
+ *
+ *   GET  /settings               server limits
+ *   GET  /checkpackage           always 302, packages are checked by gdb
+ *   POST /create                 X-Task-Type, body: xz-compressed tarball
+ *                                -> 201, X-Task-Id, X-Task-Password
+ *   GET  /ID                     -> X-Task-Status, body: status message
+ *   GET  /ID/backtrace           -> body: backtrace
+ *   GET  /ID/exploitable         -> body: exploitable or 404
+ *   GET  /ID/log                 -> body: output of the retrace tools
+ *
+ * Every connection is served by a forked child. Accepted tasks are queued in
+ * the parent which retraces at most NUM of them at once, each in a forked
+ * worker. The state of a task lives only in its directory, so the children
+ * serving connections need not talk to the parent except for announcing
+ * newly created tasks through a pipe. The parent reserves a task for every
+ * connection while there is room for one, only the children holding
+ * a reservation may create a task.
+ *
+ * The archives are untrusted, the server refuses to run as root. Only the
+ * members of its group may connect to the socket. abrt-retrace-local.service
+ * runs it as the abrt-retrace user in a sandbox with NoNewPrivileges, hence
+ * the setuid abrt-action-install-debuginfo-to-abrt-cache can't be used. The
+ * server downloads debuginfos into its own cache and reads the shared cache
+ * of ABRT.
+ */
+
+#define STRINGIZE_DETAIL(str) #str
+#define STRINGIZE(str) STRINGIZE_DETAIL(str)
+
+#define SOCKET_FILE       VAR_RUN"/abrt-retrace/retrace.socket"
+#define SOCKET_PERMISSION 0660
+#define TASKS_DIR         "/var/spool/abrt-retrace"
+/* Writable by the server, see CacheDirectory in abrt-retrace-local.service */
+#define DEBUGINFO_CACHE_DIR "/var/cache/abrt-retrace-di"
+#define SHARED_DEBUGINFO_CACHE_DIR "/var/cache/abrt-di"
+/* Maximum number of simultaneously opened client connections. */
+#define MAX_CLIENT_COUNT  10
+
+#define DEFAULT_COUNT_OF_WORKERS 2
+#define DEFAULT_MAX_TASKS 32
+#define MAX_PACKED_SIZE_MB 1024
+#define MAX_UNPACKED_SIZE_MB 8192
+/* Finished tasks are deleted after 5 days, like on Retrace server */
+#define TASK_MAX_AGE (5 * 24 * 60 * 60)
+#define CLEANUP_INTERVAL (60 * 60)
+#define MAX_HEADER_SIZE (16 * 1024)
+/* Seconds a connection may stay idle */
+#define CLIENT_TIMEOUT 60
+
+/* X-Task-Type values, see abrt-retrace-client.c */
+#define TASK_RETRACE 0
+#define TASK_DEBUG   1
+
+#define TASK_ARCHIVE  "archive.tar.xz"
+#define TASK_CRASH    "crash"
+#define TASK_LOG      "retrace_log"
+#define TASK_PASSWORD "password"
+#define TASK_STATUS   "status"
+#define TASK_TYPE     "type"
+
+#define STATUS_PENDING          "PENDING"
+#define STATUS_RUNNING          "RUNNING"
+#define STATUS_FINISHED_SUCCESS "FINISHED_SUCCESS"
+#define STATUS_FINISHED_FAILURE "FINISHED_FAILURE"
+
+static const char *g_socket_file = SOCKET_FILE;
+static const char *g_tasks_dir = TASKS_DIR;
+static int g_max_tasks = DEFAULT_MAX_TASKS;
+
+static int g_signal_pipe[2];
+/* Children serving connections write "PID TASK_ID" of created tasks here */
+static int g_task_pipe[2];
+/* Set in the children serving connections for which the parent reserved
+ * a task */
+static bool g_task_reserved;
+
+struct process
+{
+    GMainLoop *main_loop;
+    GIOChannel *channel_socket;
+    guint channel_id_socket;
+    unsigned clients;
+    unsigned max_workers;
+    /* pid -> task id */
+    GHashTable *workers;
+    GQueue queue;
+    /* pids of the children serving connections with a reserved task */
+    GHashTable *reservations;
+    GIOChannel *channel_task;
+};
+
+static char *
+task_file(const char *task_id, const char *name)
+{
+    return xasprintf("%s/%s/%s", g_tasks_dir, task_id, name);
+}
+
+static char *
+load_task_file(const char *task_id, const char *name)
+{
+    char *path = task_file(task_id, name);
+    char *content = xmalloc_open_read_close(path, /*maxsize:*/ NULL);
+    free(path);
+    if (content)
+        strchrnul(content, '\n')[0] = '\0';
+    return content;
+}
+
+/* Replaces the file atomically, readers never see it half-written */
+static int
+save_task_file(const char *task_id, const char *name, const char *content)
+{
+    char *path = task_file(task_id, name);
+    char *tmp_path = xasprintf("%s.tmp", path);
+
+    int r = -1;
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        perror_msg("Can't open '%s'", tmp_path);
+        goto ret;
+    }
+
+    const size_t len = strlen(content);
+    if (full_write(fd, content, len) != (ssize_t)len)
+    {
+        perror_msg("Can't write '%s'", tmp_path);
+        close(fd);
+        goto ret;
+    }
+    close(fd);
+
+    if (rename(tmp_path, path) != 0)
+    {
+        perror_msg("Can't rename '%s' to '%s'", tmp_path, path);
+        goto ret;
+    }
+
+    r = 0;
+ ret:
+    free(tmp_path);
+    free(path);
+    return r;
+}
+
+static int
+remove_task_file_cb(const char *path, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    if (remove(path) != 0)
+        perror_msg("Can't remove '%s'", path);
+    return 0;
+}
+
+static void
+remove_task(const char *task_id)
+{
+    log_info("Removing task %s", task_id);
+    char *path = concat_path_file(g_tasks_dir, task_id);
+    nftw(path, remove_task_file_cb, 16, FTW_DEPTH | FTW_PHYS);
+    free(path);
+}
+
+/* Task IDs are used as file names, they must be numbers */
+static bool
+task_id_is_valid(const char *task_id)
+{
+    if (!task_id[0])
+        return false;
+    for (const char *c = task_id; *c; ++c)
+        if (!isdigit(*c))
+            return false;
+    return true;
+}
+
+static bool
+status_is_finished(const char *status)
+{
+    return prefixcmp(status, "FINISHED") == 0;
+}
+
+static const char *
+status_message(const char *status)
+{
+    if (strcmp(status, STATUS_PENDING) == 0)
+        return _("Waiting for a free worker");
+    if (strcmp(status, STATUS_RUNNING) == 0)
+        return _("Retracing the coredump");
+    if (strcmp(status, STATUS_FINISHED_SUCCESS) == 0)
+        return _("Retrace job finished successfully");
+    return _("Retrace job failed");
+}
+
+static unsigned
+count_unfinished_tasks(void)
+{
+    DIR *dp = opendir(g_tasks_dir);
+    if (!dp)
+        return 0;
+
+    unsigned count = 0;
+    struct dirent *dent;
+    while ((dent = readdir(dp)) != NULL)
+    {
+        if (!task_id_is_valid(dent->d_name))
+            continue;
+
+        char *status = load_task_file(dent->d_name, TASK_STATUS);
+        if (status && !status_is_finished(status))
+            ++count;
+        free(status);
+    }
+    closedir(dp);
+
+    return count;
+}
+
+static void
+read_random(void *buf, size_t len)
+{
+    int fd = xopen("/dev/urandom", O_RDONLY);
+    if (full_read(fd, buf, len) != len)
+        perror_msg_and_die("Can't read '%s'", "/dev/urandom");
+    close(fd);
+}
+
+static char *
+generate_password(void)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+    unsigned char random[22];
+    read_random(random, sizeof(random));
+
+    char *password = xmalloc(sizeof(random) + 1);
+    for (unsigned i = 0; i < sizeof(random); ++i)
+        password[i] = alphabet[random[i] % (sizeof(alphabet) - 1)];
+    password[sizeof(random)] = '\0';
+
+    return password;
+}
+
+/* Creates the directory of a new task and returns its ID */
+static char *
+create_task_dir(void)
+{
+    while (1)
+    {
+        uint32_t random;
+        read_random(&random, sizeof(random));
+
+        /* 9 digits, like Retrace server */
+        char *task_id = xasprintf("%u", 100000000 + random % 900000000);
+        char *path = concat_path_file(g_tasks_dir, task_id);
+        const int r = mkdir(path, 0700);
+        free(path);
+
+        if (r == 0)
+            return task_id;
+
+        free(task_id);
+        if (errno != EEXIST)
+        {
+            perror_msg("Can't create task directory in '%s'", g_tasks_dir);
+            return NULL;
+        }
+    }
+}
+
+/*
+ * Connection handling (runs in a forked child)
+ */
+
+struct http_request
+{
+    char *method;
+    char *path;
+    /* From the request line up to and including the empty line */
+    char *headers;
+    /* Part of the body received together with the headers */
+    char *body;
+    size_t body_len;
+};
+
+static void
+send_response(int fd, int code, const char *reason, const char *headers, const char *body)
+{
+    if (!body)
+        body = "";
+
+    char *response = xasprintf("HTTP/1.1 %d %s\r\n"
+                               "Content-Type: text/plain\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: close\r\n"
+                               "%s"
+                               "\r\n"
+                               "%s",
+                               code, reason, strlen(body),
+                               headers ? headers : "",
+                               body);
+    full_write_str(fd, response);
+    free(response);
+}
+
+static char *
+get_header_value(const struct http_request *request, const char *name)
+{
+    char *search_string = xasprintf("\r\n%s:", name);
+    const char *header = strcasestr(request->headers, search_string);
+    if (header)
+        header += strlen(search_string);
+    free(search_string);
+
+    if (!header)
+        return NULL;
+
+    header = skip_whitespace(header);
+    return xstrndup(header, strcspn(header, "\r\n"));
+}
+
+static int
+read_request(int fd, struct http_request *request)
+{
+    char *buf = xmalloc(MAX_HEADER_SIZE + 1);
+    size_t len = 0;
+    char *headers_end = NULL;
+    while (!headers_end)
+    {
+        if (len == MAX_HEADER_SIZE)
+            goto err;
+
+        const ssize_t r = safe_read(fd, buf + len, MAX_HEADER_SIZE - len);
+        if (r <= 0)
+            goto err;
+
+        len += r;
+        buf[len] = '\0';
+        headers_end = strstr(buf, "\r\n\r\n");
+    }
+
+    /* METHOD PATH HTTP/1.1 */
+    const size_t method_len = strcspn(buf, " \r\n");
+    const char *path = buf + method_len;
+    if (*path != ' ')
+        goto err;
+    ++path;
+    request->method = xstrndup(buf, method_len);
+    request->path = xstrndup(path, strcspn(path, " \r\n"));
+
+    headers_end += strlen("\r\n\r\n");
+    request->body_len = len - (headers_end - buf);
+    request->body = xmalloc(request->body_len + 1);
+    memcpy(request->body, headers_end, request->body_len);
+    *headers_end = '\0';
+    request->headers = buf;
+
+    return 0;
+
+ err:
+    free(buf);
+    return -1;
+}
+
+static void
+handle_create(int fd, struct http_request *request)
+{
+    char *task_type = get_header_value(request, "X-Task-Type");
+    char *content_length = get_header_value(request, "Content-Length");
+    char *task_id = NULL;
+    char *password = NULL;
+    int archive_fd = -1;
+
+    if (!task_type || !content_length)
+    {
+        send_response(fd, 400, "Bad Request", NULL, _("Missing X-Task-Type or Content-Length."));
+        goto ret;
+    }
+
+    const int type = atoi(task_type);
+    if (type != TASK_RETRACE && type != TASK_DEBUG)
+    {
+        send_response(fd, 501, "Not Implemented", NULL, _("Only coredumps can be retraced locally."));
+        goto ret;
+    }
+
+    const long long size = atoll(content_length);
+    if (size <= 0 || size > MAX_PACKED_SIZE_MB * 1024LL * 1024LL)
+    {
+        send_response(fd, 413, "Request Entity Too Large", NULL, _("The archive is too large."));
+        goto ret;
+    }
+
+    if (!g_task_reserved)
+    {
+        send_response(fd, 503, "Service Unavailable", NULL, _("The server is fully occupied. Try again later."));
+        goto ret;
+    }
+
+    task_id = create_task_dir();
+    if (!task_id)
+    {
+        send_response(fd, 500, "Internal Server Error", NULL, _("Can't create the task."));
+        goto ret;
+    }
+
+    char *archive_path = task_file(task_id, TASK_ARCHIVE);
+    archive_fd = open(archive_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    free(archive_path);
+    if (archive_fd < 0)
+        goto err;
+
+    long long remaining = size - (long long)MIN(request->body_len, (size_t)size);
+    if (full_write(archive_fd, request->body, MIN(request->body_len, (size_t)size)) < 0)
+        goto err;
+
+    char buf[32768];
+    while (remaining > 0)
+    {
+        const ssize_t r = safe_read(fd, buf, MIN(remaining, (long long)sizeof(buf)));
+        if (r <= 0)
+        {
+            log_notice("Task %s: the client sent an incomplete archive", task_id);
+            send_response(fd, 400, "Bad Request", NULL, _("Incomplete archive."));
+            remove_task(task_id);
+            goto ret;
+        }
+
+        if (full_write(archive_fd, buf, r) != r)
+            goto err;
+
+        remaining -= r;
+    }
+
+    if (close(archive_fd) != 0)
+    {
+        archive_fd = -1;
+        goto err;
+    }
+    archive_fd = -1;
+
+    password = generate_password();
+    if (save_task_file(task_id, TASK_PASSWORD, password) != 0
+     || save_task_file(task_id, TASK_TYPE, task_type) != 0
+     || save_task_file(task_id, TASK_STATUS, STATUS_PENDING) != 0)
+        goto err;
+
+    /* Hand the task over to the parent. Writes shorter than PIPE_BUF are
+     * atomic, hence the IDs from several children don't mix.
+     */
+    char *line = xasprintf("%d %s\n", (int)getpid(), task_id);
+    const bool queued = full_write_str(g_task_pipe[1], line) == strlen(line);
+    free(line);
+    if (!queued)
+        goto err;
+
+    log_info("Created task %s", task_id);
+
+    char *headers = xasprintf("X-Task-Id: %s\r\n"
+                              "X-Task-Password: %s\r\n",
+                              task_id, password);
+    send_response(fd, 201, "Created", headers, _("Task created"));
+    free(headers);
+    goto ret;
+
+ err:
+    perror_msg("Can't store task %s", task_id);
+    send_response(fd, 500, "Internal Server Error", NULL, _("Can't store the task."));
+    remove_task(task_id);
+
+ ret:
+    if (archive_fd >= 0)
+        close(archive_fd);
+    free(password);
+    free(task_id);
+    free(content_length);
+    free(task_type);
+}
+
+static void
+handle_task(int fd, struct http_request *request, const char *task_id, const char *action)
+{
+    char *password = get_header_value(request, "X-Task-Password");
+    char *expected_password = load_task_file(task_id, TASK_PASSWORD);
+    char *status = load_task_file(task_id, TASK_STATUS);
+
+    if (!expected_password || !status)
+    {
+        send_response(fd, 404, "Not Found", NULL, _("There is no such task."));
+        goto ret;
+    }
+
+    if (!password || strcmp(password, expected_password) != 0)
+    {
+        send_response(fd, 403, "Forbidden", NULL, _("Invalid password."));
+        goto ret;
+    }
+
+    if (action == NULL)
+    {
+        char *headers = xasprintf("X-Task-Status: %s\r\n", status);
+        send_response(fd, 200, "OK", headers, status_message(status));
+        free(headers);
+        goto ret;
+    }
+
+    char *name = NULL;
+    if (strcmp(action, "backtrace") == 0)
+        name = xasprintf(TASK_CRASH"/%s", FILENAME_BACKTRACE);
+    else if (strcmp(action, "exploitable") == 0)
+        name = xasprintf(TASK_CRASH"/%s", FILENAME_EXPLOITABLE);
+    else if (strcmp(action, "log") == 0)
+        name = xstrdup(TASK_LOG);
+    else
+    {
+        send_response(fd, 404, "Not Found", NULL, _("Unknown request."));
+        goto ret;
+    }
+
+    char *path = task_file(task_id, name);
+    char *content = NULL;
+    /* The results are complete only after the worker has finished */
+    if (status_is_finished(status) || strcmp(action, "log") == 0)
+        content = xmalloc_open_read_close(path, /*maxsize:*/ NULL);
+
+    if (content)
+        send_response(fd, 200, "OK", NULL, content);
+    else
+        send_response(fd, 404, "Not Found", NULL, _("The requested data are not available."));
+
+    free(content);
+    free(path);
+    free(name);
+
+ ret:
+    free(status);
+    free(expected_password);
+    free(password);
+}
+
+static void
+handle_settings(int fd)
+{
+    char *body = xasprintf("running_tasks %u\n"
+                           "max_running_tasks %d\n"
+                           "max_packed_size %d\n"
+                           "max_unpacked_size %d\n"
+                           "supported_formats application/x-xz-compressed-tar\n",
+                           count_unfinished_tasks(), g_max_tasks,
+                           MAX_PACKED_SIZE_MB, MAX_UNPACKED_SIZE_MB);
+    send_response(fd, 200, "OK", NULL, body);
+    free(body);
+}
+
+static void
+serve_connection(int fd)
+{
+    struct http_request request = { 0 };
+    if (read_request(fd, &request) != 0)
+    {
+        send_response(fd, 400, "Bad Request", NULL, _("Malformed request."));
+        return;
+    }
+
+    log_debug("%s %s", request.method, request.path);
+
+    if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/create") == 0)
+        handle_create(fd, &request);
+    else if (strcmp(request.method, "GET") != 0)
+        send_response(fd, 405, "Method Not Allowed", NULL, NULL);
+    else if (strcmp(request.path, "/settings") == 0)
+        handle_settings(fd);
+    else if (strcmp(request.path, "/checkpackage") == 0)
+        /* Whether the package can be retraced is known only after gdb finds
+         * the binaries, let the client upload the archive */
+        send_response(fd, 302, "Found", NULL, NULL);
+    else
+    {
+        /* /ID or /ID/ACTION */
+        char *task_id = xstrdup(request.path + 1);
+        char *action = strchr(task_id, '/');
+        if (action)
+            *action++ = '\0';
+
+        if (task_id_is_valid(task_id))
+            handle_task(fd, &request, task_id, action);
+        else
+            send_response(fd, 404, "Not Found", NULL, _("Unknown request."));
+
+        free(task_id);
+    }
+
+    free(request.method);
+    free(request.path);
+    free(request.headers);
+    free(request.body);
+}
+
+/*
+ * Workers (run in forked children)
+ */
+
+/* Files written by the step are limited to max_file_size bytes. The step
+ * reads in_fd (/dev/null if -1) and writes out_fd (the task log if -1).
+ */
+static pid_t
+start_step(const char *const argv[], const char *dir, int in_fd, int out_fd,
+           rlim_t max_file_size)
+{
+    printf("$ ");
+    for (const char *const *arg = argv; *arg; ++arg)
+        printf("%s%s", *arg, arg[1] ? " " : "\n");
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror_msg("fork");
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        xmove_fd(in_fd >= 0 ? in_fd : xopen("/dev/null", O_RDONLY), STDIN_FILENO);
+        if (out_fd >= 0)
+            xmove_fd(out_fd, STDOUT_FILENO);
+        if (dir)
+            xchdir(dir);
+        if (max_file_size != RLIM_INFINITY)
+        {
+            struct rlimit limit = { .rlim_cur = max_file_size, .rlim_max = max_file_size };
+            if (setrlimit(RLIMIT_FSIZE, &limit) != 0)
+                perror_msg_and_die("Can't limit the size of files");
+        }
+        execvp(argv[0], (char *const *)argv);
+        perror_msg_and_die("Can't execute '%s'", argv[0]);
+    }
+
+    return pid;
+}
+
+static int
+wait_step(pid_t pid, const char *name)
+{
+    int status;
+    if (safe_waitpid(pid, &status, 0) < 0)
+    {
+        perror_msg("waitpid");
+        return -1;
+    }
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        return 0;
+
+    printf("'%s' failed\n", name);
+    return -1;
+}
+
+static int
+run_step(const char *const argv[], const char *dir)
+{
+    const pid_t pid = start_step(argv, dir, -1, -1, RLIM_INFINITY);
+    return pid < 0 ? -1 : wait_step(pid, argv[0]);
+}
+
+/* The files written by tar can't be larger than the tar stream altogether,
+ * unlike RLIMIT_FSIZE which applies to each of them alone. The stream is
+ * counted on its way from xz to tar, tar is killed when it exceeds max_size.
+ */
+static int
+unpack_archive(const char *archive, const char *crash_dir, long long max_size)
+{
+    const char *unxz[] = { "xz", "--decompress", "--stdout", archive, NULL };
+    const char *untar[] = { "tar", "-xf", "-", "-C", crash_dir,
+                            "--no-same-owner", "--no-same-permissions", NULL };
+    int xz_pipe[2];
+    int tar_pipe[2];
+    xpipe(xz_pipe);
+    xpipe(tar_pipe);
+    /* The steps get their ends as stdin/stdout, the rest must not leak */
+    for (int i = 0; i < 2; ++i)
+    {
+        close_on_exec_on(xz_pipe[i]);
+        close_on_exec_on(tar_pipe[i]);
+    }
+
+    const pid_t xz_pid = start_step(unxz, NULL, -1, xz_pipe[1], RLIM_INFINITY);
+    close(xz_pipe[1]);
+    const pid_t tar_pid = start_step(untar, NULL, tar_pipe[0], -1, max_size);
+    close(tar_pipe[0]);
+
+    /* A failing tar is reported by wait_step(), not by SIGPIPE */
+    signal(SIGPIPE, SIG_IGN);
+    long long total = 0;
+    bool failed = xz_pid < 0 || tar_pid < 0;
+    char buf[32768];
+    while (!failed)
+    {
+        const ssize_t r = safe_read(xz_pipe[0], buf, sizeof(buf));
+        if (r == 0)
+            break;
+        if (r < 0)
+        {
+            perror_msg("Can't read the decompressed archive");
+            failed = true;
+        }
+        else if ((total += r) > max_size)
+        {
+            printf("The unpacked archive is too large: more than %lld bytes\n", max_size);
+            failed = true;
+        }
+        else if (full_write(tar_pipe[1], buf, r) != r)
+        {
+            perror_msg("Can't pass the archive to tar");
+            failed = true;
+        }
+    }
+    close(xz_pipe[0]);
+    close(tar_pipe[1]);
+    signal(SIGPIPE, SIG_DFL);
+
+    if (failed)
+    {
+        if (xz_pid > 0)
+            kill(xz_pid, SIGKILL);
+        if (tar_pid > 0)
+            kill(tar_pid, SIGKILL);
+    }
+    if (xz_pid > 0 && wait_step(xz_pid, unxz[0]) != 0)
+        failed = true;
+    if (tar_pid > 0 && wait_step(tar_pid, untar[0]) != 0)
+        failed = true;
+
+    return failed ? -1 : 0;
+}
+
+/* Returns the size of the decompressed archive as recorded in its index,
+ * -1 on error */
+static long long
+archive_unpacked_size(const char *archive)
+{
+    const char *argv[] = { "xz", "--robot", "--list", archive, NULL };
+    int pipeout[2];
+    pid_t pid = fork_execv_on_steroids(EXECFLG_INPUT_NUL | EXECFLG_OUTPUT | EXECFLG_QUIET,
+                                       (char **)argv, pipeout, /*env_vec:*/ NULL,
+                                       /*dir:*/ NULL, /*uid(unused):*/ 0);
+    char *output = xmalloc_read(pipeout[0], /*maxsz:*/ NULL);
+    close(pipeout[0]);
+
+    int status;
+    long long size = -1;
+    if (safe_waitpid(pid, &status, 0) < 0)
+        perror_msg("waitpid");
+    else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        error_msg("Can't list the archive '%s'", archive);
+    else
+    {
+        /* totals STREAMS BLOCKS COMPRESSED UNCOMPRESSED ... */
+        const char *totals = output ? strstr(output, "\ntotals\t") : NULL;
+        if (!totals || sscanf(totals, "\ntotals\t%*u\t%*u\t%*u\t%lld", &size) != 1)
+        {
+            error_msg("Can't find the size of the decompressed archive '%s'", archive);
+            size = -1;
+        }
+    }
+
+    free(output);
+    return size;
+}
+
+/* Only the plain files sent by abrt-retrace-client are accepted */
+static int
+check_crash_dir(const char *crash_dir)
+{
+    DIR *dp = opendir(crash_dir);
+    if (!dp)
+    {
+        perror_msg("Can't open '%s'", crash_dir);
+        return -1;
+    }
+
+    int r = 0;
+    struct dirent *dent;
+    while (r == 0 && (dent = readdir(dp)) != NULL)
+    {
+        if (dot_or_dotdot(dent->d_name))
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(dp), dent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode))
+        {
+            error_msg("The archive contains '%s' which is not a regular file", dent->d_name);
+            r = -1;
+        }
+    }
+    closedir(dp);
+
+    return r;
+}
+
+static int
+retrace_task(const char *task_id)
+{
+    char *log_path = task_file(task_id, TASK_LOG);
+    int log_fd = xopen3(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    free(log_path);
+    xmove_fd(log_fd, STDOUT_FILENO);
+    xdup2(STDOUT_FILENO, STDERR_FILENO);
+    /* The output of the worker belongs to the task log, not to the journal */
+    logmode = LOGMODE_STDIO;
+
+    char *archive = task_file(task_id, TASK_ARCHIVE);
+    char *crash_dir = task_file(task_id, TASK_CRASH);
+    char *type = load_task_file(task_id, TASK_TYPE);
+    int r = -1;
+
+    if (mkdir(crash_dir, 0700) != 0)
+    {
+        perror_msg("Can't create '%s'", crash_dir);
+        goto ret;
+    }
+
+    /* Not even the tarball itself may exceed the limit. The index of xz
+     * can lie, hence the stream unpacked by tar is limited too.
+     */
+    const rlim_t max_unpacked_size = MAX_UNPACKED_SIZE_MB * 1024LL * 1024LL;
+    const long long unpacked_size = archive_unpacked_size(archive);
+    if (unpacked_size < 0)
+        goto ret;
+    if (unpacked_size > (long long)max_unpacked_size)
+    {
+        printf("The unpacked archive is too large: %lld bytes\n", unpacked_size);
+        goto ret;
+    }
+
+    if (unpack_archive(archive, crash_dir, max_unpacked_size) != 0 || check_crash_dir(crash_dir) != 0)
+        goto ret;
+
+    /* dd_opendir() refuses directories without the time element */
+    char *now = xasprintf("%lu", (unsigned long)time(NULL));
+    const int saved = save_task_file(task_id, TASK_CRASH"/"FILENAME_TIME, now);
+    free(now);
+    if (saved != 0)
+        goto ret;
+
+    const char *analyze_core[] = { "abrt-action-analyze-core", "--core="FILENAME_COREDUMP,
+                                   "-o", "build_ids", NULL };
+    /* The debuginfos already in the shared cache are not downloaded again */
+    const char *install_debuginfo[] = { "abrt-action-install-debuginfo", "-y", "--ids=build_ids",
+                                        "--cache="DEBUGINFO_CACHE_DIR":"SHARED_DEBUGINFO_CACHE_DIR,
+                                        NULL };
+    if (run_step(analyze_core, crash_dir) != 0 || run_step(install_debuginfo, crash_dir) != 0)
+        printf("Continuing without debuginfos\n");
+
+    /* The shared cache is searched by default */
+    const char *generate_backtrace[] = { "abrt-action-generate-backtrace", "-d", crash_dir,
+                                         "-i", DEBUGINFO_CACHE_DIR, NULL };
+    if (run_step(generate_backtrace, NULL) != 0)
+        goto ret;
+
+    char *backtrace_path = concat_path_file(crash_dir, FILENAME_BACKTRACE);
+    const bool have_backtrace = access(backtrace_path, R_OK) == 0;
+    free(backtrace_path);
+    if (!have_backtrace)
+        goto ret;
+
+    /* TASK_DEBUG doesn't query the exploitability */
+    if (type && atoi(type) == TASK_RETRACE)
+    {
+        const char *analyze_vulnerability[] = { "abrt-action-analyze-vulnerability", NULL };
+        run_step(analyze_vulnerability, crash_dir);
+    }
+
+    r = 0;
+
+ ret:
+    save_task_file(task_id, TASK_STATUS, r == 0 ? STATUS_FINISHED_SUCCESS : STATUS_FINISHED_FAILURE);
+    printf("%s\n", r == 0 ? STATUS_FINISHED_SUCCESS : STATUS_FINISHED_FAILURE);
+
+    free(type);
+    free(crash_dir);
+    free(archive);
+    return r == 0 ? 0 : 1;
+}
+
+/*
+ * Main process
+ */
+
+/* The children must not report their signals to the parent */
+static void
+reset_signals_in_child(void)
+{
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    close(g_signal_pipe[0]);
+    close(g_signal_pipe[1]);
+    close(g_task_pipe[0]);
+}
+
+static void
+start_workers(struct process *proc)
+{
+    while (g_hash_table_size(proc->workers) < proc->max_workers
+        && !g_queue_is_empty(&proc->queue))
+    {
+        char *task_id = g_queue_pop_head(&proc->queue);
+
+        /* The task could have been removed in the meantime */
+        char *status = load_task_file(task_id, TASK_STATUS);
+        const bool pending = status && strcmp(status, STATUS_PENDING) == 0;
+        free(status);
+        if (!pending || save_task_file(task_id, TASK_STATUS, STATUS_RUNNING) != 0)
+        {
+            free(task_id);
+            continue;
+        }
+
+        fflush(NULL); /* paranoia */
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror_msg("fork");
+            save_task_file(task_id, TASK_STATUS, STATUS_PENDING);
+            g_queue_push_head(&proc->queue, task_id);
+            return;
+        }
+
+        if (pid == 0)
+        {
+            /* The steps die together with the worker, see main() */
+            setpgid(0, 0);
+            reset_signals_in_child();
+            close(g_task_pipe[1]);
+            close(g_io_channel_unix_get_fd(proc->channel_socket));
+            signal(SIGPIPE, SIG_DFL);
+            exit(retrace_task(task_id));
+        }
+
+        /* Also in the parent, main() may kill the group before the child
+         * gets to run */
+        setpgid(pid, pid);
+        log_info("Retracing task %s in process %d", task_id, pid);
+        g_hash_table_insert(proc->workers, GINT_TO_POINTER(pid), task_id);
+    }
+
+    log_debug("Running workers: %u, queued tasks: %u",
+            g_hash_table_size(proc->workers), g_queue_get_length(&proc->queue));
+}
+
+static void
+finish_worker(struct process *proc, pid_t pid, int status)
+{
+    const char *task_id = g_hash_table_lookup(proc->workers, GINT_TO_POINTER(pid));
+
+    log_info("Task %s finished with exit status %d", task_id, status);
+
+    /* The worker died before it could record the result */
+    char *task_status = load_task_file(task_id, TASK_STATUS);
+    if (task_status && !status_is_finished(task_status))
+        save_task_file(task_id, TASK_STATUS, STATUS_FINISHED_FAILURE);
+    free(task_status);
+
+    g_hash_table_remove(proc->workers, GINT_TO_POINTER(pid));
+}
+
+static gboolean server_socket_cb(GIOChannel *source, GIOCondition condition, gpointer user_data);
+
+static void
+increment_client_count(struct process *proc)
+{
+    if (++proc->clients >= MAX_CLIENT_COUNT)
+    {
+        error_msg("Too many clients, refusing connections to '%s'", g_socket_file);
+        /* To avoid infinite loop caused by the descriptor in "ready" state,
+         * the callback must be disabled.
+         */
+        g_source_remove(proc->channel_id_socket);
+        proc->channel_id_socket = 0;
+    }
+}
+
+static void
+decrement_client_count(struct process *proc)
+{
+    if (proc->clients)
+        proc->clients--;
+    if (proc->clients < MAX_CLIENT_COUNT && !proc->channel_id_socket)
+    {
+        log_info("Accepting connections on '%s'", g_socket_file);
+        proc->channel_id_socket = g_io_add_watch(proc->channel_socket,
+                G_IO_IN | G_IO_PRI | G_IO_HUP, server_socket_cb, proc);
+    }
+}
+
+static gboolean
+server_socket_cb(GIOChannel *source, GIOCondition condition, gpointer user_data)
+{
+    struct process *proc = (struct process *)user_data;
+
+    int socket = accept(g_io_channel_unix_get_fd(source), NULL, NULL);
+    if (socket == -1)
+    {
+        perror_msg("accept");
+        return TRUE;
+    }
+
+    log_notice("New client connected");
+
+    /* All unfinished tasks are either queued or running */
+    g_task_reserved = g_queue_get_length(&proc->queue)
+                    + g_hash_table_size(proc->workers)
+                    + g_hash_table_size(proc->reservations) < (unsigned)g_max_tasks;
+
+    fflush(NULL); /* paranoia */
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror_msg("fork");
+        close(socket);
+        return TRUE;
+    }
+
+    if (pid == 0)
+    {
+        /* child */
+        reset_signals_in_child();
+        close(g_io_channel_unix_get_fd(source));
+        /* A client which stops sending or reading must not hold one of
+         * the MAX_CLIENT_COUNT slots forever */
+        const struct timeval timeout = { .tv_sec = CLIENT_TIMEOUT };
+        if (setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0
+         || setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0)
+            perror_msg_and_die("Can't set the timeout of the connection");
+        serve_connection(socket);
+        close(socket);
+        exit(0);
+    }
+
+    /* parent */
+    if (g_task_reserved)
+        g_hash_table_add(proc->reservations, GINT_TO_POINTER(pid));
+    increment_client_count(proc);
+    close(socket);
+
+    return TRUE; /* "please don't remove this event" */
+}
+
+/* Queues the tasks created by the children, their reservations become
+ * the tasks */
+static void
+read_task_pipe(struct process *proc)
+{
+    gchar *line;
+    while (g_io_channel_read_line(proc->channel_task, &line, NULL, NULL, NULL) == G_IO_STATUS_NORMAL)
+    {
+        g_strchomp(line);
+        char *task_id = strchr(line, ' ');
+        if (task_id)
+        {
+            *task_id++ = '\0';
+            g_hash_table_remove(proc->reservations, GINT_TO_POINTER(atoi(line)));
+            if (task_id_is_valid(task_id))
+                g_queue_push_tail(&proc->queue, xstrdup(task_id));
+        }
+        g_free(line);
+    }
+}
+
+static gboolean
+handle_task_pipe_cb(GIOChannel *gio, GIOCondition condition, gpointer user_data)
+{
+    struct process *proc = (struct process *)user_data;
+
+    read_task_pipe(proc);
+    start_workers(proc);
+
+    return TRUE; /* "please don't remove this event" */
+}
+
+static void
+handle_signal(int signo)
+{
+    int save_errno = errno;
+    uint8_t sig_caught = signo;
+    if (write(g_signal_pipe[1], &sig_caught, 1))
+        /* we ignore result, if () shuts up stupid compiler */;
+    errno = save_errno;
+}
+
+static gboolean
+handle_signal_pipe_cb(GIOChannel *gio, GIOCondition condition, gpointer user_data)
+{
+    struct process *proc = (struct process *)user_data;
+    uint8_t signals[16];
+    gsize len = 0;
+
+    for (;;)
+    {
+        GIOStatus stat = g_io_channel_read_chars(gio, (void *)signals, sizeof(signals), &len, NULL);
+        if (stat == G_IO_STATUS_ERROR)
+            error_msg_and_die(_("Can't read from gio channel"));
+        if (stat == G_IO_STATUS_AGAIN || stat == G_IO_STATUS_EOF)
+            break;
+
+        /* G_IO_STATUS_NORMAL */
+        for (unsigned signo = 0; signo < len; ++signo)
+        {
+            log_debug("Got signal %d through signal pipe", signals[signo]);
+            if (signals[signo] != SIGCHLD)
+            {
+                g_main_loop_quit(proc->main_loop);
+                return FALSE; /* remove this event */
+            }
+
+            /* The tasks announced by the exited children must be queued
+             * before their reservations are released */
+            read_task_pipe(proc);
+
+            pid_t pid;
+            int status;
+            while ((pid = safe_waitpid(-1, &status, WNOHANG)) > 0)
+            {
+                if (g_hash_table_contains(proc->workers, GINT_TO_POINTER(pid)))
+                    finish_worker(proc, pid, status);
+                else
+                {
+                    g_hash_table_remove(proc->reservations, GINT_TO_POINTER(pid));
+                    decrement_client_count(proc);
+                }
+            }
+        }
+    }
+
+    start_workers(proc);
+
+    return TRUE; /* "please don't remove this event" */
+}
+
+/* Removes expired tasks. At start up, it also queues the tasks which were
+ * not retraced before the previous instance terminated.
+ */
+static void
+cleanup_tasks(struct process *proc, bool startup)
+{
+    DIR *dp = opendir(g_tasks_dir);
+    if (!dp)
+    {
+        perror_msg("Can't open directory '%s'", g_tasks_dir);
+        return;
+    }
+
+    GList *requeued = NULL;
+    const time_t now = time(NULL);
+    struct dirent *dent;
+    while ((dent = readdir(dp)) != NULL)
+    {
+        if (!task_id_is_valid(dent->d_name))
+            continue;
+
+        char *status_path = task_file(dent->d_name, TASK_STATUS);
+        struct stat st;
+        if (stat(status_path, &st) != 0)
+        {
+            /* A task which was never completely created */
+            char *dir = concat_path_file(g_tasks_dir, dent->d_name);
+            if (stat(dir, &st) == 0 && now - st.st_mtime > CLEANUP_INTERVAL)
+                remove_task(dent->d_name);
+            free(dir);
+        }
+        else
+        {
+            char *status = load_task_file(dent->d_name, TASK_STATUS);
+            if (status && status_is_finished(status))
+            {
+                if (now - st.st_mtime > TASK_MAX_AGE)
+                    remove_task(dent->d_name);
+            }
+            else if (startup)
+            {
+                save_task_file(dent->d_name, TASK_STATUS, STATUS_PENDING);
+                requeued = g_list_prepend(requeued, xstrdup(dent->d_name));
+            }
+            free(status);
+        }
+        free(status_path);
+    }
+    closedir(dp);
+
+    /* The numeric IDs are random, the order of creation is lost */
+    for (GList *iter = requeued; iter; iter = g_list_next(iter))
+    {
+        log_info("Queuing unfinished task %s", (char *)iter->data);
+        g_queue_push_tail(&proc->queue, iter->data);
+    }
+    g_list_free(requeued);
+
+    start_workers(proc);
+}
+
+static gboolean
+cleanup_tasks_cb(gpointer user_data)
+{
+    cleanup_tasks((struct process *)user_data, /*startup:*/ false);
+    return TRUE; /* "please don't remove this event" */
+}
+
+static GIOChannel *
+socket_init(struct process *proc)
+{
+    unlink(g_socket_file); /* not caring about the result */
+
+    int socketfd = xsocket(AF_UNIX, SOCK_STREAM, 0);
+    close_on_exec_on(socketfd);
+
+    struct sockaddr_un local;
+    memset(&local, 0, sizeof(local));
+    local.sun_family = AF_UNIX;
+    if (strlen(g_socket_file) >= sizeof(local.sun_path))
+        error_msg_and_die("Socket path '%s' is too long", g_socket_file);
+    strcpy(local.sun_path, g_socket_file);
+    xbind(socketfd, (struct sockaddr*)&local, sizeof(local));
+    xlisten(socketfd, MAX_CLIENT_COUNT);
+
+    if (chmod(g_socket_file, SOCKET_PERMISSION) != 0)
+        perror_msg_and_die("chmod '%s'", g_socket_file);
+
+    GIOChannel *channel = abrt_gio_channel_unix_new(socketfd);
+    g_io_channel_set_buffered(channel, FALSE);
+    proc->channel_id_socket = g_io_add_watch(channel,
+            G_IO_IN | G_IO_PRI | G_IO_HUP, server_socket_cb, proc);
+
+    return channel;
+}
+
+int
+main(int argc, char **argv)
+{
+    /* I18n */
+    setlocale(LC_ALL, "");
+#if ENABLE_NLS
+    bindtextdomain(PACKAGE, LOCALEDIR);
+    textdomain(PACKAGE);
+#endif
+
+    abrt_init(argv);
+    /* Can't keep these strings/structs static: _() doesn't support that */
+    const char *program_usage_string = _(
+        "& [-vs] [-w NUM] [-m NUM] [-S SOCKET] [-t TASKS_DIR]\n"
+        "\n"
+        "\nRetraces coredumps uploaded by abrt-retrace-client to SOCKET"
+        "\nwith the locally installed binaries and debuginfos"
+    );
+    enum {
+        OPT_v = 1 << 0,
+        OPT_s = 1 << 1,
+        OPT_w = 1 << 2,
+        OPT_m = 1 << 3,
+        OPT_S = 1 << 4,
+        OPT_t = 1 << 5,
+    };
+
+    int concurrent_workers = DEFAULT_COUNT_OF_WORKERS;
+
+    /* Keep enum above and order of options below in sync! */
+    struct options program_options[] = {
+        OPT__VERBOSE(&g_verbose),
+        OPT_BOOL('s', NULL, NULL, _("Log to syslog")),
+        OPT_INTEGER('w', NULL, &concurrent_workers, _("Number of concurrent workers. Default is "STRINGIZE(DEFAULT_COUNT_OF_WORKERS))),
+        OPT_INTEGER('m', NULL, &g_max_tasks, _("Maximal number of unfinished tasks. Default is "STRINGIZE(DEFAULT_MAX_TASKS))),
+        OPT_STRING('S', NULL, &g_socket_file, "SOCKET", _("Listen on SOCKET. Default is "SOCKET_FILE)),
+        OPT_STRING('t', NULL, &g_tasks_dir, "TASKS_DIR", _("Store tasks in TASKS_DIR. Default is "TASKS_DIR)),
+        OPT_END()
+    };
+    unsigned opts = parse_opts(argc, argv, program_options, program_usage_string);
+
+    if (concurrent_workers <= 0)
+        error_msg_and_die("Invalid number of workers: %d", concurrent_workers);
+
+    if (g_max_tasks <= 0)
+        error_msg_and_die("Invalid number of tasks: %d", g_max_tasks);
+
+    /* tar, gdb, ... would process untrusted data with full privileges */
+    if (geteuid() == 0)
+        error_msg_and_die(_("Refusing to retrace untrusted coredumps as root, run it as an unprivileged user"));
+
+    msg_prefix = g_progname;
+    if ((opts & OPT_s) || getenv("ABRT_SYSLOG"))
+        logmode = LOGMODE_JOURNAL;
+
+    if (mkdir(g_tasks_dir, 0700) != 0 && errno != EEXIST)
+        perror_msg_and_die("Can't create '%s'", g_tasks_dir);
+
+    struct process proc = {0};
+    proc.max_workers = concurrent_workers;
+    proc.workers = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free);
+    proc.reservations = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_queue_init(&proc.queue);
+
+    log_info("Creating glib main loop");
+    proc.main_loop = g_main_loop_new(NULL, FALSE);
+
+    log_notice("Setting up a signal handler");
+    xpipe(g_signal_pipe);
+    close_on_exec_on(g_signal_pipe[0]);
+    close_on_exec_on(g_signal_pipe[1]);
+    ndelay_on(g_signal_pipe[0]);
+    ndelay_on(g_signal_pipe[1]);
+    signal(SIGTERM, handle_signal);
+    signal(SIGINT, handle_signal);
+    signal(SIGCHLD, handle_signal);
+    /* A client closing the connection early must not kill the child */
+    signal(SIGPIPE, SIG_IGN);
+    GIOChannel *channel_signal = abrt_gio_channel_unix_new(g_signal_pipe[0]);
+    guint channel_signal_source_id = g_io_add_watch(channel_signal,
+                G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+                handle_signal_pipe_cb,
+                &proc);
+
+    xpipe(g_task_pipe);
+    close_on_exec_on(g_task_pipe[0]);
+    close_on_exec_on(g_task_pipe[1]);
+    ndelay_on(g_task_pipe[0]);
+    proc.channel_task = abrt_gio_channel_unix_new(g_task_pipe[0]);
+    guint channel_task_source_id = g_io_add_watch(proc.channel_task,
+                G_IO_IN | G_IO_PRI,
+                handle_task_pipe_cb,
+                &proc);
+
+    log_notice("Listening on '%s'", g_socket_file);
+    proc.channel_socket = socket_init(&proc);
+
+    cleanup_tasks(&proc, /*startup:*/ true);
+    guint cleanup_source_id = g_timeout_add_seconds(CLEANUP_INTERVAL, cleanup_tasks_cb, &proc);
+
+    log_info("Starting glib main loop");
+
+    g_main_loop_run(proc.main_loop);
+
+    log_info("Glib main loop finished");
+
+    /* The interrupted tasks are queued again on the next start. Each worker
+     * leads a process group, its gdb or tar must not outlive it.
+     */
+    GHashTableIter iter;
+    gpointer pid;
+    g_hash_table_iter_init(&iter, proc.workers);
+    while (g_hash_table_iter_next(&iter, &pid, NULL))
+        kill(-GPOINTER_TO_INT(pid), SIGTERM);
+
+    if (proc.channel_id_socket)
+        g_source_remove(proc.channel_id_socket);
+    g_io_channel_unref(proc.channel_socket);
+    unlink(g_socket_file);
+
+    g_source_remove(cleanup_source_id);
+    g_source_remove(channel_task_source_id);
+    g_io_channel_unref(proc.channel_task);
+    g_source_remove(channel_signal_source_id);
+    g_io_channel_unref(channel_signal);
+
+    char *task_id;
+    while ((task_id = g_queue_pop_head(&proc.queue)) != NULL)
+        free(task_id);
+    g_hash_table_destroy(proc.workers);
+    g_hash_table_destroy(proc.reservations);
+    g_main_loop_unref(proc.main_loop);
+
+    return 0;
+}
@@ -43,6 +43,7 @@
 #define MAX_CLIENT_COUNT  10
 
 #define IN_DUMP_LOCATION_FLAGS (IN_DELETE_SELF | IN_MOVE_SELF)
+#define IN_CONF_DIR_FLAGS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
 
 #define ABRTD_DBUS_NAME ABRT_DBUS_NAME".daemon"
 
@@ -219,6 +220,45 @@ static void handle_inotify_cb(struct abrt_inotify_watch *watch, struct inotify_e
     start_idle_timeout();
 }
 
+/* Regenerates the configuration snapshot whenever a configuration file changes */
+static gboolean handle_conf_change_cb(GIOChannel *gio, GIOCondition condition, gpointer ptr_unused)
+{
+    /* The names of the files don't matter, the whole snapshot is regenerated */
+    char buf[(sizeof(struct inotify_event) + FILENAME_MAX) * 16];
+    while (safe_read(g_io_channel_unix_get_fd(gio), buf, sizeof(buf)) > 0)
+        continue;
+
+    /* abrtd itself keeps the configuration it was started with */
+    log_notice("Configuration changed, regenerating the snapshot");
+    save_abrt_conf_snapshot();
+
+    return TRUE; /* "please don't remove this event" */
+}
+
+static GIOChannel *conf_watch_init(guint *channel_id)
+{
+    static const char *const conf_dirs[] = {
+        DEFAULT_CONF_DIR, CONF_DIR, DEFAULT_PLUGINS_CONF_DIR, PLUGINS_CONF_DIR,
+    };
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        perror_msg("Can't watch configuration files: inotify_init1");
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < ARRAY_SIZE(conf_dirs); ++i)
+        if (inotify_add_watch(fd, conf_dirs[i], IN_CONF_DIR_FLAGS) < 0)
+            log_notice("Can't watch '%s': %s", conf_dirs[i], strerror(errno));
+
+    GIOChannel *channel = abrt_gio_channel_unix_new(fd);
+    g_io_channel_set_buffered(channel, false);
+    *channel_id = add_watch_or_die(channel, G_IO_IN | G_IO_PRI | G_IO_HUP, handle_conf_change_cb);
+
+    return channel;
+}
+
 /* Initializes the dump socket, usually in /var/run directory
  * (the path depends on compile-time configuration).
  */
@@ -348,6 +388,192 @@ static void start_logging(void)
  *
  * Relying on content of dump directory has one problem. If a hook provides
  * FILENAME_COUNT abrtd will consider the dump directory as processed.
+ *
+ * The dump location is swept incrementally from the main loop, so abrtd
+ * accepts new problems while the old ones are being checked. Only
+ * directories listed before abrtd opened its socket are considered, the
+ * newer ones are being processed by post-create. A listed directory may
+ * still be written by a hook which had started before abrtd and notifies
+ * abrtd once the socket is open, hence directories which are locked or
+ * which may be in post-create are checked again later.
+ */
+
+/* Number of dump location entries checked in one main loop iteration. */
+#define UNPROCESSED_SWEEP_BATCH 64
+/* Delay of the next check of the postponed entries. */
+#define UNPROCESSED_SWEEP_RETRY_SECS 5
+
+struct unprocessed_sweep
+{
+    char *path;
+    GQueue names;
+    GQueue postponed;
+    gint64 sweep_start_us;
+    unsigned checked;
+    unsigned marked;
+};
+
+static struct unprocessed_sweep *s_unprocessed_sweep;
+static guint s_unprocessed_sweep_src;
+
+/* Checks the completeness markers without opening (and locking) the dump
+ * directory. Complete directories, which are the vast majority, are
+ * skipped at the cost of a single stat().
+ */
+static bool dump_dir_has_element(const char *dir, const char *name)
+{
+    char *element = concat_path_file(dir, name);
+    struct stat stat_buf;
+    const bool exists = lstat(element, &stat_buf) == 0;
+    free(element);
+    return exists;
+}
+
+/* post-create of a client's problem runs between the client's connection
+ * and the exit of the abrt-server serving it, while abrt-handle-event holds
+ * post-create.lock.
+ */
+static bool post_create_may_run(void)
+{
+    return child_count > 0
+        || dump_dir_has_element(s_unprocessed_sweep->path, "post-create.lock");
+}
+
+/* Returns false if the directory must be checked again later */
+static bool mark_dump_dir_not_reportable(const char *full_name)
+{
+    if (post_create_may_run())
+        return false;
+
+    /* The writer may be a hook, don't block the main loop until it is done */
+    struct dump_dir *dd = dd_opendir(full_name, DD_DONT_WAIT_FOR_LOCK | DD_FAIL_QUIETLY_ENOENT);
+    if (!dd)
+        return errno != EAGAIN;
+
+    /* Check again under the lock */
+    if (!problem_dump_dir_is_complete(dd) && !dd_exist(dd, FILENAME_NOT_REPORTABLE))
+    {
+        log_warning("Marking '%s' not reportable (no '"FILENAME_COUNT"' item)", full_name);
+
+        dd_save_text(dd, FILENAME_NOT_REPORTABLE, _("The problem data are "
+                    "incomplete. This usually happens when a problem "
+                    "is detected while computer is shutting down or "
+                    "user is logging out. In order to provide "
+                    "valuable problem reports, ABRT will not allow "
+                    "you to submit this problem. If you have time and "
+                    "want to help the developers in their effort to "
+                    "sort out this problem, please contact them directly."));
+
+        ++s_unprocessed_sweep->marked;
+    }
+    dd_close(dd);
+    return true;
+}
+
+/* Returns false if the directory must be checked again later */
+static bool unprocessed_sweep_check(const char *name)
+{
+    bool done = true;
+    char *full_name = concat_path_file(s_unprocessed_sweep->path, name);
+
+    struct stat stat_buf;
+    if (stat(full_name, &stat_buf) != 0)
+    {
+        /* The directory might have been deleted in the meantime */
+        if (errno != ENOENT)
+            perror_msg("Can't access path '%s'", full_name);
+        goto next_dd;
+    }
+
+    if (S_ISDIR(stat_buf.st_mode) == 0)
+        /* This is expected. The dump location contains some aux files */
+        goto next_dd;
+
+    ++s_unprocessed_sweep->checked;
+
+    if (dump_dir_has_element(full_name, FILENAME_COUNT)
+     || dump_dir_has_element(full_name, FILENAME_NOT_REPORTABLE))
+        goto next_dd;
+
+    done = mark_dump_dir_not_reportable(full_name);
+
+  next_dd:
+    free(full_name);
+    return done;
+}
+
+static void unprocessed_sweep_destroy(void)
+{
+    if (s_unprocessed_sweep_src != 0)
+    {
+        g_source_remove(s_unprocessed_sweep_src);
+        s_unprocessed_sweep_src = 0;
+    }
+
+    if (s_unprocessed_sweep)
+    {
+        g_queue_foreach(&s_unprocessed_sweep->names, (GFunc)free, NULL);
+        g_queue_clear(&s_unprocessed_sweep->names);
+        g_queue_foreach(&s_unprocessed_sweep->postponed, (GFunc)free, NULL);
+        g_queue_clear(&s_unprocessed_sweep->postponed);
+        free(s_unprocessed_sweep->path);
+        free(s_unprocessed_sweep);
+        s_unprocessed_sweep = NULL;
+    }
+}
+
+static gboolean unprocessed_sweep_cb(gpointer user_data);
+
+static gboolean unprocessed_sweep_retry_cb(gpointer user_data)
+{
+    /* Check the postponed entries from the idle source again */
+    s_unprocessed_sweep->names = s_unprocessed_sweep->postponed;
+    g_queue_init(&s_unprocessed_sweep->postponed);
+
+    s_unprocessed_sweep_src = g_idle_add_full(G_PRIORITY_LOW, unprocessed_sweep_cb, NULL, NULL);
+    return FALSE;
+}
+
+static gboolean unprocessed_sweep_cb(gpointer user_data)
+{
+    for (unsigned i = 0; i < UNPROCESSED_SWEEP_BATCH; ++i)
+    {
+        char *name = g_queue_pop_head(&s_unprocessed_sweep->names);
+        if (name == NULL)
+            break;
+
+        if (unprocessed_sweep_check(name))
+            free(name);
+        else
+            g_queue_push_tail(&s_unprocessed_sweep->postponed, name);
+    }
+
+    if (!g_queue_is_empty(&s_unprocessed_sweep->names))
+        return TRUE; /* "please don't remove this event" */
+
+    /* The source is removed by returning FALSE */
+    s_unprocessed_sweep_src = 0;
+
+    if (!g_queue_is_empty(&s_unprocessed_sweep->postponed))
+    {
+        log_info("Postponing the check of %u dump directories",
+                g_queue_get_length(&s_unprocessed_sweep->postponed));
+        s_unprocessed_sweep_src = g_timeout_add_seconds(UNPROCESSED_SWEEP_RETRY_SECS,
+                unprocessed_sweep_retry_cb, NULL);
+        return FALSE;
+    }
+
+    log_notice("Checked %u dump directories in %"G_GINT64_FORMAT" ms, %u marked not reportable",
+            s_unprocessed_sweep->checked,
+            (g_get_monotonic_time() - s_unprocessed_sweep->sweep_start_us) / 1000,
+            s_unprocessed_sweep->marked);
+
+    unprocessed_sweep_destroy();
+    return FALSE;
+}
+
+/* Must be called before the socket is open, only the directories existing
+ * at that time are checked.
  */
 static void mark_unprocessed_dump_dirs_not_reportable(const char *path)
 {
@@ -360,49 +586,25 @@ static void mark_unprocessed_dump_dirs_not_reportable(const char *path)
         return;
     }
 
+    s_unprocessed_sweep = xzalloc(sizeof(*s_unprocessed_sweep));
+    s_unprocessed_sweep->path = xstrdup(path);
+    g_queue_init(&s_unprocessed_sweep->names);
+    g_queue_init(&s_unprocessed_sweep->postponed);
+    s_unprocessed_sweep->sweep_start_us = g_get_monotonic_time();
+
+    /* Only the names, the entries are examined from the main loop */
     struct dirent *dent;
     while ((dent = readdir(dp)) != NULL)
     {
         if (dot_or_dotdot(dent->d_name))
             continue; /* skip "." and ".." */
 
-        char *full_name = concat_path_file(path, dent->d_name);
-
-        struct stat stat_buf;
-        if (stat(full_name, &stat_buf) != 0)
-        {
-            perror_msg("Can't access path '%s'", full_name);
-            goto next_dd;
-        }
-
-        if (S_ISDIR(stat_buf.st_mode) == 0)
-            /* This is expected. The dump location contains some aux files */
-            goto next_dd;
-
-        struct dump_dir *dd = dd_opendir(full_name, /*flags*/0);
-        if (dd)
-        {
-            if (!problem_dump_dir_is_complete(dd) && !dd_exist(dd, FILENAME_NOT_REPORTABLE))
-            {
-                log_warning("Marking '%s' not reportable (no '"FILENAME_COUNT"' item)", full_name);
-
-                dd_save_text(dd, FILENAME_NOT_REPORTABLE, _("The problem data are "
-                            "incomplete. This usually happens when a problem "
-                            "is detected while computer is shutting down or "
-                            "user is logging out. In order to provide "
-                            "valuable problem reports, ABRT will not allow "
-                            "you to submit this problem. If you have time and "
-                            "want to help the developers in their effort to "
-                            "sort out this problem, please contact them directly."));
-
-            }
-            dd_close(dd);
-        }
-
-  next_dd:
-        free(full_name);
+        g_queue_push_tail(&s_unprocessed_sweep->names, xstrdup(dent->d_name));
     }
     closedir(dp);
+
+    /* Low priority - serving clients is more important */
+    s_unprocessed_sweep_src = g_idle_add_full(G_PRIORITY_LOW, unprocessed_sweep_cb, NULL, NULL);
 }
 
 static void on_bus_acquired(GDBusConnection *connection,
@@ -438,6 +640,8 @@ int main(int argc, char** argv)
 
     abrt_init(argv);
 
+    const gint64 startup_us = g_get_monotonic_time();
+
     int parent_pid = getpid();
 
     const char *program_usage_string = _(
@@ -496,6 +700,9 @@ int main(int argc, char** argv)
     guint channel_id_signal_event = 0;
     bool pidfile_created = false;
     struct abrt_inotify_watch *aiw = NULL;
+    GIOChannel *channel_conf = NULL;
+    guint channel_id_conf = 0;
+    bool snapshot_created = false;
     int ret = 1;
 
     /* Initialization */
@@ -503,12 +710,7 @@ int main(int argc, char** argv)
     if (load_abrt_conf() != 0)
         goto init_error;
 
-    /* Moved before daemonization because parent waits for signal from daemon
-     * only for short period and time consumed by
-     * mark_unprocessed_dump_dirs_not_reportable() is slightly unpredictable.
-     */
     sanitize_dump_dir_rights();
-    mark_unprocessed_dump_dirs_not_reportable(g_settings_dump_location);
 
     /* Daemonize unless -d */
     if (!(opts & OPT_d))
@@ -555,6 +757,13 @@ int main(int argc, char** argv)
     aiw = abrt_inotify_watch_init(g_settings_dump_location,
             IN_DUMP_LOCATION_FLAGS, handle_inotify_cb, /*user data*/NULL);
 
+    /* Spare the hooks and the tools parsing of the configuration files.
+     * Must be done by the daemonized process, the snapshot is valid only
+     * while its writer lives.
+     */
+    channel_conf = conf_watch_init(&channel_id_conf);
+    snapshot_created = save_abrt_conf_snapshot() == 0;
+
     /* Add an event source which waits for INT/TERM signal */
     log_notice("Adding signal pipe watch to glib main loop");
     channel_signal = abrt_gio_channel_unix_new(s_signal_pipe[0]);
@@ -570,6 +779,12 @@ int main(int argc, char** argv)
         goto init_error;
     pidfile_created = true;
 
+    /* Deferred to the main loop, the time consumed by the sweep is
+     * unpredictable and new problems must not wait for it. Only the list of
+     * the directories must be taken before new problems can come.
+     */
+    mark_unprocessed_dump_dirs_not_reportable(g_settings_dump_location);
+
     /* Open socket to receive new problem data (from python etc). */
     dumpsocket_init();
 
@@ -597,7 +812,8 @@ int main(int argc, char** argv)
     start_idle_timeout();
 
     /* Enter the event loop */
-    log_debug("Init complete, entering main loop");
+    log_notice("Init complete in %"G_GINT64_FORMAT" ms, entering main loop",
+            (g_get_monotonic_time() - startup_us) / 1000);
     g_main_loop_run(s_main_loop);
 
     ret = 0;
@@ -620,9 +836,17 @@ int main(int argc, char** argv)
     /* Error or INT/TERM. Clean up, in reverse order.
      * Take care to not undo things we did not do.
      */
+    unprocessed_sweep_destroy();
     dumpsocket_shutdown();
     if (pidfile_created)
         unlink(VAR_RUN_PIDFILE);
+    if (snapshot_created)
+        remove_abrt_conf_snapshot();
+
+    if (channel_id_conf > 0)
+        g_source_remove(channel_id_conf);
+    if (channel_conf)
+        g_io_channel_unref(channel_conf);
 
     if (channel_id_signal_event > 0)
         g_source_remove(channel_id_signal_event);
@@ -19,12 +19,69 @@
 #include "libabrt.h"
 #include "rpm.h"
 
+#include <rpm/rpmfileutil.h>
+
 /**
 * A set, which contains finger prints.
 */
 
 static GList *list_fingerprints = NULL;
 
+/* Transaction sets of the queried roots, i.e. their opened rpm databases.
+ * Opening a database is the most expensive part of a query and the package
+ * and the component of a crashed executable are usually looked up in the
+ * root of the process and then in the host's root, so the transaction sets
+ * are reused by all queries of the same root in this process. The cache does
+ * not outlive the process, e.g. one run of abrt-action-save-package-data.
+ *
+ * key: the root directory, "/" for the host
+ * value: rpmts
+ */
+static GHashTable *rpm_roots = NULL;
+
+/* Returns true if there is an rpm database in root */
+static bool rpm_root_has_db(const char *root)
+{
+    char *dbpath = rpmGenPath(root, "%{_dbpath}", NULL);
+    struct stat st;
+    const bool exists = stat(dbpath, &st) == 0;
+    free(dbpath);
+    return exists;
+}
+
+/* Sets ts to the cached transaction set for rootdir_or_NULL or to NULL if
+ * the root has no rpm database. The transaction set is freed in rpm_destroy().
+ * Returns -1 if rootdir_or_NULL can't be used as rpm root.
+ */
+static int rpm_get_ts(rpmts *ts, const char *rootdir_or_NULL)
+{
+    if (!rpm_roots)
+        rpm_roots = g_hash_table_new_full(g_str_hash, g_str_equal, free, (GDestroyNotify)rpmtsFree);
+
+    const char *root = rootdir_or_NULL ? rootdir_or_NULL : "/";
+    *ts = g_hash_table_lookup(rpm_roots, root);
+    if (*ts)
+        return 0;
+
+    if (!rpm_root_has_db(root))
+    {
+        log_notice("No rpm database in '%s'", root);
+        return 0;
+    }
+
+    *ts = rpmtsCreate();
+    if (rootdir_or_NULL && rpmtsSetRootDir(*ts, rootdir_or_NULL) != 0)
+    {
+        rpmtsFree(*ts);
+        *ts = NULL;
+        return -1;
+    }
+
+    log_debug("Opening rpm database of '%s'", root);
+    g_hash_table_insert(rpm_roots, xstrdup(root), *ts);
+    return 0;
+}
+
 /* cuts the name from the NVR format: foo-1.2.3-1.el6
    returns a newly allocated string
 */
@@ -61,6 +118,13 @@ void rpm_init()
 
 void rpm_destroy()
 {
+    /* Close the cached databases first */
+    if (rpm_roots)
+    {
+        g_hash_table_destroy(rpm_roots);
+        rpm_roots = NULL;
+    }
+
     /* Mirroring the order of deinit calls in rpm-4.11.1/lib/poptALL.c::rpmcliFini() */
     rpmFreeCrypto();
     rpmFreeMacros(NULL);
@@ -103,7 +167,10 @@ int rpm_chk_fingerprint(const char* pkg)
     char *pgpsig = NULL;
     const char *errmsg = NULL;
 
-    rpmts ts = rpmtsCreate();
+    rpmts ts;
+    if (rpm_get_ts(&ts, NULL) < 0 || !ts)
+        return 0;
+
     rpmdbMatchIterator iter = rpmtsInitIterator(ts, RPMTAG_NAME, pkg, 0);
     Header header = rpmdbNextIterator(iter);
 
@@ -129,7 +196,6 @@ int rpm_chk_fingerprint(const char* pkg)
 error:
     free(pgpsig);
     rpmdbFreeIterator(iter);
-    rpmtsFree(ts);
     return ret;
 }
 
@@ -173,35 +239,31 @@ error:
 }
 */
 
-static int rpm_query_file(rpmts *ts, rpmdbMatchIterator *iter, Header *header,
+static int rpm_query_file(rpmdbMatchIterator *iter, Header *header,
         const char *filename, const char *rootdir_or_NULL)
 {
     const char *queryname = filename;
 
-    *ts = rpmtsCreate();
+    rpmts ts;
+    if (rpm_get_ts(&ts, rootdir_or_NULL) < 0)
+        return -1;
+
     if (rootdir_or_NULL)
     {
-        if (rpmtsSetRootDir(*ts, rootdir_or_NULL) != 0)
-        {
-            rpmtsFree(*ts);
-            return -1;
-        }
-
         unsigned len = strlen(rootdir_or_NULL);
         /* remove 'chroot' prefix */
         if (strncmp(filename, rootdir_or_NULL, len) == 0 && filename[len] == '/')
             queryname += len;
     }
 
-    *iter = rpmtsInitIterator(*ts, RPMTAG_BASENAMES, queryname, 0);
-    *header = rpmdbNextIterator(*iter);
+    *iter = ts ? rpmtsInitIterator(ts, RPMTAG_BASENAMES, queryname, 0) : NULL;
+    *header = *iter ? rpmdbNextIterator(*iter) : NULL;
 
     if (!(*header) && rootdir_or_NULL)
     {
         rpmdbFreeIterator(*iter);
-        rpmtsFree(*ts);
 
-        return rpm_query_file(ts, iter, header, filename, NULL);
+        return rpm_query_file(iter, header, filename, NULL);
     }
 
     return 0;
@@ -211,11 +273,10 @@ char* rpm_get_component(const char *filename, const char *rootdir_or_NULL)
 {
     char *ret = NULL;
     char *srpm = NULL;
-    rpmts ts;
     rpmdbMatchIterator iter;
     Header header;
 
-    if (rpm_query_file(&ts, &iter, &header, filename, rootdir_or_NULL) < 0)
+    if (rpm_query_file(&iter, &header, filename, rootdir_or_NULL) < 0)
         return NULL;
 
     if (!header)
@@ -234,7 +295,6 @@ char* rpm_get_component(const char *filename, const char *rootdir_or_NULL)
 
  error:
     rpmdbFreeIterator(iter);
-    rpmtsFree(ts);
     return ret;
 }
 
@@ -260,13 +320,12 @@ pkg_add_id(arch);
 // caller is responsible to free returned value
 struct pkg_envra *rpm_get_package_nvr(const char *filename, const char *rootdir_or_NULL)
 {
-    rpmts ts;
     rpmdbMatchIterator iter;
     Header header;
 
     struct pkg_envra *p = NULL;
 
-    if (rpm_query_file(&ts, &iter, &header, filename, rootdir_or_NULL) < 0)
+    if (rpm_query_file(&iter, &header, filename, rootdir_or_NULL) < 0)
         return NULL;
 
     if (!header)
@@ -306,14 +365,12 @@ struct pkg_envra *rpm_get_package_nvr(const char *filename, const char *rootdir_
     p->p_nvr = xasprintf("%s-%s-%s", p->p_name, p->p_version, p->p_release);
 
     rpmdbFreeIterator(iter);
-    rpmtsFree(ts);
     return p;
 
  error:
     free_pkg_envra(p);
 
     rpmdbFreeIterator(iter);
-    rpmtsFree(ts);
     return NULL;
 }
 
@@ -55,7 +55,10 @@ static GQuark abrt_authorization_error_quark()
 
 
 const char *g_default_xml =
-"<node><interface name=\"com.redhat.problems.configuration\"><method name=\"SetDefault\"><arg name=\"name\" type=\"s\" direction=\"in\" /></method></interface></node>";
+"<node><interface name=\"com.redhat.problems.configuration\">"
+"<method name=\"SetDefault\"><arg name=\"name\" type=\"s\" direction=\"in\" /></method>"
+"<method name=\"SetProperties\"><arg name=\"properties\" type=\"a{sv}\" direction=\"in\" /></method>"
+"</interface></node>";
 
 GDBusNodeInfo *g_default_node;
 
@@ -86,14 +89,16 @@ static void reset_timeout(void)
  * Each configuration has the working file and the default file.  It is
  * expected that the default configuration file remains unchanged while the
  * program is running, so the parsed file can be cached. But the working file
- * can be modified from various source, therefore we must parse the file upon
- * each request.
+ * can be modified from various source, therefore the parsed working file is
+ * used only until the inode, size or modification time of the file changes.
  */
 typedef struct _configuration
 {
     char *file_path;        ///< Path to the working file
     char *def_file_path;    ///< Path to the default file
     map_string_t *def;      ///< The default configuration
+    map_string_t *merged;   ///< The default configuration overridden by the working file
+    struct stat merged_st;  ///< Status of the working file when 'merged' was loaded
 }
 configuration_t;
 
@@ -103,12 +108,16 @@ typedef GVariant *(*configuration_getter_fn)(configuration_t *conf,
 typedef bool      (*configuration_setter_fn)(configuration_t *conf,
         const char *option, GVariant *variant, GError **error);
 
+typedef void      (*configuration_transform_fn)(map_string_t *conf,
+        const char *option, GVariant *variant);
+
 static configuration_t *configuration_new(const char *file_path, const char *def_file_path)
 {
     configuration_t *self = xmalloc(sizeof(*self));
     self->file_path = xstrdup(file_path);
     self->def_file_path = xstrdup(def_file_path);
     self->def = NULL;
+    self->merged = NULL;
 
     return self;
 }
@@ -140,6 +149,9 @@ static void configuration_free(configuration_t *self)
     free_map_string(self->def);
     self->def = NULL;
 
+    free_map_string(self->merged);
+    self->merged = NULL;
+
     free(self);
 }
 
@@ -306,6 +318,20 @@ static bool configuration_set_int(configuration_t *self, const char *option, GVa
     return configuration_set_gvariant(self, option, value, int32_from_gvariant, error);
 }
 
+static configuration_transform_fn configuration_transform_factory(GVariantType *type)
+{
+    if (g_variant_type_equal(G_VARIANT_TYPE_BOOLEAN, type))
+        return bool_from_gvariant;
+    else if (g_variant_type_equal(G_VARIANT_TYPE_INT32, type))
+        return int32_from_gvariant;
+    else if (g_variant_type_equal(G_VARIANT_TYPE_STRING, type))
+        return string_from_gvariant;
+    else if (g_variant_type_equal(G_VARIANT_TYPE_STRING_ARRAY, type))
+        return string_vector_from_gvariant;
+
+    return NULL;
+}
+
 static configuration_setter_fn configuration_setter_factory(GVariantType *type)
 {
     if (g_variant_type_equal(G_VARIANT_TYPE_BOOLEAN, type))
@@ -324,17 +350,29 @@ static configuration_setter_fn configuration_setter_factory(GVariantType *type)
  * Getters
  */
 
-/* Gets the configuration option's value as GVariant
+/* Returns the working configuration merged into the default one.
  *
- * Converts the GVariant to the underlaying type via 'transform' function.
+ * The result is owned by 'self' and is valid until the next call.
  */
-static GVariant *configuration_get_gvariant(configuration_t *self, const char *option,
-        GVariant *(*transform)(map_string_t *conf, const char *option),
-        GError **error)
+static map_string_t *configuration_get_merged(configuration_t *self, GError **error)
 {
     map_string_t *const def_conf = configuration_get_default(self, error);
     if (def_conf == NULL)
-        return false;
+        return NULL;
+
+    struct stat st;
+    if (stat(self->file_path, &st) != 0)
+        memset(&st, 0, sizeof(st));
+
+    if (self->merged != NULL
+        && st.st_dev == self->merged_st.st_dev
+        && st.st_ino == self->merged_st.st_ino
+        && st.st_size == self->merged_st.st_size
+        && st.st_mtim.tv_sec == self->merged_st.st_mtim.tv_sec
+        && st.st_mtim.tv_nsec == self->merged_st.st_mtim.tv_nsec)
+        return self->merged;
+
+    free_map_string(self->merged);
 
     /* BEGIN: clone_map_string() */
     map_string_t *conf = new_map_string();
@@ -353,8 +391,24 @@ static GVariant *configuration_get_gvariant(configuration_t *self, const char *o
         g_error_free(working_error);
     }
 
+    self->merged = conf;
+    self->merged_st = st;
+    return conf;
+}
+
+/* Gets the configuration option's value as GVariant
+ *
+ * Converts the GVariant to the underlaying type via 'transform' function.
+ */
+static GVariant *configuration_get_gvariant(configuration_t *self, const char *option,
+        GVariant *(*transform)(map_string_t *conf, const char *option),
+        GError **error)
+{
+    map_string_t *const conf = configuration_get_merged(self, error);
+    if (conf == NULL)
+        return false;
+
     GVariant *const retval = transform(conf, option);
-    free_map_string(conf);
     if (!retval)
     {
         g_set_error(error,
@@ -451,11 +505,13 @@ typedef struct _property
     configuration_t *conf;              ///< A configuration which contains this option (Not owned)
     configuration_getter_fn getter;     ///< Getter function
     configuration_setter_fn setter;     ///< Setter function
+    configuration_transform_fn transform; ///< Stores a value in loaded configuration (SetProperties)
 }
 property_t;
 
 static property_t *property_new(const char *name, GVariantType *type, configuration_t *conf,
-        configuration_getter_fn getter, configuration_setter_fn setter)
+        configuration_getter_fn getter, configuration_setter_fn setter,
+        configuration_transform_fn transform)
 {
     property_t *self = xmalloc(sizeof(*self));
 
@@ -465,6 +521,7 @@ static property_t *property_new(const char *name, GVariantType *type, configurat
     self->conf = conf;
     self->getter = getter;
     self->setter = setter;
+    self->transform = transform;
 
     return self;
 }
@@ -595,29 +652,58 @@ static property_t *dbus_conf_node_get_property(dbus_conf_node_t *self, const cha
     return (property_t *)property;
 }
 
-/* SetDefault D-Bus method handler
+/* Emits org.freedesktop.DBus.Properties.PropertiesChanged with the current
+ * values of the properties.
  */
-static void dbus_conf_node_handle_configuration_method_call(GDBusConnection *connection,
-                        const gchar *caller,
-                        const gchar *object_path,
-                        const gchar *interface_name,
-                        const gchar *method_name,
-                        GVariant    *parameters,
-                        GDBusMethodInvocation *invocation,
-                        gpointer    user_data)
+static void dbus_conf_node_emit_properties_changed(dbus_conf_node_t *self,
+                        GDBusConnection *connection,
+                        GList *properties)
 {
-    log_debug("Set Default Property");
+    if (properties == NULL)
+        return;
 
-    reset_timeout();
+    GVariantBuilder changed;
+    g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+    GVariantBuilder invalidated;
+    g_variant_builder_init(&invalidated, G_VARIANT_TYPE("as"));
 
-    if (polkit_check_authorization_dname(caller, "com.redhat.problems.configuration.update") != PolkitYes)
+    for (GList *iter = properties; iter != NULL; iter = g_list_next(iter))
     {
-        log_notice("not authorized");
-        g_dbus_method_invocation_return_dbus_error(invocation,
-                "com.redhat.problems.configuration.AuthFailure",
-                _("Not Authorized"));
-        return;
+        property_t *prop = (property_t *)iter->data;
+
+        GError *error = NULL;
+        GVariant *value = property_get(prop, &error);
+        if (value != NULL)
+            g_variant_builder_add(&changed, "{sv}", prop->name, value);
+        else
+        {
+            g_variant_builder_add(&invalidated, "s", prop->name);
+            g_error_free(error);
+        }
+    }
+
+    GError *error = NULL;
+    if (!g_dbus_connection_emit_signal(connection,
+                /*destination*/NULL,
+                dbus_conf_node_get_path(self),
+                "org.freedesktop.DBus.Properties",
+                "PropertiesChanged",
+                g_variant_new("(sa{sv}as)", dbus_conf_node_get_interface(self)->name, &changed, &invalidated),
+                &error))
+    {
+        log_notice("Could not emit PropertiesChanged on '%s': %s", dbus_conf_node_get_path(self), error->message);
+        g_error_free(error);
     }
+}
+
+/* SetDefault D-Bus method handler
+ */
+static void dbus_conf_node_handle_set_default(dbus_conf_node_t *self,
+                        GDBusConnection *connection,
+                        GVariant    *parameters,
+                        GDBusMethodInvocation *invocation)
+{
+    log_debug("Set Default Property");
 
     const char *property_name = NULL;
     g_variant_get(parameters, "(&s)", &property_name);
@@ -626,7 +712,7 @@ static void dbus_conf_node_handle_configuration_method_call(GDBusConnection *con
 
     GError *error = NULL;
 
-    property_t *prop = dbus_conf_node_get_property((dbus_conf_node_t *)user_data, property_name, &error);
+    property_t *prop = dbus_conf_node_get_property(self, property_name, &error);
     if (prop == NULL || !property_reset(prop, &error))
     {
         g_dbus_method_invocation_return_gerror(invocation, error);
@@ -635,6 +721,135 @@ static void dbus_conf_node_handle_configuration_method_call(GDBusConnection *con
     }
 
     g_dbus_method_invocation_return_value(invocation, NULL);
+
+    GList *changed = g_list_prepend(NULL, prop);
+    dbus_conf_node_emit_properties_changed(self, connection, changed);
+    g_list_free(changed);
+}
+
+/* SetProperties D-Bus method handler
+ *
+ * Checks all the properties first and then loads and saves every affected
+ * configuration file only once. Nothing is written if any of the properties
+ * is unknown or has a wrong type.
+ */
+static void dbus_conf_node_handle_set_properties(dbus_conf_node_t *self,
+                        GDBusConnection *connection,
+                        GVariant    *parameters,
+                        GDBusMethodInvocation *invocation)
+{
+    GVariant *properties = g_variant_get_child_value(parameters, 0);
+    GError *error = NULL;
+    GList *changed = NULL;
+
+    GVariantIter iter;
+    const char *name;
+    GVariant *value;
+    g_variant_iter_init(&iter, properties);
+    while (g_variant_iter_next(&iter, "{&sv}", &name, &value))
+    {
+        property_t *prop = dbus_conf_node_get_property(self, name, &error);
+        if (prop != NULL && prop->transform == NULL)
+            g_set_error(&error,
+                    ABRT_REFLECTION_UNSUPPORTED_TYPE_ERROR, ABRT_REFLECTION_UNSUPPORTED_TYPE_ERROR_CODE,
+                    "Type with signature '%s' is not supported", property_get_type_string(prop));
+        else if (prop != NULL && !g_variant_is_of_type(value, prop->type))
+            g_set_error(&error,
+                    G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Property '%s' has type '%s' but '%s' was given",
+                    name, property_get_type_string(prop), g_variant_get_type_string(value));
+
+        g_variant_unref(value);
+        if (error != NULL)
+            goto ret;
+    }
+
+    for (GSList *conf_iter = self->configurations; conf_iter != NULL; conf_iter = g_slist_next(conf_iter))
+    {
+        configuration_t *conf = (configuration_t *)conf_iter->data;
+        map_string_t *settings = NULL;
+        GList *conf_changed = NULL;
+
+        g_variant_iter_init(&iter, properties);
+        while (g_variant_iter_next(&iter, "{&sv}", &name, &value))
+        {
+            property_t *prop = dbus_conf_node_get_property(self, name, /*checked above*/NULL);
+            if (prop->conf == conf)
+            {
+                if (settings == NULL)
+                    settings = configuration_load_file(conf->file_path,
+                            /*No preloaded configuration*/NULL,
+                            /*Fail on ENOENT*/false,
+                            &error);
+
+                if (settings != NULL)
+                {
+                    prop->transform(settings, prop->name, value);
+                    conf_changed = g_list_prepend(conf_changed, prop);
+                }
+            }
+            g_variant_unref(value);
+
+            if (error != NULL)
+                break;
+        }
+
+        if (settings != NULL)
+        {
+            log_debug("Saving %u options to '%s'", g_list_length(conf_changed), conf->file_path);
+            if (configuration_save_file(conf->file_path, settings, &error))
+                changed = g_list_concat(changed, conf_changed);
+            else
+                g_list_free(conf_changed);
+
+            free_map_string(settings);
+        }
+
+        /* The files saved so far stay saved */
+        if (error != NULL)
+            break;
+    }
+
+ ret:
+    if (error != NULL)
+    {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+    }
+    else
+        g_dbus_method_invocation_return_value(invocation, NULL);
+
+    dbus_conf_node_emit_properties_changed(self, connection, changed);
+    g_list_free(changed);
+    g_variant_unref(properties);
+}
+
+/* com.redhat.problems.configuration D-Bus method handler
+ */
+static void dbus_conf_node_handle_configuration_method_call(GDBusConnection *connection,
+                        const gchar *caller,
+                        const gchar *object_path,
+                        const gchar *interface_name,
+                        const gchar *method_name,
+                        GVariant    *parameters,
+                        GDBusMethodInvocation *invocation,
+                        gpointer    user_data)
+{
+    reset_timeout();
+
+    if (polkit_check_authorization_dname(caller, "com.redhat.problems.configuration.update") != PolkitYes)
+    {
+        log_notice("not authorized");
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                "com.redhat.problems.configuration.AuthFailure",
+                _("Not Authorized"));
+        return;
+    }
+
+    if (g_strcmp0(method_name, "SetProperties") == 0)
+        dbus_conf_node_handle_set_properties((dbus_conf_node_t *)user_data, connection, parameters, invocation);
+    else
+        dbus_conf_node_handle_set_default((dbus_conf_node_t *)user_data, connection, parameters, invocation);
 }
 
 /* Get D-Bus property handler
@@ -690,7 +905,14 @@ static gboolean dbus_conf_node_handle_set_property(GDBusConnection *connection,
     if (prop == NULL)
         return false;
 
-    return property_set(prop, args, error);
+    if (!property_set(prop, args, error))
+        return false;
+
+    GList *changed = g_list_prepend(NULL, prop);
+    dbus_conf_node_emit_properties_changed((dbus_conf_node_t *)user_data, connection, changed);
+    g_list_free(changed);
+
+    return true;
 }
 
 static GDBusInterfaceVTable *dbus_conf_node_get_vtable(dbus_conf_node_t *node)
@@ -846,7 +1068,8 @@ static dbus_conf_node_t *dbus_conf_node_from_node(GDBusNodeInfo *node)
         if (prop_set == NULL)
             error_msg("Property '%s' has unsupported setter type", (*prop_iter)->name);
 
-        property_t *prop = property_new((*prop_iter)->name, prop_type, prop_conf, prop_get, prop_set);
+        property_t *prop = property_new((*prop_iter)->name, prop_type, prop_conf, prop_get, prop_set,
+                configuration_transform_factory(prop_type));
         g_hash_table_replace(properties, (*prop_iter)->name, prop);
     }
 
@@ -13,6 +13,8 @@ static GMainLoop *loop;
 static guint g_timeout_source;
 /* default, settable with -t: */
 static unsigned g_timeout_value = 120;
+/* number of method calls being processed by worker threads */
+static gint g_calls_in_progress;
 
 /* ---------------------------------------------------------------------------------------------------- */
 
@@ -40,6 +42,11 @@ static const gchar introspection_xml[] =
   "      <arg type='as' name='element_names' direction='in'/>"
   "      <arg type='a{ss}' name='response' direction='out'/>"
   "    </method>"
+  "    <method name='GetInfoForProblems'>"
+  "      <arg type='as' name='problem_dirs' direction='in'/>"
+  "      <arg type='as' name='element_names' direction='in'/>"
+  "      <arg type='a{sa{ss}}' name='response' direction='out'/>"
+  "    </method>"
   "    <method name='SetElement'>"
   "      <arg type='s' name='problem_dir' direction='in'/>"
   "      <arg type='s' name='name' direction='in'/>"
@@ -92,29 +99,220 @@ static void reset_timeout(void)
     g_timeout_source = g_timeout_add_seconds(g_timeout_value, on_timeout_cb, NULL);
 }
 
-static uid_t get_caller_uid(GDBusConnection *connection, GDBusMethodInvocation *invocation, const char *caller)
+/*
+ * Credentials of the callers
+ *
+ * Unique bus names are never reused, hence the credentials of a caller
+ * don't change until the caller disconnects from the bus. We keep them, and
+ * the positive polkit verdicts backed by temporary authorizations, until
+ * the bus announces that the unique name has no owner (NameOwnerChanged).
+ * The verdicts are dropped as soon as polkit announces a change of the
+ * authorizations (e.g. a revoked temporary authorization).
+ */
+struct caller_credentials
 {
-    GError *error = NULL;
-    guint caller_uid;
+    uid_t uid;
+    pid_t pid;
+    char *security_label;
+    /* action id -> time_t * until which the caller is authorized */
+    GHashTable *authorizations;
+    /* NameOwnerChanged subscription matching the caller's name */
+    guint name_owner_changed_id;
+};
 
-    GDBusProxy * proxy = g_dbus_proxy_new_sync(connection,
-                                     G_DBUS_PROXY_FLAGS_NONE,
-                                     NULL,
+static GMutex g_callers_mutex;
+/* unique bus name -> struct caller_credentials * */
+static GHashTable *g_callers;
+static GDBusConnection *g_callers_connection;
+/* Incremented whenever the authorizations change, a verdict obtained
+ * before a change is not cached */
+static guint g_authorizations_generation;
+
+static void free_caller_credentials(struct caller_credentials *credentials)
+{
+    if (!credentials)
+        return;
+
+    if (credentials->name_owner_changed_id != 0)
+        g_dbus_connection_signal_unsubscribe(g_callers_connection,
+                                             credentials->name_owner_changed_id);
+    free(credentials->security_label);
+    g_hash_table_destroy(credentials->authorizations);
+    free(credentials);
+}
+
+static void on_name_owner_changed(GDBusConnection *connection,
+                        const gchar *sender_name,
+                        const gchar *object_path,
+                        const gchar *interface_name,
+                        const gchar *signal_name,
+                        GVariant *parameters,
+                        gpointer user_data)
+{
+    const gchar *name;
+    const gchar *old_owner;
+    const gchar *new_owner;
+    g_variant_get(parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+
+    if (name[0] != ':' || new_owner[0] != '\0')
+        return;
+
+    g_mutex_lock(&g_callers_mutex);
+    if (g_hash_table_remove(g_callers, name))
+        log_debug("Forgetting credentials of '%s'", name);
+    g_mutex_unlock(&g_callers_mutex);
+}
+
+static void on_polkit_changed(GDBusConnection *connection,
+                        const gchar *sender_name,
+                        const gchar *object_path,
+                        const gchar *interface_name,
+                        const gchar *signal_name,
+                        GVariant *parameters,
+                        gpointer user_data)
+{
+    log_debug("Authorizations changed, forgetting the cached verdicts");
+
+    g_mutex_lock(&g_callers_mutex);
+    ++g_authorizations_generation;
+    GHashTableIter iter;
+    g_hash_table_iter_init(&iter, g_callers);
+    struct caller_credentials *credentials;
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&credentials))
+        g_hash_table_remove_all(credentials->authorizations);
+    g_mutex_unlock(&g_callers_mutex);
+}
+
+static void init_callers_cache(GDBusConnection *connection)
+{
+    g_callers = g_hash_table_new_full(g_str_hash, g_str_equal,
+            free, (GDestroyNotify)free_caller_credentials);
+    g_callers_connection = connection;
+
+    g_dbus_connection_signal_subscribe(connection,
+            "org.freedesktop.PolicyKit1",
+            "org.freedesktop.PolicyKit1.Authority",
+            "Changed",
+            "/org/freedesktop/PolicyKit1/Authority",
+            NULL,
+            G_DBUS_SIGNAL_FLAGS_NONE,
+            on_polkit_changed,
+            NULL,
+            NULL);
+}
+
+/* The caller must hold g_callers_mutex */
+static void subscribe_name_owner_changed(struct caller_credentials *credentials, const char *caller)
+{
+    credentials->name_owner_changed_id = g_dbus_connection_signal_subscribe(g_callers_connection,
+            "org.freedesktop.DBus",
+            "org.freedesktop.DBus",
+            "NameOwnerChanged",
+            "/org/freedesktop/DBus",
+            caller,
+            G_DBUS_SIGNAL_FLAGS_NONE,
+            on_name_owner_changed,
+            NULL,
+            NULL);
+}
+
+static GVariant *call_bus_driver(GDBusConnection *connection, const char *method,
+        const char *caller, const GVariantType *reply_type, GError **error)
+{
+    return g_dbus_connection_call_sync(connection,
                                      "org.freedesktop.DBus",
                                      "/org/freedesktop/DBus",
                                      "org.freedesktop.DBus",
-                                     NULL,
-                                     &error);
-
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                     "GetConnectionUnixUser",
-                                     g_variant_new ("(s)", caller),
+                                     method,
+                                     g_variant_new("(s)", caller),
+                                     reply_type,
                                      G_DBUS_CALL_FLAGS_NONE,
                                      -1,
                                      NULL,
-                                     &error);
+                                     error);
+}
+
+/* Asks the bus for uid, pid and security label of the caller at once.
+ * Falls back to GetConnectionUnixUser on buses not knowing
+ * GetConnectionCredentials.
+ */
+static struct caller_credentials *load_caller_credentials(GDBusConnection *connection,
+        const char *caller, GError **error)
+{
+    GVariant *result = call_bus_driver(connection, "GetConnectionCredentials", caller,
+                                     G_VARIANT_TYPE("(a{sv})"), error);
+
+    struct caller_credentials *credentials = NULL;
+    if (result != NULL)
+    {
+        GVariant *dict = g_variant_get_child_value(result, 0);
+
+        guint32 uid;
+        if (g_variant_lookup(dict, "UnixUserID", "u", &uid))
+        {
+            credentials = xzalloc(sizeof(*credentials));
+            credentials->uid = uid;
+
+            guint32 pid;
+            if (g_variant_lookup(dict, "ProcessID", "u", &pid))
+                credentials->pid = pid;
+
+            /* The label is a byte array including the terminating '\0' */
+            GVariant *label = g_variant_lookup_value(dict, "LinuxSecurityLabel", G_VARIANT_TYPE_BYTESTRING);
+            if (label != NULL)
+            {
+                credentials->security_label = xstrdup(g_variant_get_bytestring(label));
+                g_variant_unref(label);
+            }
+        }
+        else
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                    "The bus didn't provide UID of '%s'", caller);
+
+        g_variant_unref(dict);
+        g_variant_unref(result);
+    }
+    else if (g_error_matches(*error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD))
+    {
+        g_clear_error(error);
+        result = call_bus_driver(connection, "GetConnectionUnixUser", caller,
+                                     G_VARIANT_TYPE("(u)"), error);
+        if (result != NULL)
+        {
+            guint32 uid;
+            g_variant_get(result, "(u)", &uid);
+            g_variant_unref(result);
+
+            credentials = xzalloc(sizeof(*credentials));
+            credentials->uid = uid;
+        }
+    }
+
+    if (credentials != NULL)
+        credentials->authorizations = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+
+    return credentials;
+}
+
+static uid_t get_caller_uid(GDBusConnection *connection, GDBusMethodInvocation *invocation, const char *caller)
+{
+    uid_t caller_uid = (uid_t) -1;
+
+    g_mutex_lock(&g_callers_mutex);
+    struct caller_credentials *credentials = g_hash_table_lookup(g_callers, caller);
+    if (credentials != NULL)
+        caller_uid = credentials->uid;
+    g_mutex_unlock(&g_callers_mutex);
 
-    if (result == NULL)
+    if (caller_uid != (uid_t) -1)
+    {
+        log_info("Caller uid: %i", caller_uid);
+        return caller_uid;
+    }
+
+    GError *error = NULL;
+    credentials = load_caller_credentials(connection, caller, &error);
+    if (credentials == NULL)
     {
         /* we failed to get the uid, so return (uid_t) -1 to indicate the error
          */
@@ -134,13 +332,96 @@ static uid_t get_caller_uid(GDBusConnection *connection, GDBusMethodInvocation *
         return (uid_t) -1;
     }
 
-    g_variant_get(result, "(u)", &caller_uid);
-    g_variant_unref(result);
+    caller_uid = credentials->uid;
+    log_info("Caller uid: %i, pid: %i, label: %s", caller_uid, credentials->pid,
+            credentials->security_label ? credentials->security_label : "none");
+
+    /* Another worker thread might have been faster */
+    bool inserted = false;
+    g_mutex_lock(&g_callers_mutex);
+    if (!g_hash_table_contains(g_callers, caller))
+    {
+        subscribe_name_owner_changed(credentials, caller);
+        g_hash_table_insert(g_callers, xstrdup(caller), credentials);
+        credentials = NULL;
+        inserted = true;
+    }
+    g_mutex_unlock(&g_callers_mutex);
+
+    /* The bus handles our messages in order, if the caller disconnected
+     * before the subscription took effect, it has no owner now */
+    if (inserted)
+    {
+        GVariant *has_owner = call_bus_driver(connection, "NameHasOwner", caller,
+                                              G_VARIANT_TYPE("(b)"), NULL);
+        gboolean owned = TRUE;
+        if (has_owner != NULL)
+        {
+            g_variant_get(has_owner, "(b)", &owned);
+            g_variant_unref(has_owner);
+        }
+
+        if (!owned)
+        {
+            g_mutex_lock(&g_callers_mutex);
+            g_hash_table_remove(g_callers, caller);
+            g_mutex_unlock(&g_callers_mutex);
+        }
+    }
+
+    free_caller_credentials(credentials);
 
-    log_info("Caller uid: %i", caller_uid);
     return caller_uid;
 }
 
+/* Checks the authorization through polkit unless the caller is still known
+ * to hold a temporary authorization for the action.
+ */
+static PolkitResult check_caller_authorization(const char *caller, const char *action_id)
+{
+    const time_t now = time(NULL);
+    PolkitResult result = PolkitUnknown;
+
+    g_mutex_lock(&g_callers_mutex);
+    struct caller_credentials *credentials = g_hash_table_lookup(g_callers, caller);
+    if (credentials != NULL)
+    {
+        time_t *valid_until = g_hash_table_lookup(credentials->authorizations, action_id);
+        if (valid_until != NULL && *valid_until > now)
+            result = PolkitYes;
+        else if (valid_until != NULL)
+            g_hash_table_remove(credentials->authorizations, action_id);
+    }
+    g_mutex_unlock(&g_callers_mutex);
+
+    if (result == PolkitYes)
+    {
+        log_debug("'%s' is still authorized for '%s'", caller, action_id);
+        return result;
+    }
+
+    g_mutex_lock(&g_callers_mutex);
+    const guint generation = g_authorizations_generation;
+    g_mutex_unlock(&g_callers_mutex);
+
+    time_t valid_until = 0;
+    result = polkit_check_authorization_dname_ext(caller, action_id, &valid_until);
+    if (result != PolkitYes || valid_until <= now)
+        return result;
+
+    g_mutex_lock(&g_callers_mutex);
+    credentials = g_hash_table_lookup(g_callers, caller);
+    if (credentials != NULL && generation == g_authorizations_generation)
+    {
+        time_t *expires = xmalloc(sizeof(*expires));
+        *expires = valid_until;
+        g_hash_table_replace(credentials->authorizations, xstrdup(action_id), expires);
+    }
+    g_mutex_unlock(&g_callers_mutex);
+
+    return result;
+}
+
 bool allowed_problem_dir(const char *dir_name)
 {
     if (!dir_is_in_dump_location(dir_name))
@@ -149,7 +430,11 @@ bool allowed_problem_dir(const char *dir_name)
         return false;
     }
 
-    if (!dir_has_correct_permissions(dir_name, DD_PERM_DAEMONS))
+    problem_api_lock_nss();
+    const bool correct_permissions = dir_has_correct_permissions(dir_name, DD_PERM_DAEMONS);
+    problem_api_unlock_nss();
+
+    if (!correct_permissions)
     {
         error_msg("Problem directory '%s' has invalid owner, groop or mode", dir_name);
         return false;
@@ -203,9 +488,15 @@ static char *handle_new_problem(GVariant *problem_info, uid_t caller_uid, char *
     /* At least it should generate local problem identifier UUID */
     problem_data_add_basics(pd);
 
+    /* dd_create() looks up the owner's group */
+    problem_api_lock_nss();
     problem_id = problem_data_save(pd);
+    problem_api_unlock_nss();
     if (problem_id)
+    {
+        dump_location_usage_add(g_settings_dump_location, get_dirsize(problem_id));
         notify_new_path(problem_id);
+    }
     else if (error)
         *error = xasprintf("Cannot create a new problem");
 
@@ -251,7 +542,11 @@ static struct dump_dir *open_dump_directory(GDBusMethodInvocation *invocation,
         return NULL;
     }
 
-    if (!dd_accessible_by_uid(dd, caller_uid))
+    problem_api_lock_nss();
+    const bool accessible = dd_accessible_by_uid(dd, caller_uid);
+    problem_api_unlock_nss();
+
+    if (!accessible)
     {
         if (errno == ENOTDIR)
         {
@@ -263,7 +558,7 @@ static struct dump_dir *open_dump_directory(GDBusMethodInvocation *invocation,
         }
 
         if (   !(flags & OPEN_AUTH_ASK)
-            || polkit_check_authorization_dname(caller, "org.freedesktop.problems.getall") != PolkitYes)
+            || check_caller_authorization(caller, "org.freedesktop.problems.getall") != PolkitYes)
         {
             log_notice("not authorized");
             if (!(flags & OPEN_FAIL_NO_REPLY))
@@ -287,6 +582,36 @@ static struct dump_dir *open_dump_directory(GDBusMethodInvocation *invocation,
     return dd;
 }
 
+/*
+ * Loads the requested elements into a{ss} variant builder.
+ *
+ * Returns NULL if no element was found.
+ */
+static GVariantBuilder *load_elements_to_builder(struct dump_dir *dd, GList *elements)
+{
+    GVariantBuilder *builder = NULL;
+    for (GList *l = elements; l; l = l->next)
+    {
+        const char *element_name = (const char*)l->data;
+        char *value = dd_load_text_ext(dd, element_name, 0
+                                            | DD_LOAD_TEXT_RETURN_NULL_ON_FAILURE
+                                            | DD_FAIL_QUIETLY_ENOENT
+                                            | DD_FAIL_QUIETLY_EACCES);
+        log_notice("element '%s' %s", element_name, value ? "fetched" : "not found");
+        if (value)
+        {
+            if (!builder)
+                builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
+
+            /* g_variant_builder_add makes a copy. No need to xstrdup here */
+            g_variant_builder_add(builder, "{ss}", element_name, value);
+            free(value);
+        }
+    }
+
+    return builder;
+}
+
 /*
  * Checks element's rights and does not open directory if element is protected.
  * Checks problem's rights and does not open directory if user hasn't got
@@ -332,6 +657,19 @@ static struct dump_dir *open_directory_for_modification_of_element(
  * Lists problems which have given element and were seen in given time interval
  */
 
+struct element_to_save {
+    struct dump_dir *dd;
+    const char *name;
+    const char *value;
+};
+
+static int save_element(void *arg)
+{
+    struct element_to_save *save = arg;
+    dd_save_text(save->dd, save->name, save->value);
+    return 0;
+}
+
 struct field_and_time_range {
     GList *list;
     const char *element;
@@ -383,17 +721,13 @@ static GList *get_problem_dirs_for_element_in_time(uid_t uid,
 }
 
 
-static void handle_method_call(GDBusConnection *connection,
+/* Runs in a worker thread, see handle_method_call() */
+static void process_method_call(GDBusConnection *connection,
                         const gchar *caller,
-                        const gchar *object_path,
-                        const gchar *interface_name,
                         const gchar *method_name,
                         GVariant    *parameters,
-                        GDBusMethodInvocation *invocation,
-                        gpointer    user_data)
+                        GDBusMethodInvocation *invocation)
 {
-    reset_timeout();
-
     uid_t caller_uid;
     GVariant *response;
 
@@ -445,7 +779,7 @@ static void handle_method_call(GDBusConnection *connection,
         */
         if (caller_uid != 0)
         {
-            if (polkit_check_authorization_dname(caller, "org.freedesktop.problems.getall") == PolkitYes)
+            if (check_caller_authorization(caller, "org.freedesktop.problems.getall") == PolkitYes)
                 caller_uid = 0;
         }
 
@@ -488,7 +822,9 @@ static void handle_method_call(GDBusConnection *connection,
             return;
         }
 
+        problem_api_lock_nss();
         int ddstat = dd_stat_for_uid(dd, caller_uid);
+        problem_api_unlock_nss();
         if (ddstat < 0)
         {
             if (errno == ENOTDIR)
@@ -512,7 +848,7 @@ static void handle_method_call(GDBusConnection *connection,
          */
 
         if ((ddstat & DD_STAT_ACCESSIBLE_BY_UID) == 0 &&
-                polkit_check_authorization_dname(caller, "org.freedesktop.problems.getall") != PolkitYes)
+                check_caller_authorization(caller, "org.freedesktop.problems.getall") != PolkitYes)
         {
             log_notice("not authorized");
             g_dbus_method_invocation_return_dbus_error(invocation,
@@ -529,7 +865,9 @@ static void handle_method_call(GDBusConnection *connection,
             return;
         }
 
+        problem_api_lock_nss();
         int chown_res = dd_chown(dd, caller_uid);
+        problem_api_unlock_nss();
         if (chown_res != 0)
             g_dbus_method_invocation_return_dbus_error(invocation,
                                               "org.freedesktop.problems.ChownError",
@@ -560,25 +898,7 @@ static void handle_method_call(GDBusConnection *connection,
         GList *elements = string_list_from_variant(array);
         g_variant_unref(array);
 
-        GVariantBuilder *builder = NULL;
-        for (GList *l = elements; l; l = l->next)
-        {
-            const char *element_name = (const char*)l->data;
-            char *value = dd_load_text_ext(dd, element_name, 0
-                                                | DD_LOAD_TEXT_RETURN_NULL_ON_FAILURE
-                                                | DD_FAIL_QUIETLY_ENOENT
-                                                | DD_FAIL_QUIETLY_EACCES);
-            log_notice("element '%s' %s", element_name, value ? "fetched" : "not found");
-            if (value)
-            {
-                if (!builder)
-                    builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
-
-                /* g_variant_builder_add makes a copy. No need to xstrdup here */
-                g_variant_builder_add(builder, "{ss}", element_name, value);
-                free(value);
-            }
-        }
+        GVariantBuilder *builder = load_elements_to_builder(dd, elements);
         list_free_with_free(elements);
         dd_close(dd);
         /* It is OK to call g_variant_new("(a{ss})", NULL) because */
@@ -593,6 +913,65 @@ static void handle_method_call(GDBusConnection *connection,
         return;
     }
 
+    if (g_strcmp0(method_name, "GetInfoForProblems") == 0)
+    {
+        /* Parameter tuple is (asas), string_list_from_variant() consumes the reference */
+        GList *problem_dirs = string_list_from_variant(g_variant_get_child_value(parameters, 0));
+        GList *elements = string_list_from_variant(g_variant_get_child_value(parameters, 1));
+
+        /* Inaccessible and invalid problems are silently omitted from the
+         * response in order to not fail the whole batch. The caller is
+         * asked for authorization at most once per call.
+         */
+        if (caller_uid != 0)
+        {
+            for (GList *l = problem_dirs; l; l = l->next)
+            {
+                const char *problem_dir = (const char *)l->data;
+                if (!dir_is_in_dump_location(problem_dir))
+                    continue;
+
+                problem_api_lock_nss();
+                const bool accessible = dump_dir_accessible_by_uid(problem_dir, caller_uid);
+                problem_api_unlock_nss();
+
+                if (!accessible && errno != ENOTDIR)
+                {
+                    if (check_caller_authorization(caller, "org.freedesktop.problems.getall") == PolkitYes)
+                        caller_uid = 0;
+                    break;
+                }
+            }
+        }
+
+        GVariantBuilder *response_builder = g_variant_builder_new(G_VARIANT_TYPE("a{sa{ss}}"));
+        for (GList *l = problem_dirs; l; l = l->next)
+        {
+            const char *problem_dir = (const char *)l->data;
+            struct dump_dir *dd = open_dump_directory(invocation, caller, caller_uid,
+                    problem_dir, DD_OPEN_READONLY | DD_FAIL_QUIETLY_EACCES, OPEN_FAIL_NO_REPLY);
+            if (!dd)
+                continue;
+
+            GVariantBuilder *builder = load_elements_to_builder(dd, elements);
+            dd_close(dd);
+
+            g_variant_builder_add(response_builder, "{sa{ss}}", problem_dir, builder);
+            if (builder)
+                g_variant_builder_unref(builder);
+        }
+        list_free_with_free(elements);
+
+        GVariant *response = g_variant_new("(a{sa{ss}})", response_builder);
+        g_variant_builder_unref(response_builder);
+
+        log_info("GetInfoForProblems: returning values for %u problems", g_list_length(problem_dirs));
+        list_free_with_free(problem_dirs);
+
+        g_dbus_method_invocation_return_value(invocation, response);
+        return;
+    }
+
     if (g_strcmp0(method_name, "GetProblemData") == 0)
     {
         /* Parameter tuple is (s) */
@@ -670,9 +1049,11 @@ static void handle_method_call(GDBusConnection *connection,
         }
 
         const double requested_size = (double)strlen(value) - item_size;
-        /* Don't want to check the size limit in case of reducing of size */
-        if (requested_size > 0
-            && requested_size > (max_dir_size - get_dirsize(g_settings_dump_location)))
+        struct element_to_save save = { .dd = dd, .name = element, .value = value };
+        /* The check, the save and the usage update run under one lock, so
+         * concurrent SetElement calls can't exceed the limit together */
+        if (dump_location_usage_reserve(g_settings_dump_location, max_dir_size,
+                                        requested_size, save_element, &save) != 0)
         {
             log_notice("No problem space left in '%s' (requested Bytes %f)", problem_id, requested_size);
             g_dbus_method_invocation_return_dbus_error(invocation,
@@ -680,10 +1061,7 @@ static void handle_method_call(GDBusConnection *connection,
                                                       _("No problem space left"));
         }
         else
-        {
-            dd_save_text(dd, element, value);
             g_dbus_method_invocation_return_value(invocation, NULL);
-        }
 
         dd_close(dd);
 
@@ -706,9 +1084,13 @@ static void handle_method_call(GDBusConnection *connection,
             /* Already logged from open_directory_for_modification_of_element() */
             return;
 
+        const long item_size = dd_get_item_size(dd, element);
         const int res = dd_delete_item(dd, element);
         dd_close(dd);
 
+        if (res == 0 && item_size > 0)
+            dump_location_usage_add(g_settings_dump_location, -(double)item_size);
+
         if (res != 0)
         {
             log_notice("Can't delete the element '%s' from the problem directory '%s'", element, problem_id);
@@ -779,11 +1161,14 @@ static void handle_method_call(GDBusConnection *connection,
 
             if (dd)
             {
+                const double dir_size = get_dirsize(dir_name);
                 if (dd_delete(dd) != 0)
                 {
                     error_msg("Failed to delete problem directory '%s'", dir_name);
                     dd_close(dd);
                 }
+                else
+                    dump_location_usage_add(g_settings_dump_location, -dir_size);
             }
         }
 
@@ -810,7 +1195,7 @@ static void handle_method_call(GDBusConnection *connection,
         if (!allowed_problem_element(invocation, element))
             return;
 
-        if (all && polkit_check_authorization_dname(caller, "org.freedesktop.problems.getall") == PolkitYes)
+        if (all && check_caller_authorization(caller, "org.freedesktop.problems.getall") == PolkitYes)
             caller_uid = 0;
 
         GList *dirs = get_problem_dirs_for_element_in_time(caller_uid, element, value, timestamp_from,
@@ -821,6 +1206,232 @@ static void handle_method_call(GDBusConnection *connection,
         g_dbus_method_invocation_return_value(invocation, response);
         return;
     }
+}
+
+/*
+ * Problem directories being accessed by method calls
+ *
+ * dd_lock() uses PID as the owner of a lock, hence it serializes processes
+ * but not threads of abrt-dbus. Even a read-only dd_opendir() takes the lock
+ * and its dd_close() removes it, so a reader could unlock a directory in the
+ * middle of a modification. The calls are serialized here instead: a problem
+ * directory is either read by any number of calls or modified by one call,
+ * and nothing is modified while all problems are being scanned.
+ *
+ * The table maps the real path of a directory to the number of its readers,
+ * or to PROBLEM_DIR_MODIFIED.
+ */
+#define PROBLEM_DIR_MODIFIED -1
+
+static GMutex g_busy_dirs_mutex;
+static GCond g_busy_dirs_cond;
+static GHashTable *g_busy_dirs;
+static unsigned g_problem_scans;
+static unsigned g_problem_writers;
+
+enum problem_dirs_access {
+    /* reads the problems passed in the first argument */
+    PROBLEM_DIRS_READ,
+    /* modifies the problems passed in the first argument */
+    PROBLEM_DIRS_MODIFY,
+    /* creates a new problem */
+    PROBLEM_DIRS_CREATE,
+    /* reads all problems in the dump location */
+    PROBLEM_DIRS_SCAN,
+};
+
+static bool any_problem_dir_busy(GList *problem_dirs, bool modify)
+{
+    for (GList *l = problem_dirs; l; l = l->next)
+    {
+        gpointer readers;
+        if (!g_hash_table_lookup_extended(g_busy_dirs, l->data, NULL, &readers))
+            continue;
+
+        if (modify || GPOINTER_TO_INT(readers) == PROBLEM_DIR_MODIFIED)
+            return true;
+    }
+
+    return false;
+}
+
+/* Waits until none of the directories is in conflicting use and marks all of
+ * them at once to prevent dead locks. */
+static void lock_problem_dirs(GList *problem_dirs, enum problem_dirs_access access)
+{
+    const bool modify = access == PROBLEM_DIRS_MODIFY || access == PROBLEM_DIRS_CREATE;
+
+    g_mutex_lock(&g_busy_dirs_mutex);
+    if (access == PROBLEM_DIRS_SCAN)
+    {
+        while (g_problem_writers)
+            g_cond_wait(&g_busy_dirs_cond, &g_busy_dirs_mutex);
+        ++g_problem_scans;
+    }
+    else
+    {
+        /* Counted already while waiting, the scans mustn't starve writers */
+        if (modify)
+            ++g_problem_writers;
+        while ((modify && g_problem_scans) || any_problem_dir_busy(problem_dirs, modify))
+            g_cond_wait(&g_busy_dirs_cond, &g_busy_dirs_mutex);
+    }
+
+    for (GList *l = problem_dirs; l; l = l->next)
+    {
+        const int readers = GPOINTER_TO_INT(g_hash_table_lookup(g_busy_dirs, l->data));
+        g_hash_table_insert(g_busy_dirs, xstrdup(l->data),
+                            GINT_TO_POINTER(modify ? PROBLEM_DIR_MODIFIED : readers + 1));
+    }
+    g_mutex_unlock(&g_busy_dirs_mutex);
+}
+
+static void unlock_problem_dirs(GList *problem_dirs, enum problem_dirs_access access)
+{
+    g_mutex_lock(&g_busy_dirs_mutex);
+    if (access == PROBLEM_DIRS_SCAN)
+        --g_problem_scans;
+    else if (access != PROBLEM_DIRS_READ)
+        --g_problem_writers;
+
+    for (GList *l = problem_dirs; l; l = l->next)
+    {
+        const int readers = GPOINTER_TO_INT(g_hash_table_lookup(g_busy_dirs, l->data));
+        if (readers > 1)
+            g_hash_table_insert(g_busy_dirs, xstrdup(l->data), GINT_TO_POINTER(readers - 1));
+        else
+            g_hash_table_remove(g_busy_dirs, l->data);
+    }
+    g_cond_broadcast(&g_busy_dirs_cond);
+    g_mutex_unlock(&g_busy_dirs_mutex);
+}
+
+/* The same directory can be passed under many names */
+static char *problem_dir_key(const char *problem_dir)
+{
+    char *real_path = realpath(problem_dir, NULL);
+    return real_path ? real_path : xstrdup(problem_dir);
+}
+
+/* Returns the keys of the problem directories passed in the first argument
+ * (s or as) */
+static GList *get_problem_dirs_argument(GVariant *parameters)
+{
+    GVariant *first = g_variant_get_child_value(parameters, 0);
+    if (g_variant_is_of_type(first, G_VARIANT_TYPE_STRING))
+    {
+        GList *problem_dirs = g_list_prepend(NULL, problem_dir_key(g_variant_get_string(first, NULL)));
+        g_variant_unref(first);
+        return problem_dirs;
+    }
+
+    /* consumes the reference */
+    GList *problem_dirs = string_list_from_variant(first);
+    for (GList *l = problem_dirs; l; l = l->next)
+    {
+        char *key = problem_dir_key(l->data);
+        free(l->data);
+        l->data = key;
+    }
+    return problem_dirs;
+}
+
+/*
+ * Methods are processed in worker threads, so a scan of all problems, a polkit
+ * authorization prompt or loading of a large problem does not block the other
+ * callers. Every method has its own pool limiting the number of its concurrent
+ * calls. Reading methods run in parallel, calls of modifying methods are
+ * serialized per problem directory.
+ */
+struct method_pool
+{
+    const char *name;
+    gint max_threads;
+    enum problem_dirs_access access;
+    GThreadPool *pool;
+};
+
+static struct method_pool g_method_pools[] = {
+    /* problem_data_save() names the new directory after the time and PID */
+    { "NewProblem",                      1, PROBLEM_DIRS_CREATE },
+    { "GetProblems",                     4, PROBLEM_DIRS_SCAN   },
+    { "GetAllProblems",                  2, PROBLEM_DIRS_SCAN   },
+    { "GetForeignProblems",              2, PROBLEM_DIRS_SCAN   },
+    { "GetInfo",                         8, PROBLEM_DIRS_READ   },
+    { "GetInfoForProblems",              4, PROBLEM_DIRS_READ   },
+    { "SetElement",                      4, PROBLEM_DIRS_MODIFY },
+    { "DeleteElement",                   4, PROBLEM_DIRS_MODIFY },
+    { "TestElementExists",               8, PROBLEM_DIRS_READ   },
+    { "GetProblemData",                  4, PROBLEM_DIRS_READ   },
+    { "ChownProblemDir",                 2, PROBLEM_DIRS_MODIFY },
+    { "DeleteProblem",                   2, PROBLEM_DIRS_MODIFY },
+    { "FindProblemByElementInTimeRange", 2, PROBLEM_DIRS_SCAN   },
+    { NULL },
+};
+
+static void method_call_worker(gpointer data, gpointer user_data)
+{
+    GDBusMethodInvocation *invocation = (GDBusMethodInvocation *)data;
+    const struct method_pool *method = (const struct method_pool *)user_data;
+    GVariant *parameters = g_dbus_method_invocation_get_parameters(invocation);
+
+    GList *problem_dirs = NULL;
+    if (method->access == PROBLEM_DIRS_READ || method->access == PROBLEM_DIRS_MODIFY)
+        problem_dirs = get_problem_dirs_argument(parameters);
+    lock_problem_dirs(problem_dirs, method->access);
+
+    process_method_call(g_dbus_method_invocation_get_connection(invocation),
+                        g_dbus_method_invocation_get_sender(invocation),
+                        method->name,
+                        parameters,
+                        invocation);
+
+    unlock_problem_dirs(problem_dirs, method->access);
+    list_free_with_free(problem_dirs);
+
+    /* g_dbus_method_invocation_return_*() took the reference passed to
+     * handle_method_call(), this is the one taken there */
+    g_object_unref(invocation);
+    g_atomic_int_dec_and_test(&g_calls_in_progress);
+}
+
+static void init_method_pools(void)
+{
+    g_busy_dirs = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+
+    for (struct method_pool *method = g_method_pools; method->name; ++method)
+    {
+        GError *error = NULL;
+        method->pool = g_thread_pool_new(method_call_worker, method,
+                                         method->max_threads, /*exclusive*/FALSE, &error);
+        if (error)
+            error_msg_and_die("Can't create thread pool for '%s': %s", method->name, error->message);
+    }
+}
+
+/* Waits for the calls already accepted */
+static void free_method_pools(void)
+{
+    for (struct method_pool *method = g_method_pools; method->name; ++method)
+    {
+        g_thread_pool_free(method->pool, /*immediate*/FALSE, /*wait*/TRUE);
+        method->pool = NULL;
+    }
+
+    g_hash_table_destroy(g_busy_dirs);
+    g_busy_dirs = NULL;
+}
+
+static void handle_method_call(GDBusConnection *connection,
+                        const gchar *caller,
+                        const gchar *object_path,
+                        const gchar *interface_name,
+                        const gchar *method_name,
+                        GVariant    *parameters,
+                        GDBusMethodInvocation *invocation,
+                        gpointer    user_data)
+{
+    reset_timeout();
 
     if (g_strcmp0(method_name, "Quit") == 0)
     {
@@ -828,10 +1439,33 @@ static void handle_method_call(GDBusConnection *connection,
         g_main_loop_quit(loop);
         return;
     }
+
+    for (struct method_pool *method = g_method_pools; method->name; ++method)
+    {
+        if (strcmp(method->name, method_name) != 0)
+            continue;
+
+        g_atomic_int_inc(&g_calls_in_progress);
+        g_thread_pool_push(method->pool, g_object_ref(invocation), NULL);
+        return;
+    }
+
+    /* GDBus rejects methods missing in the introspection data */
+    error_msg("Unknown method '%s'", method_name);
+    g_dbus_method_invocation_return_dbus_error(invocation,
+                                      "org.freedesktop.problems.Failure",
+                                      _("Unknown method"));
 }
 
 static gboolean on_timeout_cb(gpointer user_data)
 {
+    /* Don't quit while a slow call is being processed */
+    if (g_atomic_int_get(&g_calls_in_progress) > 0)
+    {
+        log_info("Postponing the exit, method calls are being processed");
+        return TRUE;
+    }
+
     g_main_loop_quit(loop);
     return TRUE;
 }
@@ -849,6 +1483,8 @@ static void on_bus_acquired(GDBusConnection *connection,
 {
     guint registration_id;
 
+    init_callers_cache(connection);
+
     registration_id = g_dbus_connection_register_object(connection,
                                                        ABRT_DBUS_OBJECT,
                                                        introspection_data->interfaces[0],
@@ -943,11 +1579,18 @@ int main(int argc, char *argv[])
     /* initialize the g_settings_dump_location */
     load_abrt_conf();
 
+    init_method_pools();
+
     loop = g_main_loop_new(NULL, FALSE);
     g_main_loop_run(loop);
 
     log_notice("Cleaning up");
 
+    free_method_pools();
+
+    if (g_callers)
+        g_hash_table_destroy(g_callers);
+
     g_bus_unown_name(owner_id);
 
     g_dbus_node_info_unref(introspection_data);
@@ -27,6 +27,55 @@
 /*number of seconds: timeout for the authorization*/
 #define POLKIT_TIMEOUT 20
 
+/* polkitd keeps temporary authorizations (auth_admin_keep) for 5 minutes
+ * after their creation and doesn't tell their expiration time to anybody
+ * else than the owner of the session. This is only an upper bound, an
+ * authorization revoked earlier is announced by the Changed signal of the
+ * authority and the users of valid_until must drop their verdicts on it. */
+#define POLKIT_TEMPORARY_AUTHORIZATION_LIFETIME (5 * 60)
+
+/* Expiration times of the temporary authorizations created by our checks
+ * (key: temporary authorization id, value: time_t *) */
+static GMutex s_temporary_authorizations_mutex;
+static GHashTable *s_temporary_authorizations;
+
+/* Returns the time until which the temporary authorization of an authorized
+ * result is valid or 0 if it isn't known. */
+static time_t temporary_authorization_valid_until(PolkitAuthorizationResult *auth_result)
+{
+    const gchar *id = polkit_authorization_result_get_temporary_authorization_id(auth_result);
+    if (id == NULL)
+        return 0;
+
+    time_t valid_until = 0;
+
+    g_mutex_lock(&s_temporary_authorizations_mutex);
+    if (s_temporary_authorizations == NULL)
+        s_temporary_authorizations = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+
+    const time_t now = time(NULL);
+
+    /* The authorization has just been obtained by a challenge */
+    if (polkit_authorization_result_get_retains_authorization(auth_result))
+    {
+        time_t *expires = xmalloc(sizeof(*expires));
+        *expires = now + POLKIT_TEMPORARY_AUTHORIZATION_LIFETIME;
+        g_hash_table_replace(s_temporary_authorizations, xstrdup(id), expires);
+    }
+
+    time_t *expires = g_hash_table_lookup(s_temporary_authorizations, id);
+    if (expires != NULL)
+    {
+        if (*expires > now)
+            valid_until = *expires;
+        else
+            g_hash_table_remove(s_temporary_authorizations, id);
+    }
+    g_mutex_unlock(&s_temporary_authorizations_mutex);
+
+    return valid_until;
+}
+
 static gboolean do_cancel(GCancellable* cancellable)
 {
     log("Timer has expired; cancelling authorization check\n");
@@ -35,7 +84,7 @@ static gboolean do_cancel(GCancellable* cancellable)
 }
 
 
-static PolkitResult do_check(PolkitSubject *subject, const char *action_id)
+static PolkitResult do_check(PolkitSubject *subject, const char *action_id, time_t *valid_until)
 {
     PolkitAuthority *authority;
     PolkitAuthorizationResult *auth_result;
@@ -81,6 +130,8 @@ static PolkitResult do_check(PolkitSubject *subject, const char *action_id)
     if (polkit_authorization_result_get_is_authorized(auth_result))
     {
         result = PolkitYes;
+        if (valid_until)
+            *valid_until = temporary_authorization_valid_until(auth_result);
         goto out;
     }
 
@@ -90,11 +141,20 @@ out:
 }
 
 PolkitResult polkit_check_authorization_dname(const char *dbus_name, const char *action_id)
+{
+    return polkit_check_authorization_dname_ext(dbus_name, action_id, NULL);
+}
+
+PolkitResult polkit_check_authorization_dname_ext(const char *dbus_name, const char *action_id,
+        time_t *valid_until)
 {
     glib_init();
 
+    if (valid_until)
+        *valid_until = 0;
+
     PolkitSubject *subject = polkit_system_bus_name_new(dbus_name);
-    return do_check(subject, action_id);
+    return do_check(subject, action_id, valid_until);
 }
 
 PolkitResult polkit_check_authorization_pid(pid_t pid, const char *action_id)
@@ -105,5 +165,5 @@ PolkitResult polkit_check_authorization_pid(pid_t pid, const char *action_id)
             /*use start_time from /proc*/0,
             /*use uid from /proc*/ -1);
 
-    return do_check(subject, action_id);
+    return do_check(subject, action_id, NULL);
 }
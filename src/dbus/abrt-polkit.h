@@ -20,6 +20,7 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <time.h>
 
 typedef enum {
 /* Authorization status is unknown */
@@ -34,6 +35,11 @@ typedef enum {
 } PolkitResult;
 
 PolkitResult polkit_check_authorization_dname(const char *dbus_name, const char *action_id);
+/* valid_until is set to the time until which PolkitYes remains valid because
+ * of a temporary authorization unless polkit announces a change
+ * (org.freedesktop.PolicyKit1.Authority.Changed), otherwise to 0 */
+PolkitResult polkit_check_authorization_dname_ext(const char *dbus_name, const char *action_id,
+                                                  time_t *valid_until);
 PolkitResult polkit_check_authorization_pid(pid_t pid, const char *action_id);
 
 #endif
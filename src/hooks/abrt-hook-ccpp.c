@@ -435,6 +435,72 @@ static void create_core_backtrace(pid_t tid, const char *executable, int signal_
 #endif /* ENABLE_DUMP_TIME_UNWIND */
 }
 
+struct core_copy
+{
+    int abrt_core_fd;
+    int user_core_fd;
+    off_t ulimit_c;
+    bool minicore;
+
+    off_t core_size;
+    gint64 duration_us;
+};
+
+/* Copies the core from stdin to the dump dir (and to the user core) */
+static gpointer copy_core(gpointer data)
+{
+    struct core_copy *copy = data;
+    const gint64 start_us = g_get_monotonic_time();
+
+    if (copy->minicore)
+        /* Stops reading once it has everything it needs, see
+         * release_core_pipe() */
+        copy->core_size = copyfd_minicore(STDIN_FILENO, copy->abrt_core_fd,
+                                          copy->user_core_fd, copy->ulimit_c);
+    else
+        copy->core_size = copyfd_sparse(STDIN_FILENO, copy->abrt_core_fd,
+                                        copy->user_core_fd, copy->ulimit_c);
+
+    copy->duration_us = g_get_monotonic_time() - start_us;
+    return NULL;
+}
+
+/* Closes the core pipe so that the kernel does not have to write the rest
+ * of the core which copyfd_minicore() did not read. The kernel may reap the
+ * crashed process right after, nothing may read /proc/PID afterwards.
+ */
+static void release_core_pipe(void)
+{
+    xmove_fd(xopen("/dev/null", O_RDONLY), STDIN_FILENO);
+}
+
+/* Durations of the phases of the hook. The crashed process cannot exit
+ * until the hook finishes, hence the sum is the time we hold the process.
+ */
+struct hook_timing
+{
+    gint64 start_us;
+    gint64 setup_us;
+    gint64 unwind_us;
+    gint64 core_us;
+};
+
+static void save_hook_timing(struct dump_dir *dd, const struct hook_timing *timing)
+{
+    /* The core is copied while unwinding, the phases may overlap */
+    char *text = xasprintf(
+            "setup %lld\n"
+            "unwind %lld\n"
+            "core %lld\n"
+            "total %lld\n",
+            (long long)timing->setup_us / 1000,
+            (long long)timing->unwind_us / 1000,
+            (long long)timing->core_us / 1000,
+            (long long)(g_get_monotonic_time() - timing->start_us) / 1000);
+    dd_save_text(dd, "hook_timing", text);
+    free(text);
+}
+
 static int create_user_core(int user_core_fd, pid_t pid, off_t ulimit_c)
 {
     int err = 1;
@@ -558,6 +624,8 @@ int main(int argc, char** argv)
     if (fd > 2)
         close(fd);
 
+    struct hook_timing timing = { .start_us = g_get_monotonic_time() };
+
     int err = 1;
     logmode = LOGMODE_JOURNAL;
 
@@ -567,6 +635,7 @@ int main(int argc, char** argv)
     bool setting_MakeCompatCore;
     bool setting_SaveBinaryImage;
     bool setting_SaveFullCore;
+    bool setting_SaveMiniCore;
     bool setting_CreateCoreBacktrace;
     bool setting_SaveContainerizedPackageData;
     bool setting_StandaloneHook;
@@ -581,6 +650,8 @@ int main(int argc, char** argv)
         setting_SaveBinaryImage = value && string_to_bool(value);
         value = get_map_string_item_or_NULL(settings, "SaveFullCore");
         setting_SaveFullCore = value ? string_to_bool(value) : true;
+        value = get_map_string_item_or_NULL(settings, "SaveMiniCore");
+        setting_SaveMiniCore = value && string_to_bool(value);
         value = get_map_string_item_or_NULL(settings, "CreateCoreBacktrace");
         setting_CreateCoreBacktrace = value ? string_to_bool(value) : true;
         value = get_map_string_item_or_NULL(settings, "IgnoredPaths");
@@ -607,7 +678,7 @@ int main(int argc, char** argv)
     }
 
     if (argc == 2 && strcmp(argv[1], "--config-test"))
-        return test_configuration(setting_SaveFullCore, setting_CreateCoreBacktrace);
+        return test_configuration(setting_SaveFullCore || setting_SaveMiniCore, setting_CreateCoreBacktrace);
 
     if (argc < 8)
     {
@@ -996,10 +1067,28 @@ int main(int argc, char** argv)
         }
 
         off_t core_size = 0;
-        if (setting_SaveFullCore)
+        struct core_copy copy = {
+            .abrt_core_fd = -1,
+            .user_core_fd = user_core_fd,
+            .ulimit_c = ulimit_c,
+            .minicore = setting_SaveMiniCore,
+        };
+        GThread *copy_thread = NULL;
+        /* abrt-action-save-package-data reads the root of the container
+         * through /proc/PID/root, the process must not be reaped before */
+        const bool read_container_root = abrtd_running && setting_SaveContainerizedPackageData
+                                         && containerized;
+#ifdef ENABLE_DUMP_TIME_UNWIND
+        const bool unwind = tid > 0 && setting_CreateCoreBacktrace;
+#else
+        const bool unwind = false;
+#endif
+        timing.setup_us = g_get_monotonic_time() - timing.start_us;
+
+        if (setting_SaveFullCore || setting_SaveMiniCore)
         {
             strcpy(path + path_len, "/"FILENAME_COREDUMP);
-            int abrt_core_fd = create_or_die(path, user_core_fd);
+            copy.abrt_core_fd = create_or_die(path, user_core_fd);
 
             /* We write both coredumps at once.
              * We can't write user coredump first, since it might be truncated
@@ -1010,10 +1099,40 @@ int main(int argc, char** argv)
              * $ rm -f core*; ulimit -c unlimited; ./test; ls -l core*
              * 21631 Segmentation fault (core dumped) ./test
              * ls: cannot access core*: No such file or directory <=== BAD
+             *
+             * The unwinding reads the memory of the process, not the core
+             * stream, hence the core is copied in a separate thread
+             * and the core_backtrace is not delayed by the copying.
              */
-            core_size = copyfd_sparse(STDIN_FILENO, abrt_core_fd, user_core_fd, ulimit_c);
+            if (unwind)
+                copy_thread = g_thread_try_new("copy-core", copy_core, &copy, NULL);
+            if (copy_thread == NULL)
+                copy_core(&copy);
+        }
+
+        /* Perform crash-time unwind of the guilty thread. */
+        if (unwind)
+        {
+            const gint64 unwind_start_us = g_get_monotonic_time();
+            create_core_backtrace(tid, executable, signal_no, dd);
+            timing.unwind_us = g_get_monotonic_time() - unwind_start_us;
+        }
+
+        if (copy.abrt_core_fd >= 0)
+        {
+            if (copy_thread != NULL)
+                g_thread_join(copy_thread);
+
+            core_size = copy.core_size;
+            timing.core_us = copy.duration_us;
             close_user_core(user_core_fd, core_size);
-            if (fsync(abrt_core_fd) != 0 || close(abrt_core_fd) != 0 || core_size < 0)
+
+            /* The unwind and the copy have finished, only the package data
+             * of a container below need /proc/PID */
+            if (copy.minicore && !read_container_root)
+                release_core_pipe();
+
+            if (fsync(copy.abrt_core_fd) != 0 || close(copy.abrt_core_fd) != 0 || core_size < 0)
             {
                 unlink(path);
 
@@ -1027,7 +1146,9 @@ int main(int argc, char** argv)
         else
         {
             /* User core is created even if WriteFullCore is off. */
+            const gint64 copy_start_us = g_get_monotonic_time();
             create_user_core(user_core_fd, pid, ulimit_c);
+            timing.core_us = g_get_monotonic_time() - copy_start_us;
         }
 
         /* User core is either written or closed */
@@ -1074,9 +1195,7 @@ int main(int argc, char** argv)
         }
 #endif
 
-        /* Perform crash-time unwind of the guilty thread. */
-        if (tid > 0 && setting_CreateCoreBacktrace)
-            create_core_backtrace(tid, executable, signal_no, dd);
+        save_hook_timing(dd, &timing);
 
         /* We close dumpdir before we start catering for crash storm case.
          * Otherwise, delete_dump_dir's from other concurrent
@@ -1089,7 +1208,7 @@ int main(int argc, char** argv)
 
         path[path_len] = '\0'; /* path now contains only directory name */
 
-        if (abrtd_running && setting_SaveContainerizedPackageData && containerized)
+        if (read_container_root)
         {   /* Do we really need to run rpm from core_pattern hook? */
             sprintf(source_filename, "/proc/%lu/root", (long)pid);
 
@@ -1106,6 +1225,10 @@ int main(int argc, char** argv)
             safe_waitpid(pid, &stat, 0);
         }
 
+        /* The package data of the container have been read */
+        if (copy.minicore && read_container_root)
+            release_core_pipe();
+
         char *newpath = xstrndup(path, path_len - (sizeof(".new")-1));
         if (rename(path, newpath) == 0)
             strcpy(path, newpath);
@@ -42,12 +42,79 @@ int low_free_space(unsigned setting_MaxCrashReportsSize, const char *dump_locati
 
 #define trim_problem_dirs abrt_trim_problem_dirs
 void trim_problem_dirs(const char *dirname, double cap_size, const char *exclude_path);
+
+#define dump_location_usage abrt_dump_location_usage
+/**
+  @brief Returns the total size of the dump location
+
+  The size is kept in a counter file in the dump location, hence the call
+  costs constant time. The whole dump location is walked only if the counter
+  doesn't exist or hasn't been synchronized for the last few minutes.
+*/
+double dump_location_usage(const char *dump_location);
+#define dump_location_usage_add abrt_dump_location_usage_add
+/**
+  @brief Adjusts the usage counter of the dump location by delta bytes
+
+  Call it after adding (positive delta) or removing (negative delta) data.
+*/
+void dump_location_usage_add(const char *dump_location, double delta);
+#define dump_location_usage_reserve abrt_dump_location_usage_reserve
+/**
+  @brief Stores data of delta bytes only if they fit into max_size
+
+  The usage check, the call of store and the counter update are done as a
+  single step under the lock of the counter, hence concurrent callers can't
+  exceed the limit together.
+
+  @param store Writes the data, returns 0 on success
+  @returns -1 if there is not enough space, otherwise the result of store;
+  the counter is adjusted only if store returned 0
+*/
+int dump_location_usage_reserve(const char *dump_location, double max_size,
+        double delta, int (*store)(void *), void *arg);
+#define dump_location_usage_set abrt_dump_location_usage_set
+/**
+  @brief Stores the size of the dump location computed by a full walk
+*/
+void dump_location_usage_set(const char *dump_location, double size);
 #define ensure_writable_dir_id abrt_ensure_writable_dir_uid_git
 void ensure_writable_dir_uid_gid(const char *dir, mode_t mode, uid_t uid, gid_t gid);
 #define ensure_writable_dir abrt_ensure_writable_dir
 void ensure_writable_dir(const char *dir, mode_t mode, const char *user);
 #define ensure_writable_dir_group abrt_ensure_writable_dir_group
 void ensure_writable_dir_group(const char *dir, mode_t mode, const char *user, const char *group);
+/* Parts of memory stored in a mini core */
+#define MINICORE_STACK_SIZE (512 * 1024)
+#define MINICORE_STACK_RED_ZONE 4096
+#define MINICORE_POINTER_WINDOW 4096
+
+#define copyfd_minicore abrt_copyfd_minicore
+/**
+  @brief Copies an ELF core dump and stores only memory needed for unwinding
+
+  The core is parsed as it is being read from src_fd. Headers and notes are
+  stored as they are. From memory segments we store only the stack of every
+  thread (MINICORE_STACK_SIZE bytes above its stack pointer), a window of
+  MINICORE_POINTER_WINDOW bytes around every address found in thread's
+  registers and the first page of every mapped ELF file. The rest is left
+  out as holes, hence dst_fd gets a valid sparse ELF core with the same
+  layout as the original core. A core which cannot be parsed is stored
+  completely.
+
+  If user_fd is not negative, the complete core (up to user_limit bytes) is
+  written to it as well. Otherwise, reading from src_fd is stopped as soon
+  as the last needed byte is read. The mapped files are known from the NT_FILE
+  note, without it the first page of every segment has to be read.
+
+  @param src_fd The core dump stream
+  @param dst_fd Destination of the mini core; must be seekable
+  @param user_fd Destination of the full core or -1
+  @param user_limit Maximum size of the full core
+  @return Size of the core or -1 on errors
+*/
+off_t copyfd_minicore(int src_fd, int dst_fd, int user_fd, off_t user_limit);
+
 #define run_unstrip_n abrt_run_unstrip_n
 char *run_unstrip_n(const char *dump_dir_name, unsigned timeout_sec);
 #define get_backtrace abrt_get_backtrace
@@ -102,6 +169,19 @@ int save_abrt_conf_file(const char *file, map_string_t *settings);
 #define save_abrt_plugin_conf_file abrt_save_abrt_plugin_conf_file
 int save_abrt_plugin_conf_file(const char *file, map_string_t *settings);
 
+/**
+  @brief Stores all configuration files of abrt and its plugins in a snapshot
+
+  load_abrt_conf_file() and load_abrt_plugin_conf_file() read the files from
+  the snapshot instead of parsing them as long as the calling process is
+  alive. Meant to be called by abrtd whenever the files change.
+*/
+#define save_abrt_conf_snapshot abrt_save_abrt_conf_snapshot
+int save_abrt_conf_snapshot(void);
+
+#define remove_abrt_conf_snapshot abrt_remove_abrt_conf_snapshot
+void remove_abrt_conf_snapshot(void);
+
 
 void migrate_to_xdg_dirs(void);
 
@@ -119,6 +199,51 @@ int daemon_is_ok(void);
 #define notify_new_path abrt_notify_new_path
 void notify_new_path(const char *path);
 
+/**
+  @brief Finds the problems which may be duplicates of the given problem
+
+  Looks up the problems whose core backtraces are similar to the core
+  backtrace of dump_dir_name (or whose UUID is the same if there is no
+  backtrace) in the index kept in the dump location. The index is read
+  sequentially, a few hundred bytes per stored problem, but only the
+  candidates have to be loaded, parsed and compared with the problem.
+
+  @param[in] dump_location The dump location
+  @param[in] dump_dir_name Path to the problem directory
+  @param[out] candidates Malloced paths of the candidate problem directories
+  @return 0 on success, -1 if the index cannot be used and all problems
+  must be compared
+*/
+#define dup_index_find_candidates abrt_dup_index_find_candidates
+int dup_index_find_candidates(const char *dump_location, const char *dump_dir_name, GList **candidates);
+
+/**
+  @brief Finds the problems with the given UUID in the duplicate index
+
+  Allows to look for a problem before its directory is created. The
+  candidates may have a different UUID, it must be compared.
+
+  @param[in] dump_location The dump location
+  @param[in] uid Contents of the uid element, NULL if there is none
+  @param[in] type Contents of the type element
+  @param[in] executable Contents of the executable element, NULL if there is none
+  @param[in] uuid Contents of the uuid element
+  @param[out] candidates Malloced paths of the candidate problem directories
+  @return 0 on success, -1 if the index cannot be used
+*/
+#define dup_index_find_uuid abrt_dup_index_find_uuid
+int dup_index_find_uuid(const char *dump_location, const char *uid, const char *type,
+        const char *executable, const char *uuid, GList **candidates);
+
+/**
+  @brief Adds the processed problem to the duplicate index
+
+  @param[in] dump_location The dump location
+  @param[in] dump_dir_name Path to the problem directory in the dump location
+*/
+#define dup_index_add abrt_dup_index_add
+void dup_index_add(const char *dump_location, const char *dump_dir_name);
+
 /* Note: should be public since unit tests need to call it */
 #define koops_extract_version abrt_koops_extract_version
 char *koops_extract_version(const char *line);
@@ -130,6 +255,14 @@ char *kernel_tainted_long(const char *tainted_short);
 int koops_hash_str_ext(char hash_str[SHA1_RESULT_LEN*2 + 1], const char *oops_buf, int frame_count, int duphas_flags);
 #define koops_hash_str abrt_koops_hash_str
 int koops_hash_str(char hash_str[SHA1_RESULT_LEN*2 + 1], const char *oops_buf);
+/* Directory where koops_hash_str_ext() caches duphashes until reboot,
+ * NULL keeps the cache only in memory of the current process */
+#define koops_duphash_cache_dir abrt_koops_duphash_cache_dir
+extern const char *koops_duphash_cache_dir;
+/* The maximum number of duphashes cached in memory and in
+ * koops_duphash_cache_dir, the oldest ones are evicted */
+#define koops_duphash_cache_max_entries abrt_koops_duphash_cache_max_entries
+extern unsigned koops_duphash_cache_max_entries;
 
 
 #define koops_line_skip_level abrt_koops_line_skip_level
@@ -217,6 +350,16 @@ int delete_problem_dirs_over_dbus(const GList *problem_dir_paths);
 */
 int fill_problem_data_over_dbus(const char *problem_dir_path, const char **elements, problem_data_t *problem_data);
 
+/**
+  @brief Fetches given problem elements for many problems in a single D-Bus call
+
+  Problems which are not accessible are not present in the result.
+
+  @return a hash table mapping problem ids to problem_data_t (destroy it by
+  g_hash_table_destroy()) or ERR_PTR on failure
+*/
+GHashTable *get_problems_data_over_dbus(GList *problem_ids, const char **elements);
+
 /**
   @brief Fetches problem information for specified problem id
 
@@ -249,6 +392,9 @@ typedef struct ignored_problems ignored_problems_t;
 /**
   @brief Initializes a new instance of ignored problems
 
+  The contents of the file are cached in memory and reloaded only when
+  the file changes, hence the queries are cheap.
+
   @param file_path A malloced string holding a path to a file containing the list of ignored problems. Function takes ownership of the malloced memory, which will be freed in ignored_problems_free()
   @see ignored_problems_free()
   @return Fully initialized instance of ignored problems struct which must be destroyed by ignored_problems_free()
@@ -285,6 +431,28 @@ void ignored_problems_add(ignored_problems_t *set, const char *problem_id);
 */
 void ignored_problems_remove(ignored_problems_t *set, const char *problem_id);
 
+/**
+  @brief Adds many problems to the ignored problems at once
+
+  All the new rows are appended to the file by a single write. This function
+  never fails. All errors will be logged.
+
+  @param set An instance of ignored problems to which the problems will be added
+  @param problem_ids A list of identifiers of problems which will be added to an ignored set
+*/
+void ignored_problems_add_list(ignored_problems_t *set, GList *problem_ids);
+
+/**
+  @brief Removes many problems from the ignored problems at once
+
+  The file is rewritten only once. This function never fails. All errors
+  will be logged.
+
+  @param set An instance of ignored problems from which the problems will be deleted
+  @param problem_ids A list of identifiers of problems which will be removed from an ignored problems struct
+*/
+void ignored_problems_remove_list(ignored_problems_t *set, GList *problem_ids);
+
 /**
   @brief Checks if a problem is in the ignored problems
 
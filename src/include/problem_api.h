@@ -21,6 +21,16 @@
 #include "libabrt.h"
 
 
+/*
+ * Serializes the calls of the user and group database functions
+ * (getpwuid(), getgrnam(), ...) which return static buffers. Every call of
+ * an access check (dump_dir_accessible_by_uid(), dd_accessible_by_uid(),
+ * dir_has_correct_permissions(), ...) made out of the main thread must be
+ * enclosed in these functions. The unlock preserves errno.
+ */
+void problem_api_lock_nss(void);
+void problem_api_unlock_nss(void);
+
 /*
  * Function called for each problem directory in @for_each_problem_in_dir
  *
@@ -45,6 +55,38 @@ int for_each_problem_in_dir(const char *path,
                         for_each_problem_in_dir_callback callback,
                         void *arg);
 
+/* Upper bound of the default number of threads used by
+ * @for_each_problem_in_dir_parallel
+ */
+#define PROBLEM_DIR_SCAN_MAX_THREADS 16
+
+/*
+ * Same as @for_each_problem_in_dir but opens the dump directories and calls
+ * @callback from a bounded pool of worker threads, so the latency of
+ * opening and locking many directories on a cold cache overlaps.
+ *
+ * @callback is called concurrently from several threads and must be
+ * thread-safe: all data shared through @arg must be protected by the caller.
+ * The order in which the directories are passed to @callback is undefined.
+ * A non zero value returned from @callback stops opening of the not yet
+ * processed directories, but the callbacks already running in other threads
+ * are finished.
+ *
+ * @param path Dump directories location
+ * @param caller_uid UID for access check. -1 for disabling this check
+ * @param callback Thread-safe function called for each applicable dump
+ * directory
+ * @param arg User's arguments passed to @callback
+ * @param max_threads Maximum number of worker threads. 0 for a default value
+ * derived from the number of processors. 1 for serial iteration.
+ * @returns 0 or the first non zero value returned from @callback
+ */
+int for_each_problem_in_dir_parallel(const char *path,
+                        uid_t caller_uid,
+                        for_each_problem_in_dir_callback callback,
+                        void *arg,
+                        unsigned max_threads);
+
 /* Retrieves the list of directories currently used as a problem storage
  * The result must be freed by caller
  * @returns List of strings representing the full path to dirs
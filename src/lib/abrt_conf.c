@@ -16,10 +16,42 @@
     with this program; if not, write to the Free Software Foundation, Inc.,
     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
+#include <sys/mman.h>
 #include "libabrt.h"
 
 #define ABRT_CONF "abrt.conf"
 
+/* Binary snapshot of all configuration files of abrt and its plugins,
+ * generated by abrtd whenever the files change. The header is followed by
+ * sections of NUL terminated strings:
+ *
+ *   KIND FILE \0 ERRNO \0 (KEY \0 VALUE \0)* \0
+ *
+ * where KIND is 'A' for abrt's and 'P' for plugins' configuration and ERRNO
+ * is 0 if load_conf_file_from_dirs() succeeded.
+ */
+#define ABRT_CONF_SNAPSHOT VAR_RUN"/abrt/abrt-conf.snapshot"
+#define ABRT_CONF_SNAPSHOT_MAGIC "ABRTCONF"
+#define ABRT_CONF_SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_KIND_ABRT   'A'
+#define SNAPSHOT_KIND_PLUGIN 'P'
+
+struct conf_snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    /* abrtd which keeps the snapshot up to date */
+    uint32_t writer_pid;
+    /* incremented by every write */
+    uint64_t generation;
+    /* of the whole file */
+    uint64_t size;
+};
+
+static const char *const abrt_conf_dirs[] = { DEFAULT_CONF_DIR, CONF_DIR, NULL };
+static const char *const plugin_conf_dirs[] = { DEFAULT_PLUGINS_CONF_DIR, PLUGINS_CONF_DIR, NULL };
+
 char *        g_settings_sWatchCrashdumpArchiveDir = NULL;
 unsigned int  g_settings_nMaxCrashReportsSize = 1000;
 char *        g_settings_dump_location = NULL;
@@ -154,18 +186,298 @@ int load_abrt_conf()
     return 0;
 }
 
+/*
+ * Reading of the snapshot
+ */
+
+static GMutex s_snapshot_mutex;
+static const char *s_snapshot_data;
+static size_t s_snapshot_size;
+static dev_t s_snapshot_dev;
+static ino_t s_snapshot_ino;
+
+static void unmap_snapshot(void)
+{
+    if (s_snapshot_data != NULL)
+        munmap((void *)s_snapshot_data, s_snapshot_size);
+    s_snapshot_data = NULL;
+    s_snapshot_size = 0;
+}
+
+static bool snapshot_is_valid(const char *data, size_t size)
+{
+    const struct conf_snapshot_header *header = (const void *)data;
+
+    return size > sizeof(*header)
+        && memcmp(header->magic, ABRT_CONF_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+        && header->version == ABRT_CONF_SNAPSHOT_VERSION
+        && header->size == size
+        /* The sections are walked by strlen() */
+        && data[size - 1] == '\0';
+}
+
+/* Returns the header of the current snapshot or NULL if there is no usable
+ * one. Must be called with s_snapshot_mutex held.
+ */
+static const struct conf_snapshot_header *get_snapshot(void)
+{
+    struct stat st;
+    if (stat(ABRT_CONF_SNAPSHOT, &st) != 0)
+    {
+        unmap_snapshot();
+        return NULL;
+    }
+
+    /* abrtd replaces the file by rename(), hence a new snapshot has a new inode */
+    if (s_snapshot_data == NULL || st.st_dev != s_snapshot_dev || st.st_ino != s_snapshot_ino)
+    {
+        unmap_snapshot();
+
+        int fd = open(ABRT_CONF_SNAPSHOT, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return NULL;
+
+        void *data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > (off_t)sizeof(struct conf_snapshot_header))
+            data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED)
+            return NULL;
+
+        if (!snapshot_is_valid(data, st.st_size))
+        {
+            log_notice("Ignoring invalid configuration snapshot '%s'", ABRT_CONF_SNAPSHOT);
+            munmap(data, st.st_size);
+            return NULL;
+        }
+
+        s_snapshot_data = data;
+        s_snapshot_size = st.st_size;
+        s_snapshot_dev = st.st_dev;
+        s_snapshot_ino = st.st_ino;
+
+        log_debug("Mapped configuration snapshot generation %llu",
+                (unsigned long long)((const struct conf_snapshot_header *)data)->generation);
+    }
+
+    const struct conf_snapshot_header *header = (const void *)s_snapshot_data;
+
+    /* Nobody watches the configuration files if abrtd is gone */
+    if (kill(header->writer_pid, 0) != 0 && errno != EPERM)
+    {
+        log_debug("The configuration snapshot is stale, its writer %u is gone", header->writer_pid);
+        return NULL;
+    }
+
+    return header;
+}
+
+/* Returns -1 if the file is not in the snapshot, otherwise the value
+ * load_conf_file_from_dirs() returned for the file when the snapshot was
+ * generated.
+ */
+static int load_conf_file_from_snapshot(char kind, const char *file, map_string_t *settings)
+{
+    int retval = -1;
+
+    g_mutex_lock(&s_snapshot_mutex);
+    if (get_snapshot() == NULL)
+        goto ret;
+
+    const char *p = s_snapshot_data + sizeof(struct conf_snapshot_header);
+    const char *const end = s_snapshot_data + s_snapshot_size;
+    while (p < end)
+    {
+        const char *section = p;
+        p += strlen(p) + 1;
+        if (p >= end)
+            break;
+
+        const char *error = p;
+        p += strlen(p) + 1;
+
+        const bool match = section[0] == kind && strcmp(section + 1, file) == 0;
+        while (p < end && *p != '\0')
+        {
+            const char *key = p;
+            p += strlen(p) + 1;
+            if (p >= end)
+                break;
+
+            const char *value = p;
+            p += strlen(p) + 1;
+
+            if (match)
+                replace_map_string_item(settings, xstrdup(key), xstrdup(value));
+        }
+        /* Section terminator */
+        ++p;
+
+        if (match)
+        {
+            errno = atoi(error);
+            retval = errno == 0;
+            break;
+        }
+    }
+
+ ret:
+    g_mutex_unlock(&s_snapshot_mutex);
+    return retval;
+}
+
 int load_abrt_conf_file(const char *file, map_string_t *settings)
 {
-    static const char *const base_directories[] = { DEFAULT_CONF_DIR, CONF_DIR, NULL };
+    const int retval = load_conf_file_from_snapshot(SNAPSHOT_KIND_ABRT, file, settings);
+    if (retval >= 0)
+        return retval;
 
-    return load_conf_file_from_dirs(file, base_directories, settings, /*skip key w/o values:*/ false);
+    return load_conf_file_from_dirs(file, abrt_conf_dirs, settings, /*skip key w/o values:*/ false);
 }
 
 int load_abrt_plugin_conf_file(const char *file, map_string_t *settings)
 {
-    static const char *const base_directories[] = { DEFAULT_PLUGINS_CONF_DIR, PLUGINS_CONF_DIR, NULL };
+    const int retval = load_conf_file_from_snapshot(SNAPSHOT_KIND_PLUGIN, file, settings);
+    if (retval >= 0)
+        return retval;
+
+    return load_conf_file_from_dirs(file, plugin_conf_dirs, settings, /*skip key w/o values:*/ false);
+}
+
+/*
+ * Writing of the snapshot
+ */
+
+static void add_conf_file_names(GHashTable *names, const char *dir_path)
+{
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL)
+        return;
+
+    struct dirent *dent;
+    while ((dent = readdir(dir)) != NULL)
+    {
+        const char *ext = strrchr(dent->d_name, '.');
+        if (ext != NULL && ext != dent->d_name && strcmp(ext, ".conf") == 0)
+            g_hash_table_add(names, xstrdup(dent->d_name));
+    }
+    closedir(dir);
+}
+
+static void append_snapshot_sections(GString *data, char kind, const char *const *dirs)
+{
+    GHashTable *names = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    for (const char *const *dir = dirs; *dir; ++dir)
+        add_conf_file_names(names, *dir);
+
+    GHashTableIter name_iter;
+    const char *file;
+    g_hash_table_iter_init(&name_iter, names);
+    while (g_hash_table_iter_next(&name_iter, (gpointer *)&file, NULL))
+    {
+        map_string_t *settings = new_map_string();
+        errno = 0;
+        const int loaded = load_conf_file_from_dirs(file, dirs, settings, /*skip key w/o values:*/ false);
+
+        g_string_append_c(data, kind);
+        g_string_append(data, file);
+        g_string_append_c(data, '\0');
+        g_string_append_printf(data, "%d", loaded ? 0 : (errno ? errno : EINVAL));
+        g_string_append_c(data, '\0');
+
+        map_string_iter_t iter;
+        const char *key;
+        const char *value;
+        init_map_string_iter(&iter, settings);
+        while (next_map_string_iter(&iter, &key, &value))
+        {
+            g_string_append(data, key);
+            g_string_append_c(data, '\0');
+            g_string_append(data, value);
+            g_string_append_c(data, '\0');
+        }
+        g_string_append_c(data, '\0');
+
+        free_map_string(settings);
+    }
+
+    g_hash_table_destroy(names);
+}
 
-    return load_conf_file_from_dirs(file, base_directories, settings, /*skip key w/o values:*/ false);
+int save_abrt_conf_snapshot(void)
+{
+    static uint64_t generation;
+
+    if (generation == 0)
+    {
+        /* Continue the numbering of the previous abrtd */
+        struct conf_snapshot_header previous;
+        int fd = open(ABRT_CONF_SNAPSHOT, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            if (full_read(fd, &previous, sizeof(previous)) == sizeof(previous)
+                && memcmp(previous.magic, ABRT_CONF_SNAPSHOT_MAGIC, sizeof(previous.magic)) == 0)
+                generation = previous.generation;
+            close(fd);
+        }
+    }
+
+    struct conf_snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ABRT_CONF_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = ABRT_CONF_SNAPSHOT_VERSION;
+    header.writer_pid = getpid();
+    header.generation = generation + 1;
+
+    GString *data = g_string_sized_new(8 * 1024);
+    g_string_append_len(data, (const char *)&header, sizeof(header));
+    append_snapshot_sections(data, SNAPSHOT_KIND_ABRT, abrt_conf_dirs);
+    append_snapshot_sections(data, SNAPSHOT_KIND_PLUGIN, plugin_conf_dirs);
+
+    header.size = data->len;
+    memcpy(data->str, &header, sizeof(header));
+
+    int retval = -1;
+    char *tmp_path = xasprintf("%s.XXXXXX", ABRT_CONF_SNAPSHOT);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        perror_msg("Can't create '%s'", tmp_path);
+        goto ret;
+    }
+
+    if (fchmod(fd, 0644) != 0
+        || full_write(fd, data->str, data->len) != (ssize_t)data->len)
+    {
+        perror_msg("Can't write '%s'", tmp_path);
+        close(fd);
+        unlink(tmp_path);
+        goto ret;
+    }
+    close(fd);
+
+    if (rename(tmp_path, ABRT_CONF_SNAPSHOT) != 0)
+    {
+        perror_msg("Can't rename '%s' to '%s'", tmp_path, ABRT_CONF_SNAPSHOT);
+        unlink(tmp_path);
+        goto ret;
+    }
+
+    generation = header.generation;
+    log_info("Saved configuration snapshot generation %llu", (unsigned long long)generation);
+    retval = 0;
+
+ ret:
+    free(tmp_path);
+    g_string_free(data, TRUE);
+    return retval;
+}
+
+void remove_abrt_conf_snapshot(void)
+{
+    if (unlink(ABRT_CONF_SNAPSHOT) != 0 && errno != ENOENT)
+        perror_msg("Can't remove '%s'", ABRT_CONF_SNAPSHOT);
 }
 
 int save_abrt_conf_file(const char *file, map_string_t *settings)
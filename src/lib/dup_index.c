@@ -0,0 +1,656 @@
+/*
+    Copyright (C) 2017  ABRT Team
+    Copyright (C) 2017  Red Hat, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <satyr/abrt.h>
+#include <satyr/core/frame.h>
+#include <satyr/core/thread.h>
+#include <satyr/frame.h>
+#include <satyr/stacktrace.h>
+#include <satyr/strbuf.h>
+#include <satyr/thread.h>
+#include <inttypes.h>
+#include <sys/file.h>
+#include "internal_libabrt.h"
+
+/* Finding a duplicate by comparing the new backtrace with the backtraces of
+ * all problems means parsing every one of them for every new crash. Instead,
+ * every processed problem has a line in DumpLocation/.dup-index:
+ *
+ *   NAME UUID BAND_1 ... BAND_32
+ *
+ * The bands are a locality sensitive hash of the frames of the crash thread.
+ * A frame is represented by its function name or, for core frames without
+ * one, by its build id and offset. 128 MinHash values of the set of frames
+ * are grouped by four into 32 bands. Two problems whose sets of frames have
+ * Jaccard similarity s share at least one band with probability
+ * 1 - (1 - s^4)^32. Replacing 30 % of the frames, the most a duplicate
+ * differs by (see BACKTRACE_DUP_THRESHOLD), gives s = 0.54 and 94 %; crashes
+ * sharing only main() and a few libc frames (s = 0.2) meet with 5 %. Only
+ * the problems sharing a band (or the UUID if the new problem has no
+ * backtrace) are compared by the exact distance. The index itself is read
+ * line by line, which is cheap compared to parsing backtraces but still
+ * grows with the number of problems.
+ *
+ * All values are salted with the uid, type and executable of the problem
+ * because problems differing in them are never duplicates. Values which
+ * can't be computed are dashes. All values have the same width, hence they
+ * are compared where they are without splitting the lines.
+ *
+ * The first line holds the time of the last full walk of the dump location.
+ * Problems are added when post-create keeps them. The walk adds processed
+ * problems which are missing (created before the index, copied in) and drops
+ * the deleted ones. Walks write a new file and rename it over the index.
+ * A walk runs outside of post-create.lock (abrt-dump-oops), hence appending
+ * and renaming are serialized by flock() of the dump location and the walk
+ * merges the lines appended since it read the index before renaming.
+ */
+#define DUP_INDEX_FILE ".dup-index"
+/* Problems added or deleted behind our back are picked up by a full walk
+ * after this many seconds at the latest */
+#define DUP_INDEX_MAX_AGE (60 * 60)
+
+#define DUP_INDEX_BANDS 32
+#define DUP_INDEX_ROWS 4
+#define DUP_INDEX_HASHES (DUP_INDEX_BANDS * DUP_INDEX_ROWS)
+
+/* UUID + bands */
+#define DUP_INDEX_FIELDS (1 + DUP_INDEX_BANDS)
+/* 32 bits, collisions only add candidates */
+#define DUP_INDEX_FIELD_LEN 8
+#define DUP_INDEX_NO_VALUE "--------"
+
+#define FNV1A_BASIS 0xcbf29ce484222325ULL
+#define FNV1A_PRIME 0x100000001b3ULL
+
+struct dup_signature
+{
+    /* Hexadecimal numbers or DUP_INDEX_NO_VALUE */
+    char fields[DUP_INDEX_FIELDS][DUP_INDEX_FIELD_LEN + 1];
+};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    while (len-- > 0)
+    {
+        hash ^= *p++;
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a_str(uint64_t hash, const char *str)
+{
+    /* The terminating '\0' separates the salted strings */
+    return fnv1a(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+static uint32_t fold(uint64_t hash)
+{
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/* The i-th of the random permutations of MinHash, the splitmix64 finalizer */
+static uint64_t permute(uint64_t x, unsigned i)
+{
+    x += (i + 1) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static void minhash_add(uint64_t *mins, const char *token)
+{
+    const uint64_t hash = fnv1a_str(FNV1A_BASIS, token);
+    for (unsigned i = 0; i < DUP_INDEX_HASHES; ++i)
+    {
+        const uint64_t value = permute(hash, i);
+        if (value < mins[i])
+            mins[i] = value;
+    }
+}
+
+/* Returns the number of frames */
+static unsigned minhash_thread(enum sr_report_type report_type, struct sr_thread *thread,
+        uint64_t *mins)
+{
+    unsigned frames = 0;
+
+    /* sr_distance() compares core frames by these, see sr_core_frame_cmp_distance() */
+    if (report_type == SR_REPORT_CORE)
+    {
+        for (struct sr_core_frame *frame = ((struct sr_core_thread *)thread)->frames;
+             frame;
+             frame = frame->next, ++frames)
+        {
+            if (frame->function_name)
+            {
+                minhash_add(mins, frame->function_name);
+                continue;
+            }
+
+            char *token = xasprintf("%s+0x%"PRIx64,
+                    frame->build_id ? frame->build_id : "", frame->build_id_offset);
+            minhash_add(mins, token);
+            free(token);
+        }
+
+        return frames;
+    }
+
+    for (struct sr_frame *frame = sr_thread_frames(thread);
+         frame;
+         frame = sr_frame_next(frame), ++frames)
+    {
+        struct sr_strbuf *buf = sr_strbuf_new();
+        sr_frame_append_to_str(frame, buf);
+        char *token = sr_strbuf_free_nobuf(buf);
+        minhash_add(mins, token);
+        free(token);
+    }
+
+    return frames;
+}
+
+static uint64_t signature_salt(const char *uid, const char *type, const char *executable)
+{
+    uint64_t salt = fnv1a_str(FNV1A_BASIS, uid);
+    salt = fnv1a_str(salt, type);
+    return fnv1a_str(salt, executable);
+}
+
+static void signature_uuid(struct dup_signature *sig, uint64_t salt, const char *uuid)
+{
+    sprintf(sig->fields[0], "%08"PRIx32, fold(fnv1a_str(salt, uuid)));
+}
+
+/* Returns true if the bands were computed */
+static bool signature_bands(struct dup_signature *sig, uint64_t salt,
+        const char *type, const char *backtrace)
+{
+    enum sr_report_type report_type = sr_abrt_type_from_type(type);
+    if (report_type == SR_REPORT_INVALID)
+        return false;
+
+    char *error_message = NULL;
+    struct sr_stacktrace *stacktrace = sr_stacktrace_parse(report_type, backtrace, &error_message);
+    if (!stacktrace)
+    {
+        log_debug("Can't parse the backtrace: %s", error_message);
+        free(error_message);
+        return false;
+    }
+
+    bool computed = false;
+    struct sr_thread *thread = sr_stacktrace_find_crash_thread(stacktrace);
+    if (thread)
+    {
+        uint64_t mins[DUP_INDEX_HASHES];
+        for (unsigned i = 0; i < DUP_INDEX_HASHES; ++i)
+            mins[i] = UINT64_MAX;
+
+        if (minhash_thread(report_type, thread, mins) > 0)
+        {
+            for (unsigned band = 0; band < DUP_INDEX_BANDS; ++band)
+            {
+                /* The band number keeps equal values in different bands apart */
+                uint64_t hash = fnv1a(salt, &band, sizeof(band));
+                hash = fnv1a(hash, mins + band * DUP_INDEX_ROWS, DUP_INDEX_ROWS * sizeof(mins[0]));
+                sprintf(sig->fields[1 + band], "%08"PRIx32, fold(hash));
+            }
+            computed = true;
+        }
+    }
+
+    sr_stacktrace_free(stacktrace);
+    return computed;
+}
+
+/* Returns false if the problem can't be opened. The UUID is left out if
+ * with_uuid is false and the problem has a usable backtrace; the new problem
+ * is compared by UUID only if it has no backtrace, see dup_uuid_compare().
+ */
+static bool signature_load(struct dup_signature *sig, const char *dump_dir_name, bool with_uuid)
+{
+    for (unsigned i = 0; i < DUP_INDEX_FIELDS; ++i)
+        strcpy(sig->fields[i], DUP_INDEX_NO_VALUE);
+
+    const int sv_logmode = logmode;
+    /* Problems can be deleted anytime */
+    logmode = g_verbose == 0 ? 0 : sv_logmode;
+    struct dump_dir *dd = dd_opendir(dump_dir_name, DD_OPEN_READONLY | DD_FAIL_QUIETLY_ENOENT);
+    logmode = sv_logmode;
+    if (!dd)
+        return false;
+
+    const int load_flags = DD_FAIL_QUIETLY_ENOENT | DD_LOAD_TEXT_RETURN_NULL_ON_FAILURE;
+    char *uid = dd_load_text_ext(dd, FILENAME_UID, load_flags);
+    char *type = dd_load_text_ext(dd, FILENAME_TYPE, load_flags);
+    char *executable = dd_load_text_ext(dd, FILENAME_EXECUTABLE, load_flags);
+    char *uuid = dd_load_text_ext(dd, FILENAME_UUID, load_flags);
+    /* The same backtrace as abrt-handle-event compares */
+    char *backtrace = type == NULL ? NULL
+            : dd_load_text_ext(dd, strcmp(type, "CCpp") == 0 ? FILENAME_CORE_BACKTRACE : FILENAME_BACKTRACE,
+                               load_flags);
+    dd_close(dd);
+
+    const uint64_t salt = signature_salt(uid, type, executable);
+    const bool has_bands = backtrace && signature_bands(sig, salt, type, backtrace);
+    if (uuid && (with_uuid || !has_bands))
+        signature_uuid(sig, salt, uuid);
+
+    free(backtrace);
+    free(uuid);
+    free(executable);
+    free(type);
+    free(uid);
+
+    return true;
+}
+
+static char *signature_line(const char *name, const struct dup_signature *sig)
+{
+    struct strbuf *buf = strbuf_new();
+    strbuf_append_str(buf, name);
+    for (unsigned i = 0; i < DUP_INDEX_FIELDS; ++i)
+        strbuf_append_strf(buf, " %s", sig->fields[i]);
+    strbuf_append_char(buf, '\n');
+    return strbuf_free_nobuf(buf);
+}
+
+/* Returns the name of the problem if it is directly in the dump location */
+static char *problem_name(const char *dump_location, const char *dump_dir_name)
+{
+    char *location = realpath(dump_location, NULL);
+    char *dir = realpath(dump_dir_name, NULL);
+    char *name = NULL;
+
+    if (location && dir)
+    {
+        const size_t len = strlen(location);
+        if (strncmp(location, dir, len) == 0 && dir[len] == '/' && strchr(dir + len + 1, '/') == NULL)
+            name = xstrdup(dir + len + 1);
+    }
+
+    free(dir);
+    free(location);
+    return name;
+}
+
+/* Terminates the name at the beginning of the line, returns the fields
+ * or NULL if the line is malformed */
+static const char *parse_line(char *line, ssize_t len)
+{
+    char *space = memchr(line, ' ', len);
+    if (space == NULL || space == line
+     || line + len - (space + 1) != DUP_INDEX_FIELDS * (DUP_INDEX_FIELD_LEN + 1)
+     || line[len - 1] != '\n')
+    {
+        return NULL;
+    }
+
+    *space = '\0';
+    return space + 1;
+}
+
+static bool problem_is_processed(const char *dump_location, const char *name)
+{
+    /* See dump_dir_has_element() in abrtd.c, abrtd creates FILENAME_COUNT
+     * after post-create */
+    char *dir = concat_path_file(dump_location, name);
+    char *element = concat_path_file(dir, FILENAME_COUNT);
+    free(dir);
+    struct stat st;
+    const bool processed = lstat(element, &st) == 0;
+    free(element);
+    return processed;
+}
+
+/* Returns a descriptor whose close() unlocks or -1 */
+static int lock_dump_location(const char *dump_location)
+{
+    const int fd = open(dump_location, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        perror_msg("Can't open directory '%s'", dump_location);
+        return -1;
+    }
+
+    if (flock(fd, LOCK_EX) < 0)
+    {
+        perror_msg("Can't lock directory '%s'", dump_location);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Rewrites the index with the lines of the existing processed problems.
+ * The excluded problem is being processed and will be added by
+ * dup_index_add() if post-create keeps it.
+ */
+static int sync_index(const char *dump_location, const char *index_path, const char *exclude)
+{
+    log_info("Walking '%s' to update the duplicate index", dump_location);
+
+    DIR *dp = opendir(dump_location);
+    if (!dp)
+    {
+        perror_msg("Can't open directory '%s'", dump_location);
+        return -1;
+    }
+
+    /* name -> line of the indexed problems */
+    GHashTable *known = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+    /* The read index, lines appended after read_end are merged in the end */
+    struct stat read_st;
+    long read_end = -1;
+    FILE *fp = fopen(index_path, "r");
+    if (fp)
+    {
+        char *line = NULL;
+        size_t line_size = 0;
+        /* Skip the time of the last walk */
+        if (getline(&line, &line_size, fp) >= 0)
+        {
+            ssize_t len;
+            while ((len = getline(&line, &line_size, fp)) >= 0)
+            {
+                char *copy = xstrdup(line);
+                if (parse_line(line, len))
+                    g_hash_table_replace(known, xstrdup(line), copy);
+                else
+                    free(copy);
+            }
+        }
+        free(line);
+        if (fstat(fileno(fp), &read_st) == 0)
+            read_end = ftell(fp);
+        fclose(fp);
+    }
+
+    /* Names of the problems in the new index */
+    GHashTable *written_names = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    unsigned indexed = 0;
+    struct strbuf *buf = strbuf_new();
+    strbuf_append_strf(buf, "%lld\n", (long long)time(NULL));
+
+    struct dirent *dent;
+    while ((dent = readdir(dp)) != NULL)
+    {
+        /* ".", "..", aux files like .usage */
+        if (dent->d_name[0] == '.')
+            continue;
+        const char *ext = strrchr(dent->d_name, '.');
+        if (ext && strcmp(ext, ".new") == 0)
+            continue;
+        if (exclude && strcmp(dent->d_name, exclude) == 0)
+            continue;
+
+        const char *line = g_hash_table_lookup(known, dent->d_name);
+        if (line)
+        {
+            strbuf_append_str(buf, line);
+            g_hash_table_add(written_names, xstrdup(dent->d_name));
+            continue;
+        }
+
+        if (!problem_is_processed(dump_location, dent->d_name))
+            continue;
+
+        char *dump_dir_name = concat_path_file(dump_location, dent->d_name);
+        struct dup_signature sig;
+        if (signature_load(&sig, dump_dir_name, /*with_uuid:*/ true))
+        {
+            char *new_line = signature_line(dent->d_name, &sig);
+            strbuf_append_str(buf, new_line);
+            free(new_line);
+            g_hash_table_add(written_names, xstrdup(dent->d_name));
+            ++indexed;
+        }
+        free(dump_dir_name);
+    }
+    closedir(dp);
+    g_hash_table_destroy(known);
+
+    log_info("Indexed %u new problems", indexed);
+
+    int r = -1;
+    char *tmp_path = NULL;
+    const int lock_fd = lock_dump_location(dump_location);
+    if (lock_fd < 0)
+        goto ret;
+
+    /* dup_index_add() appends to the index we read until we rename */
+    fp = fopen(index_path, "r");
+    if (fp)
+    {
+        struct stat st;
+        if (read_end < 0 || fstat(fileno(fp), &st) != 0
+         || st.st_dev != read_st.st_dev || st.st_ino != read_st.st_ino)
+        {
+            /* Another walk has replaced the index, it is as fresh as ours */
+            log_info("'%s' has been rewritten concurrently, keeping it", index_path);
+            fclose(fp);
+            r = 0;
+            goto ret;
+        }
+
+        if (fseek(fp, read_end, SEEK_SET) == 0)
+        {
+            char *line = NULL;
+            size_t line_size = 0;
+            ssize_t len;
+            while ((len = getline(&line, &line_size, fp)) >= 0)
+            {
+                char *copy = xstrdup(line);
+                if (parse_line(line, len) && !g_hash_table_contains(written_names, line))
+                    strbuf_append_str(buf, copy);
+                free(copy);
+            }
+            free(line);
+        }
+        fclose(fp);
+    }
+
+    /* Readers never see a partial index, abrt-dump-oops may walk
+     * concurrently with post-create */
+    tmp_path = xasprintf("%s.%u", index_path, (unsigned)getpid());
+    const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        log_notice("Can't create '%s': %s", tmp_path, strerror(errno));
+        goto ret;
+    }
+
+    const bool written = full_write(fd, buf->buf, buf->len) == (ssize_t)buf->len;
+    close(fd);
+    if (!written || rename(tmp_path, index_path) != 0)
+    {
+        perror_msg("Can't write '%s'", index_path);
+        unlink(tmp_path);
+        goto ret;
+    }
+
+    r = 0;
+
+ ret:
+    if (lock_fd >= 0)
+        close(lock_fd);
+    free(tmp_path);
+    g_hash_table_destroy(written_names);
+    strbuf_free(buf);
+    return r;
+}
+
+/* Returns the opened index, walks the dump location first if needed */
+static FILE *open_index(const char *dump_location, const char *index_path, const char *exclude)
+{
+    for (int walked = 0; walked < 2; ++walked)
+    {
+        FILE *fp = fopen(index_path, "r");
+        if (fp)
+        {
+            long long synced;
+            const time_t now = time(NULL);
+            if (fscanf(fp, "%lld\n", &synced) == 1
+             && synced <= now
+             && now - synced <= DUP_INDEX_MAX_AGE)
+            {
+                rewind(fp);
+                return fp;
+            }
+            fclose(fp);
+
+            /* Use what we have written if the clock jumped */
+            if (walked)
+                return fopen(index_path, "r");
+        }
+        else if (errno != ENOENT)
+        {
+            log_notice("Can't open '%s': %s", index_path, strerror(errno));
+            return NULL;
+        }
+
+        if (walked || sync_index(dump_location, index_path, exclude) != 0)
+            return NULL;
+    }
+
+    return NULL;
+}
+
+/* Adds the problems sharing a field with the query to candidates,
+ * self is never a candidate */
+static int find_candidates(const char *dump_location, const char *self,
+        const struct dup_signature *query, GList **candidates)
+{
+    char *index_path = concat_path_file(dump_location, DUP_INDEX_FILE);
+    FILE *fp = open_index(dump_location, index_path, self);
+    free(index_path);
+    if (!fp)
+        return -1;
+
+    GHashTable *seen = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    char *line = NULL;
+    size_t line_size = 0;
+    /* Skip the time of the last walk */
+    if (getline(&line, &line_size, fp) < 0)
+        goto ret;
+
+    ssize_t len;
+    while ((len = getline(&line, &line_size, fp)) >= 0)
+    {
+        const char *fields = parse_line(line, len);
+        if (!fields)
+            continue;
+
+        const char *name = line;
+        if (self && strcmp(name, self) == 0)
+            continue;
+
+        unsigned i = 0;
+        while (i < DUP_INDEX_FIELDS
+            && (query->fields[i][0] == '-'
+                || memcmp(query->fields[i], fields + i * (DUP_INDEX_FIELD_LEN + 1), DUP_INDEX_FIELD_LEN) != 0))
+        {
+            ++i;
+        }
+
+        if (i < DUP_INDEX_FIELDS && !g_hash_table_contains(seen, name))
+        {
+            g_hash_table_add(seen, xstrdup(name));
+            *candidates = g_list_prepend(*candidates, concat_path_file(dump_location, name));
+        }
+    }
+
+ ret:
+    free(line);
+    fclose(fp);
+    g_hash_table_destroy(seen);
+
+    /* The oldest problem first, like readdir() usually returns them */
+    *candidates = g_list_reverse(*candidates);
+    return 0;
+}
+
+int dup_index_find_candidates(const char *dump_location, const char *dump_dir_name,
+        GList **candidates)
+{
+    *candidates = NULL;
+
+    struct dup_signature query;
+    if (!signature_load(&query, dump_dir_name, /*with_uuid:*/ false))
+        return -1;
+
+    char *self = problem_name(dump_location, dump_dir_name);
+    const int r = find_candidates(dump_location, self, &query, candidates);
+    free(self);
+    return r;
+}
+
+int dup_index_find_uuid(const char *dump_location, const char *uid, const char *type,
+        const char *executable, const char *uuid, GList **candidates)
+{
+    *candidates = NULL;
+
+    struct dup_signature query;
+    for (unsigned i = 0; i < DUP_INDEX_FIELDS; ++i)
+        strcpy(query.fields[i], DUP_INDEX_NO_VALUE);
+    signature_uuid(&query, signature_salt(uid, type, executable), uuid);
+
+    return find_candidates(dump_location, /*self:*/ NULL, &query, candidates);
+}
+
+void dup_index_add(const char *dump_location, const char *dump_dir_name)
+{
+    char *name = problem_name(dump_location, dump_dir_name);
+    if (!name)
+        return;
+
+    char *index_path = concat_path_file(dump_location, DUP_INDEX_FILE);
+    struct dup_signature sig;
+    if (!signature_load(&sig, dump_dir_name, /*with_uuid:*/ true))
+        goto ret;
+
+    /* A walk must not rename a new index over the line */
+    const int lock_fd = lock_dump_location(dump_location);
+    if (lock_fd < 0)
+        goto ret;
+
+    /* The next walk creates the index, it indexes the processed problems */
+    const int fd = open(index_path, O_WRONLY | O_APPEND | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (errno != ENOENT)
+            log_notice("Can't open '%s': %s", index_path, strerror(errno));
+        close(lock_fd);
+        goto ret;
+    }
+
+    char *line = signature_line(name, &sig);
+    if (full_write_str(fd, line) < 0)
+        perror_msg("Can't write '%s'", index_path);
+    free(line);
+    close(fd);
+    close(lock_fd);
+
+ ret:
+    free(index_path);
+    free(name);
+}
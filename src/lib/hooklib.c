@@ -16,8 +16,19 @@
     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 #include <sys/statvfs.h>
+#include <sys/file.h>
 #include "internal_libabrt.h"
 
+/* The counter file holds "BYTES SYNCED_AT\n" where SYNCED_AT is the time of
+ * the last full walk of the dump location. Writers serialize through flock()
+ * which, unlike lockf(), locks the open file description, hence it excludes
+ * the threads of one process as well (abrt-dbus serves requests from a pool).
+ */
+#define DUMP_LOCATION_USAGE_FILE ".usage"
+/* Size changes made behind our back (reporters writing elements, rm -rf)
+ * are picked up by a full walk after this many seconds at the latest */
+#define DUMP_LOCATION_USAGE_MAX_AGE (5 * 60)
+
 int low_free_space(unsigned setting_MaxCrashReportsSize, const char *dump_location)
 {
     struct statvfs vfs;
@@ -41,6 +52,128 @@ int low_free_space(unsigned setting_MaxCrashReportsSize, const char *dump_locati
     return 0;
 }
 
+static int open_usage_file(const char *dump_location)
+{
+    char *path = concat_path_file(dump_location, DUMP_LOCATION_USAGE_FILE);
+    int fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0)
+        log_notice("Can't open '%s': %s", path, strerror(errno));
+    else if (flock(fd, LOCK_EX) < 0)
+    {
+        perror_msg("Can't lock file '%s'", path);
+        close(fd);
+        fd = -1;
+    }
+    free(path);
+    return fd;
+}
+
+/* Returns 0 if the counter holds a value which is not too old */
+static int read_usage(int fd, double *size, time_t *synced_at)
+{
+    char buf[64];
+    ssize_t r = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (r <= 0)
+        return -1;
+    buf[r] = '\0';
+
+    long long bytes, synced;
+    if (sscanf(buf, "%lld %lld", &bytes, &synced) != 2)
+        return -1;
+
+    const time_t now = time(NULL);
+    if (synced > now || now - synced > DUMP_LOCATION_USAGE_MAX_AGE)
+        return -1;
+
+    *size = bytes > 0 ? bytes : 0;
+    *synced_at = synced;
+    return 0;
+}
+
+static void write_usage(int fd, double size, time_t synced_at)
+{
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%lld %lld\n", (long long)size, (long long)synced_at);
+    if (pwrite(fd, buf, len, 0) != len || ftruncate(fd, len) != 0)
+        perror_msg("Can't update the usage counter of the dump location");
+}
+
+/* The caller must hold the lock of fd */
+static double locked_usage(int fd, const char *dump_location, time_t *synced_at)
+{
+    double size;
+    if (read_usage(fd, &size, synced_at) != 0)
+    {
+        /* The lock is held during the walk, hence no update gets lost */
+        log_info("Recomputing the size of '%s'", dump_location);
+        *synced_at = time(NULL);
+        size = get_dirsize(dump_location);
+        write_usage(fd, size, *synced_at);
+    }
+    return size;
+}
+
+double dump_location_usage(const char *dump_location)
+{
+    int fd = open_usage_file(dump_location);
+    if (fd < 0)
+        return get_dirsize(dump_location);
+
+    time_t synced_at;
+    const double size = locked_usage(fd, dump_location, &synced_at);
+    close(fd);
+
+    return size;
+}
+
+int dump_location_usage_reserve(const char *dump_location, double max_size,
+        double delta, int (*store)(void *), void *arg)
+{
+    int fd = open_usage_file(dump_location);
+
+    time_t synced_at = 0;
+    const double size = fd < 0 ? get_dirsize(dump_location)
+                               : locked_usage(fd, dump_location, &synced_at);
+
+    /* Don't check the limit when the data shrinks */
+    int r = -1;
+    if (delta <= 0 || delta <= max_size - size)
+    {
+        r = store(arg);
+        if (r == 0 && fd >= 0)
+            write_usage(fd, MAX(size + delta, 0), synced_at);
+    }
+
+    if (fd >= 0)
+        close(fd);
+
+    return r;
+}
+
+void dump_location_usage_add(const char *dump_location, double delta)
+{
+    int fd = open_usage_file(dump_location);
+    if (fd < 0)
+        return;
+
+    /* Invalid or old counter will be recomputed by the next reader */
+    double size;
+    time_t synced_at;
+    if (read_usage(fd, &size, &synced_at) == 0)
+        write_usage(fd, MAX(size + delta, 0), synced_at);
+    close(fd);
+}
+
+void dump_location_usage_set(const char *dump_location, double size)
+{
+    int fd = open_usage_file(dump_location);
+    if (fd < 0)
+        return;
+
+    write_usage(fd, size, time(NULL));
+    close(fd);
+}
+
 /* rhbz#539551: "abrt going crazy when crashing process is respawned".
  * Check total size of problem dirs, if it overflows,
  * delete oldest/biggest dirs.
@@ -73,6 +206,9 @@ void trim_problem_dirs(const char *dirname, double cap_size, const char *exclude
         {
             log_info("cur_size:%.0f cap_size:%.0f, no (more) trimming", cur_size, cap_size);
             free(worst_basename);
+            /* We have just walked the whole dump location, don't waste it */
+            if (g_settings_dump_location && strcmp(dirname, g_settings_dump_location) == 0)
+                dump_location_usage_set(dirname, cur_size);
             break;
         }
         log("%s is %.0f bytes (more than %.0fMiB), deleting '%s'",
@@ -239,6 +375,9 @@ char *run_unstrip_n(const char *dump_dir_name, unsigned timeout_sec)
     return strbuf_free_nobuf(buf_out);
 }
 
+/* Keep in sync with INDEX_DIR in abrt-action-install-debuginfo */
+#define DEBUGINFO_BUILD_ID_INDEX ".build-id-index"
+
 char *get_backtrace(const char *dump_dir_name, unsigned timeout_sec, const char *debuginfo_dirs)
 {
     INITIALIZE_LIBABRT();
@@ -266,9 +405,16 @@ char *get_backtrace(const char *dump_dir_name, unsigned timeout_sec, const char
     }
     else
     {
-        strbuf_append_str(set_debug_file_directory, "set debug-file-directory /usr/lib/debug");
+        strbuf_append_str(set_debug_file_directory, "set debug-file-directory ");
 
+        /* gdb tries the build-id lookup in all debug file directories
+         * before anything else, in the given order. Putting the build-id
+         * indexes maintained by abrt-action-install-debuginfo first lets gdb
+         * find every indexed debuginfo with a single lookup instead of
+         * probing all the directories.
+         */
         struct strbuf *debug_directories = strbuf_new();
+        struct strbuf *build_id_indexes = strbuf_new();
         const char *p = debuginfo_dirs;
         while (1)
         {
@@ -279,10 +425,20 @@ char *get_backtrace(const char *dump_dir_name, unsigned timeout_sec, const char
             const char *colon_or_nul = strchrnul(p, ':');
             strbuf_append_strf(debug_directories, "%s%.*s/usr/lib/debug", (debug_directories->len == 0 ? "" : ":"),
                                                                           (int)(colon_or_nul - p), p);
+
+            char *index = xasprintf("%.*s/"DEBUGINFO_BUILD_ID_INDEX, (int)(colon_or_nul - p), p);
+            char *index_build_id = concat_path_file(index, ".build-id");
+            if (access(index_build_id, X_OK) == 0)
+                strbuf_append_strf(build_id_indexes, "%s:", index);
+            free(index_build_id);
+            free(index);
+
             p = colon_or_nul;
         }
 
-        strbuf_append_strf(set_debug_file_directory, ":%s", debug_directories->buf);
+        strbuf_append_strf(set_debug_file_directory, "%s/usr/lib/debug:%s",
+                build_id_indexes->buf, debug_directories->buf);
+        strbuf_free(build_id_indexes);
 
         args[i++] = (char*)"-iex";
         auto_load_base_index = i;
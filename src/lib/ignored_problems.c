@@ -23,15 +23,34 @@
 #define IGN_DD_OPEN_FLAGS (DD_OPEN_READONLY | DD_FAIL_QUIETLY_ENOENT | DD_FAIL_QUIETLY_EACCES)
 #define IGN_DD_LOAD_TEXT_FLAGS (DD_LOAD_TEXT_RETURN_NULL_ON_FAILURE | DD_FAIL_QUIETLY_ENOENT | DD_FAIL_QUIETLY_EACCES)
 
+/* The contents of the ignored problems file are cached in three hash sets,
+ * one per column. The sets are reloaded only when the file is replaced
+ * or modified (its inode, size or mtime changes).
+ */
 struct ignored_problems
 {
     char *ign_set_file_path;
+    GHashTable *ign_ids;
+    GHashTable *ign_uuids;
+    GHashTable *ign_duphashes;
+    /* Identity of the cached file, st_ino == 0 if no file was loaded */
+    struct stat ign_stat;
+};
+
+struct ignored_problems_row
+{
+    const char *problem_id;
+    const char *uuid;
+    const char *duphash;
 };
 
 ignored_problems_t *ignored_problems_new(char *set_file_path)
 {
-    ignored_problems_t *set = xmalloc(sizeof(*set));
+    ignored_problems_t *set = xzalloc(sizeof(*set));
     set->ign_set_file_path = set_file_path;
+    set->ign_ids = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    set->ign_uuids = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+    set->ign_duphashes = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
     return set;
 }
 
@@ -39,10 +58,105 @@ void ignored_problems_free(ignored_problems_t *set)
 {
     if (!set)
         return;
+    g_hash_table_destroy(set->ign_duphashes);
+    g_hash_table_destroy(set->ign_uuids);
+    g_hash_table_destroy(set->ign_ids);
     free(set->ign_set_file_path);
     free(set);
 }
 
+static void ignored_problems_cache_clear(ignored_problems_t *set)
+{
+    g_hash_table_remove_all(set->ign_ids);
+    g_hash_table_remove_all(set->ign_uuids);
+    g_hash_table_remove_all(set->ign_duphashes);
+    memset(&set->ign_stat, 0, sizeof(set->ign_stat));
+}
+
+static bool ignored_problems_stat_changed(const struct stat *old, const struct stat *new)
+{
+    return old->st_dev != new->st_dev
+        || old->st_ino != new->st_ino
+        || old->st_size != new->st_size
+        || old->st_mtim.tv_sec != new->st_mtim.tv_sec
+        || old->st_mtim.tv_nsec != new->st_mtim.tv_nsec;
+}
+
+static void ignored_problems_cache_add_line(ignored_problems_t *set,
+        const char *line, unsigned line_num)
+{
+    GHashTable *const columns[] = { set->ign_ids, set->ign_uuids, set->ign_duphashes };
+    static const char *const missing_column_msgs[] = {
+        NULL,
+        "No 2nd column (UUID) at line %d in ignored problems file '%s'",
+        "No 3rd column (DUPHASH) at line %d in ignored problems file '%s'",
+    };
+
+    const char *ignored = line;
+    for (unsigned i = 0; i < ARRAY_SIZE(columns); ++i)
+    {
+        const char *ignored_end = strchrnul(ignored, IGN_COLUMN_DELIMITER);
+        g_hash_table_add(columns[i], xstrndup(ignored, ignored_end - ignored));
+
+        if (ignored_end[0] == '\0')
+        {
+            if (i + 1 < ARRAY_SIZE(columns))
+                log_notice(missing_column_msgs[i + 1], line_num, set->ign_set_file_path);
+            break;
+        }
+        ignored = ignored_end + 1;
+    }
+}
+
+/* Makes sure the cache reflects the current contents of the file */
+static void ignored_problems_cache_update(ignored_problems_t *set)
+{
+    struct stat st;
+    if (stat(set->ign_set_file_path, &st) != 0)
+    {
+        if (errno != ENOENT)
+            pwarn_msg("Can't stat ignored problems '%s'", set->ign_set_file_path);
+        ignored_problems_cache_clear(set);
+        return;
+    }
+
+    if (!ignored_problems_stat_changed(&set->ign_stat, &st))
+        return;
+
+    ignored_problems_cache_clear(set);
+
+    FILE *fp = fopen(set->ign_set_file_path, "r");
+    if (!fp)
+    {
+        if (errno != ENOENT)
+            pwarn_msg("Can't open ignored problems '%s' in mode '%s'", set->ign_set_file_path, "r");
+        return;
+    }
+
+    /* Stat the opened file to not cache contents of a file
+     * replaced between stat() and fopen()
+     */
+    if (fstat(fileno(fp), &st) != 0)
+    {
+        pwarn_msg("Can't stat ignored problems '%s'", set->ign_set_file_path);
+        fclose(fp);
+        return;
+    }
+
+    unsigned line_num = 0;
+    char *line;
+    while ((line = xmalloc_fgetline(fp)) != NULL)
+    {
+        ++line_num;
+        ignored_problems_cache_add_line(set, line, line_num);
+        free(line);
+    }
+    fclose(fp);
+
+    log_debug("Loaded %u lines from ignored problems '%s'", line_num, set->ign_set_file_path);
+    set->ign_stat = st;
+}
+
 static bool ignored_problems_eq(ignored_problems_t *set,
         const char *problem_id, const char *uuid, const char *duphash,
         const char *line, unsigned line_num)
@@ -89,72 +203,116 @@ static bool ignored_problems_eq(ignored_problems_t *set,
     return false;
 }
 
-static bool ignored_problems_file_contains(ignored_problems_t *set,
-        const char *problem_id, const char *uuid, const char *duphash,
-        FILE **out_fp, const char *mode)
+static bool ignored_problems_cache_lookup(ignored_problems_t *set,
+        const char *problem_id, const char *uuid, const char *duphash)
 {
-    bool found = false;
-    FILE *fp = fopen(set->ign_set_file_path, mode);
-    if (!fp)
+    if (problem_id != NULL && g_hash_table_contains(set->ign_ids, problem_id))
     {
-        if (errno != ENOENT)
-            pwarn_msg("Can't open ignored problems '%s' in mode '%s'", set->ign_set_file_path, mode);
-        goto ret_contains_end;
+        log_notice("Ignored id matches '%s'", problem_id);
+        return true;
     }
 
-    unsigned line_num = 0;
-    while (!found)
+    if (uuid != NULL && g_hash_table_contains(set->ign_uuids, uuid))
     {
-        char *line = xmalloc_fgetline(fp);
-        if (!line)
-            break;
-        ++line_num;
-        found = ignored_problems_eq(set, problem_id, uuid, duphash, line, line_num);
-        free(line);
+        log_notice("Ignored uuid '%s' matches uuid of problem '%s'", uuid, problem_id);
+        return true;
     }
 
- ret_contains_end:
-    if (out_fp)
-        *out_fp = fp;
-    else if (fp)
-        fclose(fp);
+    if (duphash != NULL && g_hash_table_contains(set->ign_duphashes, duphash))
+    {
+        log_notice("Ignored duphash '%s' matches duphash of problem '%s'", duphash, problem_id);
+        return true;
+    }
 
-    return found;
+    return false;
 }
 
-static void ignored_problems_add_row(ignored_problems_t *set, const char *problem_id,
-        const char *uuid, const char *duphash)
+static bool ignored_problems_cache_contains(ignored_problems_t *set,
+        const char *problem_id, const char *uuid, const char *duphash)
+{
+    ignored_problems_cache_update(set);
+    return ignored_problems_cache_lookup(set, problem_id, uuid, duphash);
+}
+
+/* Appends the rows which are not yet in the set with a single write to
+ * a file opened in O_APPEND mode, so concurrent writers never interleave
+ * parts of their lines.
+ */
+static void ignored_problems_add_rows(ignored_problems_t *set,
+        const struct ignored_problems_row *rows, unsigned rows_count)
 {
-    log_notice("Going to add problem '%s' to ignored problems", problem_id);
+    ignored_problems_cache_update(set);
 
-    FILE *fp;
-    if (!ignored_problems_file_contains(set, problem_id, uuid, duphash, &fp, "a+"))
+    struct strbuf *buf = strbuf_new();
+    for (unsigned i = 0; i < rows_count; ++i)
     {
-        if (fp)
-        {
-            /* We can add write error checks here.
-             * However, what exactly can we *do* if we detect it?
-             */
-            fprintf(fp, "%s;%s;%s\n", problem_id, (uuid ? uuid : ""),
-                                      (duphash ? duphash : ""));
-        }
-        else
+        log_notice("Going to add problem '%s' to ignored problems", rows[i].problem_id);
+
+        if (ignored_problems_cache_lookup(set, rows[i].problem_id, rows[i].uuid, rows[i].duphash))
         {
-            /* This is not a fatal problem. We are permissive because we don't want
-             * to scare users by strange error messages.
-             */
-            log_notice("Can't add problem '%s' to ignored problems:"
-                      " can't open the list", problem_id);
+            log_notice("Won't add problem '%s' to ignored problems:"
+                    " it is already there", rows[i].problem_id);
+            continue;
         }
+
+        const size_t line_start = buf->len;
+        strbuf_append_strf(buf, "%s;%s;%s\n", rows[i].problem_id,
+                                  (rows[i].uuid ? rows[i].uuid : ""),
+                                  (rows[i].duphash ? rows[i].duphash : ""));
+
+        /* Do not add duplicates within one call */
+        buf->buf[buf->len - 1] = '\0';
+        ignored_problems_cache_add_line(set, buf->buf + line_start, /*line_num*/0);
+        buf->buf[buf->len - 1] = '\n';
     }
-    else
+
+    if (buf->len == 0)
+        goto ret_free_buf;
+
+    const int fd = open(set->ign_set_file_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0)
     {
-        log_notice("Won't add problem '%s' to ignored problems:"
-                " it is already there", problem_id);
+        /* This is not a fatal problem. We are permissive because we don't want
+         * to scare users by strange error messages.
+         */
+        log_notice("Can't add problems to ignored problems:"
+                  " can't open the list '%s'", set->ign_set_file_path);
+        ignored_problems_cache_clear(set);
+        goto ret_free_buf;
     }
 
-    if (fp)
-        fclose(fp);
+    /* We can add write error checks here.
+     * However, what exactly can we *do* if we detect it?
+     */
+    struct stat before, after;
+    const bool consistent = fstat(fd, &before) == 0
+                    && !ignored_problems_stat_changed(&set->ign_stat, &before)
+                    && full_write(fd, buf->buf, buf->len) == (ssize_t)buf->len
+                    && fstat(fd, &after) == 0
+                    && after.st_size == before.st_size + (off_t)buf->len;
+    close(fd);
+
+    /* The cache already contains the added rows. Keep it only if nobody
+     * else modified the file in the meantime.
+     */
+    if (consistent)
+        set->ign_stat = after;
+    else
+        ignored_problems_cache_clear(set);
+
+ ret_free_buf:
+    strbuf_free(buf);
+}
+
+static void ignored_problems_add_row(ignored_problems_t *set, const char *problem_id,
+        const char *uuid, const char *duphash)
+{
+    struct ignored_problems_row row = {
+        .problem_id = problem_id,
+        .uuid = uuid,
+        .duphash = duphash,
+    };
+    ignored_problems_add_rows(set, &row, 1);
 }
 
 void ignored_problems_add_problem_data(ignored_problems_t *set, problem_data_t *pd)
@@ -166,65 +324,104 @@ void ignored_problems_add_problem_data(ignored_problems_t *set, problem_data_t *
             );
 }
 
-void ignored_problems_add(ignored_problems_t *set, const char *problem_id)
+/* Loads UUID and DUPHASH of the problem. Both are left NULL
+ * if the problem can't be opened.
+ */
+static bool ignored_problems_load_row(const char *problem_id, char **uuid, char **duphash)
 {
+    *uuid = NULL;
+    *duphash = NULL;
+
     struct dump_dir *dd = dd_opendir(problem_id, IGN_DD_OPEN_FLAGS);
     if (!dd)
+        return false;
+
+    *uuid = dd_load_text_ext(dd, FILENAME_UUID, IGN_DD_LOAD_TEXT_FLAGS);
+    *duphash = dd_load_text_ext(dd, FILENAME_DUPHASH, IGN_DD_LOAD_TEXT_FLAGS);
+    dd_close(dd);
+    return true;
+}
+
+void ignored_problems_add(ignored_problems_t *set, const char *problem_id)
+{
+    GList problem_ids = { .data = (gpointer)problem_id, .next = NULL, .prev = NULL };
+    ignored_problems_add_list(set, &problem_ids);
+}
+
+static void ignored_problems_rows_free(struct ignored_problems_row *rows, unsigned rows_count)
+{
+    for (unsigned i = 0; i < rows_count; ++i)
     {
-        /* We do not consider this as an error because the directory can be
-         * deleted by other programs. This code expects that dd_opendir()
-         * already emitted good explanatory message. This message
-         * explains what the previous failure causes.
-         */
-        VERB1 log("Can't add problem '%s' to ignored problems:"
-                " can't open the problem", problem_id);
-        return;
+        free((char *)rows[i].duphash);
+        free((char *)rows[i].uuid);
     }
-    char *uuid = dd_load_text_ext(dd, FILENAME_UUID, IGN_DD_LOAD_TEXT_FLAGS);
-    char *duphash = dd_load_text_ext(dd, FILENAME_DUPHASH, IGN_DD_LOAD_TEXT_FLAGS);
-    dd_close(dd);
+    free(rows);
+}
 
-    ignored_problems_add_row(set, problem_id, uuid, duphash);
+void ignored_problems_add_list(ignored_problems_t *set, GList *problem_ids)
+{
+    struct ignored_problems_row *rows = xzalloc(g_list_length(problem_ids) * sizeof(*rows));
 
-    free(duphash);
-    free(uuid);
+    unsigned count = 0;
+    for (GList *iter = problem_ids; iter; iter = g_list_next(iter))
+    {
+        const char *problem_id = iter->data;
+        char *uuid, *duphash;
+        if (!ignored_problems_load_row(problem_id, &uuid, &duphash))
+        {
+            /* We do not consider this as an error because the directory can be
+             * deleted by other programs. This code expects that dd_opendir()
+             * already emitted good explanatory message. This message
+             * explains what the previous failure causes.
+             */
+            VERB1 log("Can't add problem '%s' to ignored problems:"
+                    " can't open the problem", problem_id);
+            continue;
+        }
+
+        rows[count].problem_id = problem_id;
+        rows[count].uuid = uuid;
+        rows[count].duphash = duphash;
+        ++count;
+    }
+
+    ignored_problems_add_rows(set, rows, count);
+    ignored_problems_rows_free(rows, count);
 }
 
-void ignored_problems_remove_row(ignored_problems_t *set, const char *problem_id,
-        const char *uuid, const char *duphash)
+/* Removes all lines matching any of the rows */
+static void ignored_problems_remove_rows(ignored_problems_t *set,
+        const struct ignored_problems_row *rows, unsigned rows_count)
 {
     INITIALIZE_LIBABRT();
 
-    VERB1 log("Going to remove problem '%s' from ignored problems", problem_id);
+    ignored_problems_cache_update(set);
 
-    FILE *orig_fp;
-    if (!ignored_problems_file_contains(set, problem_id, uuid, duphash, &orig_fp, "r"))
+    bool found = false;
+    for (unsigned i = 0; i < rows_count; ++i)
     {
-        if (orig_fp)
-        {
-            log_notice("Won't remove problem '%s' from ignored problems:"
-                      " it is already removed", problem_id);
-            /* Close orig_fp here becuase it looks like much simpler than
-             * exetendig the set of goto labels at the end of this function */
-            fclose(orig_fp);
-        }
+        VERB1 log("Going to remove problem '%s' from ignored problems", rows[i].problem_id);
+
+        if (ignored_problems_cache_lookup(set, rows[i].problem_id, rows[i].uuid, rows[i].duphash))
+            found = true;
         else
-        {
-            /* This is not a fatal problem. We are permissive because we don't want
-             * to scare users by strange error messages.
-             */
-            log_notice("Can't remove problem '%s' from ignored problems:"
-                      " can't open the list", problem_id);
-        }
-        return;
+            log_notice("Won't remove problem '%s' from ignored problems:"
+                      " it is already removed", rows[i].problem_id);
     }
 
-    /* orig_fp must be valid here because if ignored_problems_file_contains()
-     * returned TRUE the function ensures that orig_fp is set to a valid FILE*.
-     *
-     * But the function moved the file position indicator.
-     */
-    rewind(orig_fp);
+    if (!found)
+        return;
+
+    FILE *orig_fp = fopen(set->ign_set_file_path, "r");
+    if (!orig_fp)
+    {
+        /* This is not a fatal problem. We are permissive because we don't want
+         * to scare users by strange error messages.
+         */
+        log_notice("Can't remove problems from ignored problems:"
+                  " can't open the list '%s'", set->ign_set_file_path);
+        return;
+    }
 
     char *new_tempfile_name = xasprintf("%s.XXXXXX", set->ign_set_file_path);
     int new_tempfile_fd = mkstemp(new_tempfile_name);
@@ -239,7 +436,12 @@ void ignored_problems_remove_row(ignored_problems_t *set, const char *problem_id
     while ((line = xmalloc_fgetline(orig_fp)) != NULL)
     {
         ++line_num;
-        if (!ignored_problems_eq(set, problem_id, uuid, duphash, line, line_num))
+        bool matches = false;
+        for (unsigned i = 0; !matches && i < rows_count; ++i)
+            matches = ignored_problems_eq(set, rows[i].problem_id, rows[i].uuid,
+                                          rows[i].duphash, line, line_num);
+
+        if (!matches)
         {
             ssize_t len = strlen(line);
             line[len] = '\n';
@@ -248,9 +450,9 @@ void ignored_problems_remove_row(ignored_problems_t *set, const char *problem_id
                 /* Probably out of space */
                 line[len] = '\0';
                 perror_msg(_("Can't write to '%s'."
-                        " Problem '%s' will not be removed from the ignored"
+                        " Problems will not be removed from the ignored"
                         " problems '%s'"),
-                        new_tempfile_name, problem_id, set->ign_set_file_path);
+                        new_tempfile_name, set->ign_set_file_path);
                 free(line);
                 goto ret_unlink_new;
             }
@@ -261,8 +463,8 @@ void ignored_problems_remove_row(ignored_problems_t *set, const char *problem_id
     if (rename(new_tempfile_name, set->ign_set_file_path) < 0)
     {
         /* Something nefarious happened */
-        perror_msg(_("Can't rename '%s' to '%s'. Failed to remove problem '%s'"),
-                set->ign_set_file_path, new_tempfile_name, problem_id);
+        perror_msg(_("Can't rename '%s' to '%s'. Failed to remove problems"),
+                set->ign_set_file_path, new_tempfile_name);
  ret_unlink_new:
         unlink(new_tempfile_name);
     }
@@ -273,6 +475,19 @@ void ignored_problems_remove_row(ignored_problems_t *set, const char *problem_id
         close(new_tempfile_fd);
     free(new_tempfile_name);
 
+    /* The file has been replaced, reload it on the next query */
+    ignored_problems_cache_clear(set);
+}
+
+void ignored_problems_remove_row(ignored_problems_t *set, const char *problem_id,
+        const char *uuid, const char *duphash)
+{
+    struct ignored_problems_row row = {
+        .problem_id = problem_id,
+        .uuid = uuid,
+        .duphash = duphash,
+    };
+    ignored_problems_remove_rows(set, &row, 1);
 }
 
 void ignored_problems_remove_problem_data(ignored_problems_t *set, problem_data_t *pd)
@@ -286,47 +501,61 @@ void ignored_problems_remove_problem_data(ignored_problems_t *set, problem_data_
 
 void ignored_problems_remove(ignored_problems_t *set, const char *problem_id)
 {
-    char *uuid = NULL;
-    char *duphash = NULL;
-    struct dump_dir *dd = dd_opendir(problem_id, IGN_DD_OPEN_FLAGS);
-    if (dd)
-    {
-        uuid = dd_load_text_ext(dd, FILENAME_UUID, IGN_DD_LOAD_TEXT_FLAGS);
-        duphash = dd_load_text_ext(dd, FILENAME_DUPHASH, IGN_DD_LOAD_TEXT_FLAGS);
-        dd_close(dd);
-    }
-    else
+    GList problem_ids = { .data = (gpointer)problem_id, .next = NULL, .prev = NULL };
+    ignored_problems_remove_list(set, &problem_ids);
+}
+
+void ignored_problems_remove_list(ignored_problems_t *set, GList *problem_ids)
+{
+    const unsigned count = g_list_length(problem_ids);
+    struct ignored_problems_row *rows = xzalloc(count * sizeof(*rows));
+
+    unsigned i = 0;
+    for (GList *iter = problem_ids; iter; iter = g_list_next(iter), ++i)
     {
-        /* We do not consider this as an error because the directory can be
-         * deleted by other programs. This code expects that dd_opendir()
-         * already emitted good explanatory message. This message
-         * explains what the previous failure causes.
-         */
-        VERB1 error_msg("Can't get UUID/DUPHASH from"
-                " '%s' to remove it from the ignored problems:"
-                " can't open the problem", problem_id);
-    }
+        const char *problem_id = iter->data;
+        char *uuid, *duphash;
+        if (!ignored_problems_load_row(problem_id, &uuid, &duphash))
+        {
+            /* We do not consider this as an error because the directory can be
+             * deleted by other programs. This code expects that dd_opendir()
+             * already emitted good explanatory message. This message
+             * explains what the previous failure causes.
+             */
+            VERB1 error_msg("Can't get UUID/DUPHASH from"
+                    " '%s' to remove it from the ignored problems:"
+                    " can't open the problem", problem_id);
+        }
 
-    ignored_problems_remove_row(set, problem_id, uuid, duphash);
+        rows[i].problem_id = problem_id;
+        rows[i].uuid = uuid;
+        rows[i].duphash = duphash;
+    }
 
-    free(duphash);
-    free(uuid);
+    ignored_problems_remove_rows(set, rows, count);
+    ignored_problems_rows_free(rows, count);
 }
 
 bool ignored_problems_contains_problem_data(ignored_problems_t *set, problem_data_t *pd)
 {
-    return ignored_problems_file_contains(set,
+    return ignored_problems_cache_contains(set,
             problem_data_get_content_or_NULL(pd, CD_DUMPDIR),
             problem_data_get_content_or_NULL(pd, FILENAME_UUID),
-            problem_data_get_content_or_NULL(pd, FILENAME_DUPHASH),
-            /* (FILE **) */NULL, "r"
+            problem_data_get_content_or_NULL(pd, FILENAME_DUPHASH)
             );
 }
 
 bool ignored_problems_contains(ignored_problems_t *set, const char *problem_id)
 {
-    struct dump_dir *dd = dd_opendir(problem_id, IGN_DD_OPEN_FLAGS);
-    if (!dd)
+    log_notice("Going to check if problem '%s' is in ignored problems '%s'",
+            problem_id, set->ign_set_file_path);
+
+    /* Problem ID matches do not need to open the problem */
+    if (ignored_problems_cache_contains(set, problem_id, NULL, NULL))
+        return true;
+
+    char *uuid, *duphash;
+    if (!ignored_problems_load_row(problem_id, &uuid, &duphash))
     {
         /* We do not consider this as an error because the directory can be
          * deleted by other programs. This code expects that dd_opendir()
@@ -338,15 +567,8 @@ bool ignored_problems_contains(ignored_problems_t *set, const char *problem_id)
                 problem_id);
         return false;
     }
-    char *uuid = dd_load_text_ext(dd, FILENAME_UUID, IGN_DD_LOAD_TEXT_FLAGS);
-    char *duphash = dd_load_text_ext(dd, FILENAME_DUPHASH, IGN_DD_LOAD_TEXT_FLAGS);
-    dd_close(dd);
-
-    log_notice("Going to check if problem '%s' is in ignored problems '%s'",
-            problem_id, set->ign_set_file_path);
 
-    bool found = ignored_problems_file_contains(set, problem_id, uuid, duphash,
-                    /* (FILE **) */NULL, "r");
+    bool found = ignored_problems_cache_contains(set, problem_id, uuid, duphash);
 
     free(duphash);
     free(uuid);
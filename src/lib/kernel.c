@@ -236,12 +236,35 @@ int koops_line_skip_level(const char **c)
     return linelevel;
 }
 
+/* Returns the first occurrence of needle in [from, end) or end.
+ *
+ * The result is remembered in *next and reused while it is not behind
+ * 'from', hence a needle which is rare in the buffer is searched for once
+ * instead of once per line. memmem() and memchr() are vectorized in glibc,
+ * which makes rejecting long runs of uninteresting syslog lines cheap.
+ */
+static const char *find_next(const char **next, const char *from, const char *end,
+                const char *needle, size_t needle_len)
+{
+    if (*next == NULL || *next < from)
+    {
+        *next = memmem(from, end - from, needle, needle_len);
+        if (*next == NULL)
+            *next = end;
+    }
+
+    return *next;
+}
+
 void koops_extract_oopses(GList **oops_list, char *buffer, size_t buflen)
 {
     char *c;
     int linecount = 0;
     int lines_info_size = 0;
     struct abrt_koops_line_info *lines_info = NULL;
+    const char *const buffer_end = buffer + buflen;
+    const char *next_kernel = NULL;
+    const char *next_marker = NULL;
 
     /* Split buffer into lines */
 
@@ -269,8 +292,8 @@ void koops_extract_oopses(GList **oops_list, char *buffer, size_t buflen)
          * We detect it by checking for N:NN:NN pattern in first 15 chars
          * (and this still is not good enough... false positive: "pci 0000:15:00.0: PME# disabled")
          */
-        colon = strchr(c, ':');
-        if (colon && colon > c && colon < c + 15
+        colon = memchr(c, ':', strnlen(c, 15));
+        if (colon && colon > c
          && isdigit(colon[-1]) /* N:... */
          && isdigit(colon[1]) /* ...N:NN:... */
          && isdigit(colon[2])
@@ -280,14 +303,21 @@ void koops_extract_oopses(GList **oops_list, char *buffer, size_t buflen)
         ) {
             /* It's syslog file, not a bare dmesg */
 
-            /* Skip non-kernel lines */
-            char *kernel_str = strstr(c, "kernel: ");
+            /* Skip non-kernel lines. The strings are searched for in the
+             * rest of the buffer at once, the lines in between can't
+             * contain them.
+             */
+            char *kernel_str = NULL;
+            if (find_next(&next_kernel, c, buffer_end, "kernel: ", strlen("kernel: ")) < c9)
+                kernel_str = strstr(c, "kernel: ");
             if (!kernel_str)
             {
                 /* if we see our own marker:
                  * "hostname abrt: Kerneloops: Reported 1 kernel oopses to Abrt"
                  * we know we submitted everything upto here already */
-                if (strstr(c, "kernel oopses to Abrt"))
+                if (find_next(&next_marker, c, buffer_end, "kernel oopses to Abrt",
+                            strlen("kernel oopses to Abrt")) < c9
+                    && strstr(c, "kernel oopses to Abrt"))
                 {
                     log_debug("Found our marker at line %d", linecount);
                     free(lines_info);
@@ -505,7 +535,72 @@ void koops_extract_oopses_from_lines(GList **oops_list, const struct abrt_koops_
         }
     }
 }
-int koops_hash_str_ext(char result[SHA1_RESULT_LEN*2 + 1], const char *oops_buf, int frame_count, int duphash_flags)
+
+const char *koops_duphash_cache_dir = VAR_RUN"/abrt/koops-duphash";
+/* A storm of distinct oopses must not fill the memory of a long running
+ * log watcher nor the tmpfs */
+unsigned koops_duphash_cache_max_entries = 1024;
+
+/* Returns a copy of oops_buf without the parts which differ between
+ * occurrences of the same oops and are not used for its duphash
+ * (only function names, modules and reliability of frames are used):
+ * hexadecimal numbers (addresses, offsets, registers, stack contents),
+ * PIDs and CPU numbers. Hence the repeated occurrences of a WARN_ON() are normalized
+ * to the same text.
+ */
+static char *koops_normalize(const char *oops_buf)
+{
+    char *result = xmalloc(strlen(oops_buf) + 1);
+    char *dst = result;
+    const char *src = oops_buf;
+    while (*src)
+    {
+        const bool word_start = (src == oops_buf || !isalnum(src[-1]));
+        if (word_start && src[0] == '0' && src[1] == 'x' && isxdigit(src[2]))
+        {
+            dst = stpcpy(dst, "0x#");
+            src += 2;
+            while (isxdigit(*src))
+                ++src;
+            continue;
+        }
+
+        if (word_start && isxdigit(*src))
+        {
+            /* "ffffffff81662d11", but not a function name like "deadbeef" */
+            const char *end = src;
+            bool digit = false;
+            while (isxdigit(*end))
+                digit |= isdigit(*end++);
+
+            if (end - src >= 8 && digit && !isalnum(*end) && *end != '_')
+            {
+                *dst++ = '#';
+                src = end;
+                continue;
+            }
+        }
+
+        /* "CPU: 0 PID: 37 Comm: kworker/0:1" */
+        if ((strncmp(src, "PID: ", 5) == 0 || strncmp(src, "CPU: ", 5) == 0)
+            && isdigit(src[5]))
+        {
+            dst = mempcpy(dst, src, 5);
+            *dst++ = '#';
+            src += 5;
+            while (isdigit(*src))
+                ++src;
+            continue;
+        }
+
+        *dst++ = *src++;
+    }
+    *dst = '\0';
+
+    return result;
+}
+
+static int koops_hash_str_parse(char result[SHA1_RESULT_LEN*2 + 1], const char *oops_buf, int frame_count, int duphash_flags)
 {
     char *hash_str = NULL, *error = NULL;
     int bad = 0;
@@ -556,6 +651,177 @@ end:
     return bad;
 }
 
+/* Duphashes of oopses are cached in memory and in koops_duphash_cache_dir
+ * (which is on tmpfs, so the cache lives until reboot) keyed by SHA1 of
+ * the normalized oops text. Empty value means the oops couldn't be hashed.
+ * Both caches hold at most koops_duphash_cache_max_entries values. The
+ * memory cache is dropped as a whole when it is full, the directory loses
+ * its oldest files.
+ */
+static GHashTable *s_koops_duphash_cache;
+
+/* Takes ownership of value */
+static void koops_duphash_cache_remember(const char *key, char *value)
+{
+    if (g_hash_table_size(s_koops_duphash_cache) >= koops_duphash_cache_max_entries)
+        g_hash_table_remove_all(s_koops_duphash_cache);
+
+    g_hash_table_insert(s_koops_duphash_cache, xstrdup(key), value);
+}
+
+struct koops_duphash_cache_file
+{
+    struct timespec mtime;
+    char *name;
+};
+
+static gint koops_duphash_cache_file_cmp(gconstpointer a, gconstpointer b)
+{
+    const struct koops_duphash_cache_file *fa = a;
+    const struct koops_duphash_cache_file *fb = b;
+    if (fa->mtime.tv_sec != fb->mtime.tv_sec)
+        return fa->mtime.tv_sec < fb->mtime.tv_sec ? -1 : 1;
+    if (fa->mtime.tv_nsec != fb->mtime.tv_nsec)
+        return fa->mtime.tv_nsec < fb->mtime.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static void koops_duphash_cache_file_free(gpointer data)
+{
+    struct koops_duphash_cache_file *file = data;
+    free(file->name);
+    free(file);
+}
+
+/* Deletes the oldest cached values above the limit */
+static void koops_duphash_cache_trim_dir(void)
+{
+    DIR *dp = opendir(koops_duphash_cache_dir);
+    if (!dp)
+        return;
+
+    GList *files = NULL;
+    unsigned count = 0;
+    struct dirent *dent;
+    while ((dent = readdir(dp)) != NULL)
+    {
+        /* Skip ".", ".." and the temporary files of concurrent writers */
+        if (strlen(dent->d_name) != SHA1_RESULT_LEN*2)
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(dp), dent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            continue;
+
+        struct koops_duphash_cache_file *file = xmalloc(sizeof(*file));
+        file->mtime = st.st_mtim;
+        file->name = xstrdup(dent->d_name);
+        files = g_list_prepend(files, file);
+        ++count;
+    }
+
+    if (count > koops_duphash_cache_max_entries)
+    {
+        files = g_list_sort(files, koops_duphash_cache_file_cmp);
+        for (GList *l = files; l && count > koops_duphash_cache_max_entries; l = l->next, --count)
+        {
+            const struct koops_duphash_cache_file *file = l->data;
+            log_debug("Evicting cached duphash '%s'", file->name);
+            if (unlinkat(dirfd(dp), file->name, 0) != 0 && errno != ENOENT)
+                log_debug("Can't delete '%s': %s", file->name, strerror(errno));
+        }
+    }
+
+    g_list_free_full(files, koops_duphash_cache_file_free);
+    closedir(dp);
+}
+
+static char *koops_duphash_cache_load(const char *key)
+{
+    char *value = g_hash_table_lookup(s_koops_duphash_cache, key);
+    if (value || !koops_duphash_cache_dir)
+        return value;
+
+    char *path = concat_path_file(koops_duphash_cache_dir, key);
+    value = xmalloc_open_read_close(path, /*maxsize:*/ NULL);
+    free(path);
+
+    if (value && value[0] != '\0' && strlen(value) != SHA1_RESULT_LEN*2)
+    {
+        /* Truncated or otherwise broken */
+        free(value);
+        return NULL;
+    }
+
+    if (value)
+        koops_duphash_cache_remember(key, value);
+
+    return value;
+}
+
+static void koops_duphash_cache_save(const char *key, const char *value)
+{
+    koops_duphash_cache_remember(key, xstrdup(value));
+
+    if (!koops_duphash_cache_dir)
+        return;
+
+    if (mkdir(koops_duphash_cache_dir, 0755) != 0 && errno != EEXIST)
+    {
+        log_debug("Can't create '%s': %s", koops_duphash_cache_dir, strerror(errno));
+        return;
+    }
+
+    /* Write a temporary file and rename it to avoid readers seeing
+     * partially written values */
+    char *path = concat_path_file(koops_duphash_cache_dir, key);
+    char *tmp_path = xasprintf("%s.%u", path, (unsigned)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0644);
+    if (fd < 0)
+        log_debug("Can't create '%s': %s", tmp_path, strerror(errno));
+    else
+    {
+        const size_t len = strlen(value);
+        const bool written = full_write(fd, value, len) == (ssize_t)len;
+        close(fd);
+        if (!written || rename(tmp_path, path) != 0)
+        {
+            log_debug("Can't save '%s'", path);
+            unlink(tmp_path);
+        }
+        else
+            koops_duphash_cache_trim_dir();
+    }
+    free(tmp_path);
+    free(path);
+}
+
+int koops_hash_str_ext(char result[SHA1_RESULT_LEN*2 + 1], const char *oops_buf, int frame_count, int duphash_flags)
+{
+    if (!s_koops_duphash_cache)
+        s_koops_duphash_cache = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+
+    char *normalized = koops_normalize(oops_buf);
+    char *key_str = xasprintf("%d %d\n%s", frame_count, duphash_flags, normalized);
+    free(normalized);
+    char key[SHA1_RESULT_LEN*2 + 1];
+    str_to_sha1str(key, key_str);
+    free(key_str);
+
+    const char *cached = koops_duphash_cache_load(key);
+    if (cached)
+    {
+        log_debug("Using cached duphash '%s'", cached);
+        strcpy(result, cached);
+        return cached[0] == '\0';
+    }
+
+    const int bad = koops_hash_str_parse(result, oops_buf, frame_count, duphash_flags);
+    koops_duphash_cache_save(key, bad ? "" : result);
+
+    return bad;
+}
+
 int koops_hash_str(char result[SHA1_RESULT_LEN*2 + 1], const char *oops_buf)
 {
     const int frame_count = 6;
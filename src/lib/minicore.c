@@ -0,0 +1,571 @@
+/*
+    Copyright (C) 2016  ABRT team
+    Copyright (C) 2016  RedHat Inc
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <elf.h>
+#include <link.h>
+#include <sys/procfs.h>
+#include <sys/user.h>
+#include "internal_libabrt.h"
+
+/* Index of the stack pointer in elf_gregset_t.
+ * If we do not know it, every register is considered to be a stack pointer.
+ */
+#if defined(__x86_64__)
+# define MINICORE_SP_REG (offsetof(struct user_regs_struct, rsp) / sizeof(elf_greg_t))
+#elif defined(__i386__)
+# define MINICORE_SP_REG (offsetof(struct user_regs_struct, esp) / sizeof(elf_greg_t))
+#elif defined(__aarch64__)
+# define MINICORE_SP_REG (offsetof(struct user_regs_struct, sp) / sizeof(elf_greg_t))
+#elif defined(__powerpc__)
+# define MINICORE_SP_REG 1 /* gpr[1] */
+#elif defined(__s390x__)
+# define MINICORE_SP_REG 17 /* psw.mask, psw.addr, gprs[15] */
+#endif
+
+#define MINICORE_BUFFER_SIZE (64 * 1024)
+
+/* Notes are held in memory while being parsed; a bigger PT_NOTE makes
+ * us to store the full core.
+ */
+#define MINICORE_MAX_NOTES_SIZE (64 * 1024 * 1024)
+
+struct minicore_range
+{
+    off_t start;
+    off_t end;
+};
+
+struct minicore
+{
+    int src_fd;
+    int dst_fd;
+    int user_fd;
+    off_t user_left;
+
+    /* Offset of the next byte read from src_fd */
+    off_t pos;
+    /* Size of the core according to its program headers */
+    off_t core_end;
+    /* Number of bytes written to dst_fd */
+    off_t stored;
+
+    /* Do not drop anything, the core is not an ELF core we understand */
+    bool keep_all;
+
+    ElfW(Phdr) *phdrs;
+    unsigned phnum;
+
+    /* File ranges to be stored; sorted and not overlapping after
+     * minicore_normalize_ranges()
+     */
+    GArray *ranges;
+    /* Addresses of the files mapped from their beginning (NT_FILE) and of
+     * the vDSO (NT_AUXV) */
+    GArray *file_starts;
+    bool have_file_note;
+    /* Offsets of the non-empty PT_LOAD segments which may begin with
+     * an ELF header; sorted
+     */
+    GArray *load_starts;
+
+    char *buffer;
+};
+
+static bool is_zero(const char *buf, size_t len)
+{
+    while (len != 0)
+        if (buf[--len] != 0)
+            return false;
+    return true;
+}
+
+/* Writes len bytes of buf to dst_fd (if keep is true) and to user_fd.
+ * All-zero blocks and dropped blocks are seeked over, i.e. they become holes
+ * in the sparse file.
+ */
+static int minicore_write(struct minicore *mc, const char *buf, size_t len, bool keep)
+{
+    const bool zero = is_zero(buf, len);
+
+    if (keep && !zero)
+    {
+        if (full_write(mc->dst_fd, buf, len) != len)
+        {
+            perror_msg("Write error");
+            return -1;
+        }
+        mc->stored += len;
+    }
+    else if (lseek(mc->dst_fd, len, SEEK_CUR) < 0)
+    {
+        perror_msg("Seek error");
+        return -1;
+    }
+
+    if (mc->user_fd >= 0)
+    {
+        if (!zero && full_write(mc->user_fd, buf, len) != len)
+        {
+            perror_msg("Write error");
+            return -1;
+        }
+        else if (zero && lseek(mc->user_fd, len, SEEK_CUR) < 0)
+        {
+            perror_msg("Seek error");
+            return -1;
+        }
+
+        mc->user_left -= len;
+        if (mc->user_left < 0)
+            mc->user_fd = -1;
+    }
+
+    mc->pos += len;
+    return 0;
+}
+
+/* Reads exactly len bytes from the core (less only at EOF) */
+static ssize_t minicore_read(struct minicore *mc, void *buf, size_t len)
+{
+    ssize_t rd = full_read(mc->src_fd, buf, len);
+    if (rd < 0)
+        perror_msg("Read error");
+    return rd;
+}
+
+static void minicore_add_range(struct minicore *mc, off_t start, off_t end)
+{
+    if (start >= end)
+        return;
+
+    struct minicore_range r = { .start = start, .end = end };
+    g_array_append_val(mc->ranges, r);
+}
+
+/* Adds the file range holding memory [lo, hi) */
+static void minicore_add_vaddr_range(struct minicore *mc, uintptr_t lo, uintptr_t hi)
+{
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (hi < lo) /* overflow */
+        hi = UINTPTR_MAX;
+    lo &= ~(uintptr_t)(page_size - 1);
+
+    for (unsigned i = 0; i < mc->phnum; ++i)
+    {
+        const ElfW(Phdr) *ph = &mc->phdrs[i];
+        if (ph->p_type != PT_LOAD || ph->p_filesz == 0)
+            continue;
+
+        const uintptr_t seg_lo = ph->p_vaddr;
+        const uintptr_t seg_hi = ph->p_vaddr + ph->p_filesz;
+        if (hi <= seg_lo || lo >= seg_hi)
+            continue;
+
+        const uintptr_t from = MAX(lo, seg_lo);
+        const uintptr_t to = MIN(hi, seg_hi);
+        minicore_add_range(mc, ph->p_offset + (from - seg_lo), ph->p_offset + (to - seg_lo));
+    }
+}
+
+static void minicore_add_registers(struct minicore *mc, const elf_greg_t *regs)
+{
+    for (unsigned i = 0; i < ELF_NGREG; ++i)
+    {
+        const uintptr_t value = regs[i];
+        if (value == 0)
+            continue;
+
+#ifdef MINICORE_SP_REG
+        if (i != MINICORE_SP_REG)
+        {
+            minicore_add_vaddr_range(mc,
+                    value > MINICORE_POINTER_WINDOW ? value - MINICORE_POINTER_WINDOW : 0,
+                    value + MINICORE_POINTER_WINDOW);
+            continue;
+        }
+#endif
+        /* The stack grows down, the frames of the callers are above SP */
+        minicore_add_vaddr_range(mc,
+                value > MINICORE_STACK_RED_ZONE ? value - MINICORE_STACK_RED_ZONE : 0,
+                value + MINICORE_STACK_SIZE);
+    }
+}
+
+/* NT_FILE: count, page size, count * (start, end, file offset in pages),
+ * count * file name
+ */
+static void minicore_parse_file_note(struct minicore *mc, const char *desc, size_t size)
+{
+    long header[2];
+    if (size < sizeof(header))
+        return;
+    memcpy(header, desc, sizeof(header));
+
+    const size_t count = header[0];
+    if (count > (size - sizeof(header)) / (3 * sizeof(long)))
+    {
+        log_notice("Truncated NT_FILE note in the core");
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        long entry[3];
+        memcpy(entry, desc + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        if (entry[2] == 0)
+        {
+            uintptr_t start = entry[0];
+            g_array_append_val(mc->file_starts, start);
+        }
+    }
+    mc->have_file_note = true;
+}
+
+/* The vDSO is an ELF image too, but it is not a mapped file */
+static void minicore_parse_auxv_note(struct minicore *mc, const char *desc, size_t size)
+{
+    for (size_t pos = 0; pos + sizeof(ElfW(auxv_t)) <= size; pos += sizeof(ElfW(auxv_t)))
+    {
+        ElfW(auxv_t) auxv;
+        memcpy(&auxv, desc + pos, sizeof(auxv));
+        if (auxv.a_type == AT_SYSINFO_EHDR)
+        {
+            uintptr_t start = auxv.a_un.a_val;
+            g_array_append_val(mc->file_starts, start);
+        }
+    }
+}
+
+/* Finds NT_PRSTATUS notes (one per thread) and adds the memory pointed to
+ * by their registers. NT_FILE tells which segments may hold an ELF header.
+ */
+static void minicore_parse_notes(struct minicore *mc, const char *notes, size_t size)
+{
+    unsigned threads = 0;
+    size_t pos = 0;
+    while (pos + sizeof(ElfW(Nhdr)) <= size)
+    {
+        ElfW(Nhdr) nhdr;
+        memcpy(&nhdr, notes + pos, sizeof(nhdr));
+        pos += sizeof(nhdr);
+
+        const size_t name_size = (nhdr.n_namesz + 3) & ~3;
+        const size_t desc_size = (nhdr.n_descsz + 3) & ~3;
+        if (name_size > size - pos || desc_size > size - pos - name_size)
+        {
+            log_notice("Truncated note in the core");
+            break;
+        }
+
+        const char *desc = notes + pos + name_size;
+        if (nhdr.n_type == NT_PRSTATUS && nhdr.n_descsz >= sizeof(struct elf_prstatus))
+        {
+            struct elf_prstatus prstatus;
+            memcpy(&prstatus, desc, sizeof(prstatus));
+            minicore_add_registers(mc, prstatus.pr_reg);
+            ++threads;
+        }
+        else if (nhdr.n_type == NT_FILE)
+            minicore_parse_file_note(mc, desc, nhdr.n_descsz);
+        else if (nhdr.n_type == NT_AUXV)
+            minicore_parse_auxv_note(mc, desc, nhdr.n_descsz);
+
+        pos += name_size + desc_size;
+    }
+
+    log_info("Found registers of %u thread(s) in the core", threads);
+}
+
+static gint minicore_range_cmp(gconstpointer a, gconstpointer b)
+{
+    const off_t l = ((const struct minicore_range *)a)->start;
+    const off_t r = ((const struct minicore_range *)b)->start;
+    return (l > r) - (l < r);
+}
+
+static gint minicore_off_cmp(gconstpointer a, gconstpointer b)
+{
+    const off_t l = *(const off_t *)a;
+    const off_t r = *(const off_t *)b;
+    return (l > r) - (l < r);
+}
+
+static void minicore_normalize_ranges(struct minicore *mc)
+{
+    g_array_sort(mc->ranges, minicore_range_cmp);
+
+    unsigned last = 0;
+    for (unsigned i = 1; i < mc->ranges->len; ++i)
+    {
+        struct minicore_range *l = &g_array_index(mc->ranges, struct minicore_range, last);
+        struct minicore_range *r = &g_array_index(mc->ranges, struct minicore_range, i);
+        if (r->start <= l->end)
+            l->end = MAX(l->end, r->end);
+        else
+            g_array_index(mc->ranges, struct minicore_range, ++last) = *r;
+    }
+
+    if (mc->ranges->len != 0)
+        g_array_set_size(mc->ranges, last + 1);
+}
+
+static bool minicore_maps_file_start(struct minicore *mc, uintptr_t vaddr)
+{
+    for (unsigned i = 0; i < mc->file_starts->len; ++i)
+        if (g_array_index(mc->file_starts, uintptr_t, i) == vaddr)
+            return true;
+    return false;
+}
+
+/* Only a segment mapping a file from its beginning can start with an ELF
+ * header. Without NT_FILE (kernels older than 3.7) every segment is checked,
+ * and the copying can't stop before the last one.
+ */
+static void minicore_find_elf_headers(struct minicore *mc)
+{
+    for (unsigned i = 0; i < mc->phnum; ++i)
+    {
+        const ElfW(Phdr) *ph = &mc->phdrs[i];
+        if (ph->p_type != PT_LOAD || ph->p_filesz == 0)
+            continue;
+
+        if (mc->have_file_note && !minicore_maps_file_start(mc, ph->p_vaddr))
+            continue;
+
+        off_t start = ph->p_offset;
+        g_array_append_val(mc->load_starts, start);
+    }
+    g_array_sort(mc->load_starts, minicore_off_cmp);
+}
+
+/* Reads ELF and program headers and all notes. On return, either keep_all
+ * is set, or ranges contain everything we want to store.
+ */
+static int minicore_read_headers(struct minicore *mc)
+{
+    ElfW(Ehdr) ehdr;
+    ssize_t rd = minicore_read(mc, &ehdr, sizeof(ehdr));
+    if (rd < 0)
+        return -1;
+
+    if (rd != sizeof(ehdr)
+     || memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+     || ehdr.e_ident[EI_CLASS] != (__ELF_NATIVE_CLASS == 64 ? ELFCLASS64 : ELFCLASS32)
+     || ehdr.e_type != ET_CORE
+     || ehdr.e_phoff != sizeof(ehdr)
+     || ehdr.e_phentsize != sizeof(ElfW(Phdr))
+     || ehdr.e_phnum == 0
+     || ehdr.e_phnum == PN_XNUM)
+    {
+        log_notice("Not a native ELF core, the whole core will be stored");
+        mc->keep_all = true;
+        return minicore_write(mc, (char *)&ehdr, rd, true);
+    }
+
+    if (minicore_write(mc, (char *)&ehdr, rd, true) < 0)
+        return -1;
+
+    mc->phnum = ehdr.e_phnum;
+    mc->phdrs = xmalloc(mc->phnum * sizeof(mc->phdrs[0]));
+    const size_t phdrs_size = mc->phnum * sizeof(mc->phdrs[0]);
+    rd = minicore_read(mc, mc->phdrs, phdrs_size);
+    if (rd < 0)
+        return -1;
+
+    if (rd != phdrs_size)
+    {
+        log_notice("Truncated program headers, the whole core will be stored");
+        mc->keep_all = true;
+        return minicore_write(mc, (char *)mc->phdrs, rd, true);
+    }
+
+    if (minicore_write(mc, (char *)mc->phdrs, rd, true) < 0)
+        return -1;
+
+    /* The kernel writes notes right after the program headers and memory
+     * after the notes. We must see the notes before the memory arrives.
+     */
+    off_t notes_end = mc->pos;
+    off_t first_load = -1;
+    for (unsigned i = 0; i < mc->phnum; ++i)
+    {
+        const ElfW(Phdr) *ph = &mc->phdrs[i];
+        if (ph->p_type == PT_NOTE)
+            notes_end = MAX(notes_end, (off_t)(ph->p_offset + ph->p_filesz));
+        else if (ph->p_type == PT_LOAD && ph->p_filesz != 0)
+        {
+            if (first_load < 0 || (off_t)ph->p_offset < first_load)
+                first_load = ph->p_offset;
+        }
+
+        mc->core_end = MAX(mc->core_end, (off_t)(ph->p_offset + ph->p_filesz));
+    }
+
+    if ((first_load >= 0 && notes_end > first_load)
+     || notes_end - mc->pos > MINICORE_MAX_NOTES_SIZE)
+    {
+        log_notice("Unexpected layout of notes, the whole core will be stored");
+        mc->keep_all = true;
+        return 0;
+    }
+
+    const size_t notes_size = notes_end - mc->pos;
+    char *notes = xmalloc(notes_size);
+    rd = minicore_read(mc, notes, notes_size);
+    if (rd < 0 || minicore_write(mc, notes, rd, true) < 0)
+    {
+        free(notes);
+        return -1;
+    }
+
+    /* Notes are addressed by file offsets of the PT_NOTE segments */
+    const off_t notes_start = notes_end - notes_size;
+    for (unsigned i = 0; i < mc->phnum; ++i)
+    {
+        const ElfW(Phdr) *ph = &mc->phdrs[i];
+        if (ph->p_type != PT_NOTE
+         || (off_t)ph->p_offset < notes_start
+         || (off_t)(ph->p_offset + ph->p_filesz) > notes_start + rd)
+            continue;
+
+        minicore_parse_notes(mc, notes + (ph->p_offset - notes_start), ph->p_filesz);
+    }
+    free(notes);
+
+    minicore_normalize_ranges(mc);
+    minicore_find_elf_headers(mc);
+    return 0;
+}
+
+/* Copies the memory part of the core, storing only the selected ranges and
+ * the first page of every segment starting with an ELF header (we need
+ * them to find build-ids of the mapped binaries).
+ */
+static int minicore_copy_memory(struct minicore *mc)
+{
+    const long page_size = sysconf(_SC_PAGESIZE);
+    unsigned next_range = 0;
+    unsigned next_load = 0;
+    off_t elf_page_end = 0;
+
+    while (1)
+    {
+        while (next_range < mc->ranges->len
+                && g_array_index(mc->ranges, struct minicore_range, next_range).end <= mc->pos)
+            ++next_range;
+
+        bool segment_start = false;
+        while (next_load < mc->load_starts->len
+                && g_array_index(mc->load_starts, off_t, next_load) <= mc->pos)
+        {
+            segment_start |= g_array_index(mc->load_starts, off_t, next_load) == mc->pos;
+            ++next_load;
+        }
+
+        /* Nobody needs the rest of the stream. Do not make the kernel
+         * write it.
+         */
+        if (!mc->keep_all && mc->user_fd < 0
+         && next_range >= mc->ranges->len && next_load >= mc->load_starts->len
+         && mc->pos >= elf_page_end && !segment_start)
+            break;
+
+        bool keep = mc->keep_all || mc->pos < elf_page_end;
+        off_t boundary = mc->pos + MINICORE_BUFFER_SIZE;
+        if (next_range < mc->ranges->len)
+        {
+            const struct minicore_range *r = &g_array_index(mc->ranges, struct minicore_range, next_range);
+            if (r->start <= mc->pos)
+            {
+                keep = true;
+                boundary = MIN(boundary, r->end);
+            }
+            else
+                boundary = MIN(boundary, r->start);
+        }
+        if (next_load < mc->load_starts->len)
+            boundary = MIN(boundary, g_array_index(mc->load_starts, off_t, next_load));
+        if (mc->pos < elf_page_end)
+            boundary = MIN(boundary, elf_page_end);
+        /* Only the first page is inspected, the rest may not be needed */
+        if (segment_start)
+            boundary = MIN(boundary, mc->pos + page_size);
+
+        ssize_t rd = minicore_read(mc, mc->buffer, boundary - mc->pos);
+        if (rd < 0)
+            return -1;
+        if (rd == 0)
+            break;
+
+        if (!keep && segment_start && rd >= SELFMAG
+         && memcmp(mc->buffer, ELFMAG, SELFMAG) == 0)
+        {
+            elf_page_end = mc->pos + page_size;
+            if (minicore_write(mc, mc->buffer, rd, true) < 0)
+                return -1;
+            continue;
+        }
+
+        if (minicore_write(mc, mc->buffer, rd, keep) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+off_t copyfd_minicore(int src_fd, int dst_fd, int user_fd, off_t user_limit)
+{
+    struct minicore mc = {
+        .src_fd = src_fd,
+        .dst_fd = dst_fd,
+        .user_fd = user_fd,
+        .user_left = user_limit,
+        .ranges = g_array_new(FALSE, FALSE, sizeof(struct minicore_range)),
+        .file_starts = g_array_new(FALSE, FALSE, sizeof(uintptr_t)),
+        .load_starts = g_array_new(FALSE, FALSE, sizeof(off_t)),
+        .buffer = xmalloc(MINICORE_BUFFER_SIZE),
+    };
+
+    off_t total = -1;
+    if (minicore_read_headers(&mc) < 0 || minicore_copy_memory(&mc) < 0)
+        goto out;
+
+    /* Trailing holes are not created by seeking, the files must be
+     * extended explicitly. The abrt core has always the full size, even if
+     * we stopped reading early.
+     */
+    total = MAX(mc.pos, mc.core_end);
+    if (ftruncate(dst_fd, total) != 0
+     || (mc.user_fd >= 0 && ftruncate(mc.user_fd, mc.pos) != 0))
+    {
+        perror_msg("Write error");
+        total = -1;
+        goto out;
+    }
+
+    log_notice("Stored %llu of %llu bytes of the core",
+            (long long)(mc.keep_all ? total : mc.stored), (long long)total);
+
+ out:
+    free(mc.buffer);
+    free(mc.phdrs);
+    g_array_free(mc.load_starts, TRUE);
+    g_array_free(mc.file_starts, TRUE);
+    g_array_free(mc.ranges, TRUE);
+    return total;
+}
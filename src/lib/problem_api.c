@@ -21,6 +21,64 @@
 #include <sys/time.h>
 #include "problem_api.h"
 
+/* The user and group database functions used by the access checks
+ * (getpwuid(), getgrnam(), ...) return static buffers, therefore they must
+ * not run concurrently from the thread pool workers.
+ */
+static GMutex s_nss_lock;
+
+void problem_api_lock_nss(void)
+{
+    g_mutex_lock(&s_nss_lock);
+}
+
+void problem_api_unlock_nss(void)
+{
+    /* The callers check errno set by the guarded call */
+    const int sv_errno = errno;
+    g_mutex_unlock(&s_nss_lock);
+    errno = sv_errno;
+}
+
+/*
+ * Opens the problem directory for reading if it is accessible by caller_uid.
+ * Returns NULL if the directory can't be opened or isn't accessible.
+ *
+ * Silently ignores *any* errors of opening, not only EACCES. We saw
+ * "lock file is locked by process PID" error when we raced with wizard.
+ * The errors are suppressed by the dd_opendir() flags and not by lowering
+ * the global logmode because the function runs from several threads at once.
+ */
+static struct dump_dir *open_problem_dir_for_uid(const char *full_name, uid_t caller_uid)
+{
+    struct dump_dir *dd = dd_opendir(full_name,   DD_OPEN_FD_ONLY
+                                                | DD_FAIL_QUIETLY_ENOENT
+                                                | DD_FAIL_QUIETLY_EACCES);
+    if (dd == NULL)
+    {
+        VERB2 perror_msg("can't open problem directory '%s'", full_name);
+        return NULL;
+    }
+
+    if (caller_uid != -1)
+    {
+        g_mutex_lock(&s_nss_lock);
+        const bool accessible = dd_accessible_by_uid(dd, caller_uid);
+        g_mutex_unlock(&s_nss_lock);
+
+        if (!accessible)
+        {
+            dd_close(dd);
+            return NULL;
+        }
+    }
+
+    return dd_fdopendir(dd,   DD_OPEN_READONLY
+                            | DD_DONT_WAIT_FOR_LOCK
+                            | DD_FAIL_QUIETLY_ENOENT
+                            | DD_FAIL_QUIETLY_EACCES);
+}
+
 /*
  * Goes through all problems and for problems accessible by caller_uid
  * calls callback. If callback returns non-0, returns that value.
@@ -46,33 +104,13 @@ int for_each_problem_in_dir(const char *path,
             continue; /* skip "." and ".." */
 
         char *full_name = concat_path_file(path, dent->d_name);
-
-        struct dump_dir *dd = dd_opendir(full_name,   DD_OPEN_FD_ONLY
-                                                    | DD_FAIL_QUIETLY_ENOENT
-                                                    | DD_FAIL_QUIETLY_EACCES);
-        if (dd == NULL)
-        {
-            VERB2 perror_msg("can't open problem directory '%s'", full_name);
-            continue;
-        }
-
-        if (caller_uid == -1 || dd_accessible_by_uid(dd, caller_uid))
-        {
-            /* Silently ignore *any* errors, not only EACCES.
-             * We saw "lock file is locked by process PID" error
-             * when we raced with wizard.
-             */
-            int sv_logmode = logmode;
-            /* Silently ignore errors only in the silent log level. */
-            logmode = g_verbose == 0 ? 0: sv_logmode;
-            dd = dd_fdopendir(dd, DD_OPEN_READONLY | DD_DONT_WAIT_FOR_LOCK);
-            logmode = sv_logmode;
-            if (dd)
-                brk = callback ? callback(dd, arg) : 0;
-        }
+        struct dump_dir *dd = open_problem_dir_for_uid(full_name, caller_uid);
 
         if (dd)
+        {
+            brk = callback ? callback(dd, arg) : 0;
             dd_close(dd);
+        }
 
         free(full_name);
         if (brk)
@@ -83,11 +121,102 @@ int for_each_problem_in_dir(const char *path,
     return brk;
 }
 
+/* for_each_problem_in_dir_parallel and its helpers */
+
+struct parallel_scan
+{
+    uid_t caller_uid;
+    for_each_problem_in_dir_callback callback;
+    void *arg;
+    /* The first non-zero value returned from the callback.
+     * Accessed atomically, workers stop opening directories once it is set.
+     */
+    volatile gint brk;
+};
+
+static void parallel_scan_worker(gpointer data, gpointer user_data)
+{
+    char *full_name = data;
+    struct parallel_scan *scan = user_data;
+
+    if (g_atomic_int_get(&scan->brk) == 0)
+    {
+        struct dump_dir *dd = open_problem_dir_for_uid(full_name, scan->caller_uid);
+        if (dd)
+        {
+            int r = scan->callback ? scan->callback(dd, scan->arg) : 0;
+            if (r)
+                g_atomic_int_compare_and_exchange(&scan->brk, 0, r);
+
+            dd_close(dd);
+        }
+    }
+
+    free(full_name);
+}
+
+int for_each_problem_in_dir_parallel(const char *path,
+                        uid_t caller_uid,
+                        for_each_problem_in_dir_callback callback,
+                        void *arg,
+                        unsigned max_threads)
+{
+    if (max_threads == 0)
+        max_threads = MIN(g_get_num_processors() * 2, PROBLEM_DIR_SCAN_MAX_THREADS);
+
+    if (max_threads <= 1)
+        return for_each_problem_in_dir(path, caller_uid, callback, arg);
+
+    DIR *dp = opendir(path);
+    if (!dp)
+        return 0;
+
+    struct parallel_scan scan = {
+        .caller_uid = caller_uid,
+        .callback = callback,
+        .arg = arg,
+        .brk = 0,
+    };
+
+    GError *error = NULL;
+    GThreadPool *pool = g_thread_pool_new(parallel_scan_worker, &scan,
+                                          max_threads, /*exclusive*/FALSE, &error);
+    if (pool == NULL)
+    {
+        error_msg("Can't create a thread pool, falling back to serial scan: %s", error->message);
+        g_error_free(error);
+        closedir(dp);
+        return for_each_problem_in_dir(path, caller_uid, callback, arg);
+    }
+
+    struct dirent *dent;
+    while ((dent = readdir(dp)) != NULL && g_atomic_int_get(&scan.brk) == 0)
+    {
+        if (dot_or_dotdot(dent->d_name))
+            continue; /* skip "." and ".." */
+
+        g_thread_pool_push(pool, concat_path_file(path, dent->d_name), NULL);
+    }
+    closedir(dp);
+
+    /* Wait for all queued directories */
+    g_thread_pool_free(pool, /*immediate*/FALSE, /*wait*/TRUE);
+
+    return scan.brk;
+}
+
 /* get_problem_dirs_for_uid and its helpers */
 
+/* Protects the lists built by the callbacks run from thread pool workers */
+static GMutex s_problem_list_lock;
+
 static int add_dirname_to_GList(struct dump_dir *dd, void *arg)
 {
-    if (!dir_has_correct_permissions(dd->dd_dirname, DD_PERM_DAEMONS))
+    g_mutex_lock(&s_nss_lock);
+    const bool correct_permissions = dir_has_correct_permissions(dd->dd_dirname, DD_PERM_DAEMONS);
+    g_mutex_unlock(&s_nss_lock);
+
+    if (!correct_permissions)
     {
         log("Ignoring '%s': invalid owner, group or mode", dd->dd_dirname);
         /*Do not break*/
@@ -95,19 +224,19 @@ static int add_dirname_to_GList(struct dump_dir *dd, void *arg)
     }
 
     GList **list = arg;
-    *list = g_list_prepend(*list, xstrdup(dd->dd_dirname));
+    char *dirname = xstrdup(dd->dd_dirname);
+    g_mutex_lock(&s_problem_list_lock);
+    *list = g_list_prepend(*list, dirname);
+    g_mutex_unlock(&s_problem_list_lock);
     return 0;
 }
 
 GList *get_problem_dirs_for_uid(uid_t uid, const char *dump_location)
 {
     GList *list = NULL;
-    for_each_problem_in_dir(dump_location, uid, add_dirname_to_GList, &list);
-    /*
-     * Why reverse?
-     * Because N*prepend+reverse is faster than N*append
-     */
-    return g_list_reverse(list);
+    /* The directories come in an undefined order */
+    for_each_problem_in_dir_parallel(dump_location, uid, add_dirname_to_GList, &list, /*default*/0);
+    return list;
 }
 
 /* get_problem_dirs_not_accessible_by_uid and its helpers */
@@ -120,9 +249,18 @@ struct add_dirname_to_GList_if_not_accessible_args
 static int add_dirname_to_GList_if_not_accessible(struct dump_dir *dd, void *args)
 {
     struct add_dirname_to_GList_if_not_accessible_args *param = (struct add_dirname_to_GList_if_not_accessible_args *)args;
+    g_mutex_lock(&s_nss_lock);
+    const bool accessible = dump_dir_accessible_by_uid(dd->dd_dirname, param->uid);
+    g_mutex_unlock(&s_nss_lock);
+
     /* Append if not accessible */
-    if (!dump_dir_accessible_by_uid(dd->dd_dirname, param->uid))
-        param->list = g_list_prepend(param->list, xstrdup(dd->dd_dirname));
+    if (!accessible)
+    {
+        char *dirname = xstrdup(dd->dd_dirname);
+        g_mutex_lock(&s_problem_list_lock);
+        param->list = g_list_prepend(param->list, dirname);
+        g_mutex_unlock(&s_problem_list_lock);
+    }
 
     return 0;
 }
@@ -134,8 +272,9 @@ GList *get_problem_dirs_not_accessible_by_uid(uid_t uid, const char *dump_locati
         .list = NULL,
     };
 
-    for_each_problem_in_dir(dump_location, /*disable default uid check*/-1, add_dirname_to_GList_if_not_accessible, &args);
-    return g_list_reverse(args.list);
+    for_each_problem_in_dir_parallel(dump_location, /*disable default uid check*/-1,
+            add_dirname_to_GList_if_not_accessible, &args, /*default*/0);
+    return args.list;
 }
 
 
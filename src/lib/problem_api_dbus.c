@@ -145,6 +145,66 @@ int fill_problem_data_over_dbus(const char *problem_id, const char **elements, p
     return 0;
 }
 
+GHashTable *get_problems_data_over_dbus(GList *problem_ids, const char **elements)
+{
+    INITIALIZE_LIBABRT();
+
+    GDBusProxy *proxy = get_dbus_proxy();
+    if (!proxy)
+        return ERR_PTR;
+
+    GVariantBuilder *problems_builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
+    for (GList *iter = problem_ids; iter; iter = g_list_next(iter))
+        g_variant_builder_add(problems_builder, "s", (const char *)iter->data);
+
+    GVariantBuilder *elements_builder = g_variant_builder_new(G_VARIANT_TYPE("as"));
+    for (const char **iter = elements; *iter; ++iter)
+        g_variant_builder_add(elements_builder, "s", *iter);
+
+    GVariant *params = g_variant_new("(asas)", problems_builder, elements_builder);
+    g_variant_builder_unref(elements_builder);
+    g_variant_builder_unref(problems_builder);
+
+    GError *error = NULL;
+    GVariant *result = g_dbus_proxy_call_sync(proxy,
+                                            "GetInfoForProblems",
+                                            params,
+                                            G_DBUS_CALL_FLAGS_NONE,
+                                            -1,
+                                            NULL,
+                                            &error);
+
+    if (error)
+    {
+        error_msg(_("D-Bus GetInfoForProblems method call failed: %s"), error->message);
+        g_error_free(error);
+        return ERR_PTR;
+    }
+
+    GHashTable *problems = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 free, (GDestroyNotify)problem_data_free);
+
+    const char *problem_id;
+    GVariantIter *problem_iter;
+    GVariantIter *iter;
+    g_variant_get(result, "(a{sa{ss}})", &iter);
+    while (g_variant_iter_loop(iter, "{&sa{ss}}", &problem_id, &problem_iter))
+    {
+        problem_data_t *pd = problem_data_new();
+
+        char *key, *val;
+        while (g_variant_iter_loop(problem_iter, "{ss}", &key, &val))
+            problem_data_add_text_noteditable(pd, key, val);
+
+        g_hash_table_replace(problems, xstrdup(problem_id), pd);
+    }
+    g_variant_iter_free(iter);
+
+    g_variant_unref(result);
+
+    return problems;
+}
+
 problem_data_t *get_problem_data_dbus(const char *problem_dir_path)
 {
     INITIALIZE_LIBABRT();
@@ -19,41 +19,149 @@
 #include "libabrt.h"
 
 #include <glib.h>
+#include <inttypes.h>
+#include <elfutils/libdwfl.h>
 
 #include <satyr/thread.h>
 #include <satyr/core/stacktrace.h>
 #include <satyr/core/thread.h>
 #include <satyr/core/frame.h>
 
-static void trim_unstrip_output(char *result, const char *unstrip_n_output)
+/* The same callbacks eu-unstrip uses for --core */
+static char *debuginfo_path;
+static const Dwfl_Callbacks core_callbacks = {
+    .find_elf = dwfl_build_id_find_elf,
+    .find_debuginfo = dwfl_standard_find_debuginfo,
+    .section_address = dwfl_offline_section_address,
+    .debuginfo_path = &debuginfo_path,
+};
+
+/* UUIDs used to be computed from eu-unstrip -n output whose lines look
+ * like this:
+ * 0x400000+0x209000 23c77451cf6adff77fc1f5ee2a01d75de6511dda@0x40024c - - [exe]
+ * 0x400000+0x209000 ab3c8286aac6c043fd1bb1cc2a0b88ec29517d3e@0x40024c /bin/sleep /usr/lib/debug/bin/sleep.debug [exe]
+ * 0x7fff313ff000+0x1000 389c7475e3d5401c55953a425a2042ef62c4c7df@0x7fff313ff2f8 . - linux-vdso.so.1
+ *                ^^^^^^ ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+ * Only the marked part was kept (everything after the '+' up to the '@',
+ * without white space). To keep the UUIDs of already existing problems,
+ * this function appends exactly that part of the line of mod.
+ */
+static int append_module_build_id(Dwfl_Module *mod, void **userdata,
+        const char *name, Dwarf_Addr start, void *arg)
 {
-    // lines look like this:
-    // 0x400000+0x209000 23c77451cf6adff77fc1f5ee2a01d75de6511dda@0x40024c - - [exe]
-    // 0x400000+0x209000 ab3c8286aac6c043fd1bb1cc2a0b88ec29517d3e@0x40024c /bin/sleep /usr/lib/debug/bin/sleep.debug [exe]
-    // 0x7fff313ff000+0x1000 389c7475e3d5401c55953a425a2042ef62c4c7df@0x7fff313ff2f8 . - linux-vdso.so.1
-    //                ^^^^^^ ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-    // we drop everything except the marked part ^
-
-    char *dst = result;
-    const char *line = unstrip_n_output;
-    while (*line)
+    struct strbuf *buf = arg;
+
+    /* The build id of a module is usually found in the core's memory
+     * while the modules are reported. Looking for the module's ELF file is
+     * expensive and needed only if the build id isn't known or the
+     * unstrip line lacks the '@' separator.
+     */
+    const unsigned char *id;
+    GElf_Addr id_vaddr;
+    int id_len = dwfl_module_build_id(mod, &id, &id_vaddr);
+
+    Dwarf_Addr end;
+    if (id_len > 0 && id_vaddr != 0)
     {
-        const char *eol = strchrnul(line, '\n');
-        const char *plus = (char*)memchr(line, '+', eol - line);
-        if (plus)
-        {
-            while (++plus < eol && *plus != '@')
-            {
-                if (!isspace(*plus))
-                {
-                    *dst++ = *plus;
-                }
-            }
-        }
-        if (*eol != '\n') break;
-        line = eol + 1;
+        dwfl_module_info(mod, NULL, NULL, &end, NULL, NULL, NULL, NULL);
+        strbuf_append_strf(buf, "%#"PRIx64, (uint64_t)(end - start));
+        while (id_len-- > 0)
+            strbuf_append_strf(buf, "%02x", *id++);
+
+        return DWARF_CB_OK;
+    }
+
+    /* Mirror list_module() from elfutils/src/unstrip.c */
+    Dwarf_Addr bias;
+    bool have_elf = dwfl_module_getelf(mod, &bias) != NULL;
+    /* The debug file name is known only after the search */
+    bool have_dwarf = dwfl_module_getdwarf(mod, &bias) != NULL;
+
+    const char *file;
+    const char *debug;
+    dwfl_module_info(mod, NULL, NULL, &end, NULL, NULL, &file, &debug);
+    if (file != NULL && debug != NULL && (debug == file || strcmp(debug, file) == 0))
+        debug = ".";
+
+    id_len = dwfl_module_build_id(mod, &id, &id_vaddr);
+
+    strbuf_append_strf(buf, "%#"PRIx64, (uint64_t)(end - start));
+    if (id_len > 0)
+    {
+        while (id_len-- > 0)
+            strbuf_append_strf(buf, "%02x", *id++);
+
+        if (id_vaddr != 0)
+            return DWARF_CB_OK;
     }
-    *dst = '\0';
+    else
+        strbuf_append_char(buf, '-');
+
+    char *rest = xasprintf("%s%s%s",
+            file ? file : have_elf ? "." : "-",
+            debug ? debug : have_dwarf ? "." : "-",
+            name);
+    /* The line is cut at the first '@' */
+    rest[strcspn(rest, "@")] = '\0';
+    for (const char *c = rest; *c; ++c)
+        if (!isspace(*c))
+            strbuf_append_char(buf, *c);
+    free(rest);
+
+    return DWARF_CB_OK;
+}
+
+/* Returns the concatenation of the trimmed eu-unstrip -n lines of all modules
+ * or NULL if the core can't be read. The modules are reported directly
+ * from the core's program headers and notes which are read through mmap,
+ * hence only the pages holding them are loaded.
+ */
+static char *build_ids_from_coredump(const char *coredump_path)
+{
+    int fd = open(coredump_path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror_msg("Can't open '%s'", coredump_path);
+        return NULL;
+    }
+
+    char *result = NULL;
+    Dwfl *dwfl = NULL;
+
+    elf_version(EV_CURRENT);
+    Elf *core = elf_begin(fd, ELF_C_READ_MMAP, NULL);
+    if (core == NULL)
+    {
+        log_notice("Can't read '%s': %s", coredump_path, elf_errmsg(-1));
+        goto ret;
+    }
+
+    dwfl = dwfl_begin(&core_callbacks);
+    if (dwfl == NULL)
+    {
+        log_notice("Can't initialize libdwfl: %s", dwfl_errmsg(-1));
+        goto ret;
+    }
+
+    if (dwfl_core_file_report(dwfl, core, /*executable:*/ NULL) < 0
+        || dwfl_report_end(dwfl, NULL, NULL) != 0)
+    {
+        log_notice("Can't report modules of '%s': %s", coredump_path, dwfl_errmsg(-1));
+        goto ret;
+    }
+
+    struct strbuf *buf = strbuf_new();
+    dwfl_getmodules(dwfl, append_module_build_id, buf, 0);
+    result = strbuf_free_nobuf(buf);
+
+ ret:
+    if (dwfl)
+        dwfl_end(dwfl);
+    if (core)
+        elf_end(core);
+    close(fd);
+
+    return result;
 }
 
 static char *build_ids_from_core_backtrace(const char *dump_dir_name)
@@ -148,19 +256,16 @@ int main(int argc, char **argv)
     char *unstrip_n_output = NULL;
     char *coredump_path = xasprintf("%s/"FILENAME_COREDUMP, dump_dir_name);
     if (access(coredump_path, R_OK) == 0)
-        unstrip_n_output = run_unstrip_n(dump_dir_name, /*timeout_sec:*/ 30);
+    {
+        /* Sizes and build ids of the modules, without running unstrip -n */
+        unstrip_n_output = build_ids_from_coredump(coredump_path);
+    }
 
     free(coredump_path);
 
-    if (unstrip_n_output)
-    {
-        /* Run unstrip -n and trim its output, leaving only sizes and build ids */
-        /* modifies unstrip_n_output in-place: */
-        trim_unstrip_output(unstrip_n_output, unstrip_n_output);
-    }
-    else
+    if (!unstrip_n_output)
     {
-        /* bad dump_dir_name, can't run unstrip, etc...
+        /* bad dump_dir_name, can't read the coredump, etc...
          * or maybe missing coredump - try generating it from core_backtrace
          */
 
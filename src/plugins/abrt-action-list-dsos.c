@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2010  ABRT team
+    Copyright (C) 2010  RedHat Inc
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <rpm/rpmts.h>
+#include <rpm/rpmdb.h>
+#include <rpm/rpmlib.h>
+#include <rpm/rpmmacro.h>
+#include "libabrt.h"
+
+/* Returns the list of unique file paths found in maps_path, in the order of
+ * their first occurrence.
+ *
+ * We want to handle both /proc/PID/maps format:
+ *  4f200000-4f215000 r-xp 00000000 08:03 1835520   /usr/lib64/libz.so.1.2.7
+ * and Xorg backtrace format:
+ *  [ 86985.880] 9: /usr/lib64/libdrm.so.2 (drmHandleEvent+0xa3) [0x376b407513]
+ * To do that, we take only lines which have a / character, then for each line
+ * we start at first /, then remove everything after first whitespace.
+ *
+ * A maps file lists every library several times (one line per mapped
+ * segment), so the paths are uniquified before we touch the rpm database.
+ */
+static GList *parse_maps(const char *maps_path)
+{
+    FILE *fp = fopen(maps_path, "r");
+    if (!fp)
+        perror_msg_and_die("Can't open '%s'", maps_path);
+
+    GList *paths = NULL;
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+    char *line;
+    while ((line = xmalloc_fgetline(fp)) != NULL)
+    {
+        char *path = strchr(line, '/');
+        if (path)
+        {
+            path[strcspn(path, " \t\n\r\v\f")] = '\0';
+            if (!g_hash_table_contains(seen, path))
+            {
+                path = xstrdup(path);
+                g_hash_table_add(seen, path);
+                paths = g_list_prepend(paths, path);
+            }
+        }
+        free(line);
+    }
+
+    if (ferror(fp))
+        perror_msg_and_die("Can't read '%s'", maps_path);
+
+    fclose(fp);
+    g_hash_table_destroy(seen);
+
+    return g_list_reverse(paths);
+}
+
+/* Returns "NEVRA (VENDOR) INSTALLTIME" of the package described by header */
+static char *format_package(Header header)
+{
+    char *nevra = headerGetAsString(header, RPMTAG_NEVRA);
+    const char *vendor = headerGetString(header, RPMTAG_VENDOR);
+    uint64_t installtime = headerGetNumber(header, RPMTAG_INSTALLTIME);
+
+    char *desc = xasprintf("%s (%s) %llu",
+            nevra ? nevra : "",
+            vendor ? vendor : "None",
+            (unsigned long long)installtime);
+    free(nevra);
+
+    return desc;
+}
+
+int main(int argc, char **argv)
+{
+    /* I18n */
+    setlocale(LC_ALL, "");
+#if ENABLE_NLS
+    bindtextdomain(PACKAGE, LOCALEDIR);
+    textdomain(PACKAGE);
+#endif
+
+    abrt_init(argv);
+
+    const char *output_file = NULL;
+    const char *maps_file = NULL;
+
+    /* Can't keep these strings/structs static: _() doesn't support that */
+    const char *program_usage_string = _(
+        "& [-v] [-o OUTFILE] -m PROC_PID_MAP_FILE\n"
+        "\n"
+        "Prints out DSOs from mapped memory regions together with the packages\n"
+        "they belong to"
+    );
+    enum {
+        OPT_v = 1 << 0,
+        OPT_o = 1 << 1,
+        OPT_m = 1 << 2,
+    };
+    /* Keep enum above and order of options below in sync! */
+    struct options program_options[] = {
+        OPT__VERBOSE(&g_verbose),
+        OPT_STRING('o', NULL, &output_file, "OUTFILE", _("Output file (default: stdout)")),
+        OPT_STRING('m', NULL, &maps_file, "PROC_PID_MAP_FILE", _("File containing the mapped memory regions")),
+        OPT_END()
+    };
+    unsigned opts = parse_opts(argc, argv, program_options, program_usage_string);
+
+    if (!(opts & OPT_m))
+    {
+        error_msg("MAP_FILE is not specified");
+        show_usage_and_die(program_usage_string, program_options);
+    }
+
+    GList *paths = parse_maps(maps_file);
+    log_info("Found %u unique mapped files", g_list_length(paths));
+
+    if (rpmReadConfigFiles(NULL, NULL) != 0)
+        error_msg_and_die("Can't get the DSO list: can't read RPM rc files");
+
+    /* One transaction set for all queries: creating a new one per path
+     * re-opens the rpm database every time, which used to dominate the
+     * run time of this tool.
+     */
+    rpmts ts = rpmtsCreate();
+    GHashTable *packages = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, free);
+
+    /* Note that we open -o FILE only when we reach the point
+     * when we are definitely going to write something to it
+     */
+    FILE *outfile = output_file ? NULL : stdout;
+    const char *outname = output_file ? output_file : "<stdout>";
+
+    for (GList *iter = paths; iter; iter = g_list_next(iter))
+    {
+        const char *path = iter->data;
+
+        rpmdbMatchIterator mi = rpmtsInitIterator(ts, RPMTAG_BASENAMES, path, 0);
+        Header header;
+        while ((header = rpmdbNextIterator(mi)) != NULL)
+        {
+            /* Libraries mapped by a process tend to come from a handful of
+             * packages, so format every package header only once.
+             */
+            unsigned recno = rpmdbGetIteratorOffset(mi);
+            char *desc = g_hash_table_lookup(packages, GUINT_TO_POINTER(recno));
+            if (!desc)
+            {
+                desc = format_package(header);
+                g_hash_table_insert(packages, GUINT_TO_POINTER(recno), desc);
+            }
+
+            if (!outfile)
+            {
+                outfile = fopen(output_file, "w");
+                if (!outfile)
+                    perror_msg_and_die("Can't open '%s'", output_file);
+            }
+
+            fprintf(outfile, "%s %s\n", path, desc);
+        }
+        rpmdbFreeIterator(mi);
+    }
+
+    rpmtsFree(ts);
+    g_hash_table_destroy(packages);
+    list_free_with_free(paths);
+
+    /* See rpm_destroy() in src/daemon/rpm.c */
+    rpmFreeMacros(NULL);
+    rpmFreeRpmrc();
+    rpmdbCheckTerminate(1);
+
+    if (outfile && (ferror(outfile) | fclose(outfile)) != 0)
+        error_msg_and_die("Error writing to '%s'", outname);
+
+    return 0;
+}
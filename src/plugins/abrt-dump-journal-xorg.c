@@ -19,105 +19,134 @@
 #define XORG_CONF "xorg.conf"
 #define XORG_CONF_PATH "/etc/abrt/plugins/"XORG_CONF
 
-static void
-abrt_xorg_process_list_of_crashes(GList *crashes, const char *dump_location, int flags)
+struct xorg_journal_settings
 {
-    if (crashes == NULL)
-        return;
+    const char *dump_location;
+    int xorg_utils_flags;
+    unsigned crash_count;
+    struct xorg_crash_extractor *extractor;
+    /* The cursor of the "Backtrace:" message of the pending backtrace */
+    char *bt_cursor;
+};
+
+static void abrt_xorg_process_crash(struct xorg_crash_info *crash_info, void *data)
+{
+    struct xorg_journal_settings *conf = (struct xorg_journal_settings *)data;
 
-    GList *list;
-    for (list = crashes; list != NULL; list = list->next)
+    if (crash_info == NULL)
     {
-        xorg_crash_info_create_dump_dir(list->data, dump_location, (flags & ABRT_XORG_WORLD_READABLE));
+        log_warning(_("Failed to parse Backtrace from journal"));
+        return;
+    }
 
-        if (flags & ABRT_XORG_PRINT_STDOUT)
-            xorg_crash_info_print_crash(list->data);
+    ++conf->crash_count;
+    xorg_crash_info_create_dump_dir(crash_info, conf->dump_location, (conf->xorg_utils_flags & ABRT_XORG_WORLD_READABLE));
 
-        if (flags & ABRT_XORG_THROTTLE_CREATION)
-            if (abrt_xorg_signaled_sleep(1) > 0)
-                break;
-    }
+    if (conf->xorg_utils_flags & ABRT_XORG_PRINT_STDOUT)
+        xorg_crash_info_print_crash(crash_info);
 
-    return;
+    xorg_crash_info_free(crash_info);
+
+    if (conf->xorg_utils_flags & ABRT_XORG_THROTTLE_CREATION)
+        abrt_xorg_signaled_sleep(1);
 }
 
-static GList *abrt_journal_extract_xorg_crashes(abrt_journal_t *journal)
+/* Feeds the messages from the current one to the end of journal to the
+ * extractor. A backtrace whose end has not been logged yet stays pending in
+ * the extractor.
+ */
+static void abrt_journal_extract_xorg_crashes(abrt_journal_t *journal, struct xorg_journal_settings *conf)
 {
-    GList *crash_info_list = NULL;
-
     do
     {
         char *line = abrt_journal_get_log_line(journal);
         if (line == NULL)
             error_msg_and_die(_("Cannot read journal data."));
 
-        char *p = skip_pfx(line);
-        if (strcmp(p, XORG_SEARCH_STRING) == 0)
+        const bool searching = !xorg_crash_extractor_in_backtrace(conf->extractor);
+        xorg_crash_extractor_feed_line(conf->extractor, line, abrt_xorg_process_crash, conf);
+        free(line);
+
+        if (searching && xorg_crash_extractor_in_backtrace(conf->extractor))
         {
-            struct xorg_crash_info *crash_info = process_xorg_bt(&abrt_journal_get_next_log_line, journal);
-            if (crash_info)
-                crash_info_list = g_list_append(crash_info_list, crash_info);
-            else
-                log_warning(_("Failed to parse Backtrace from journal"));
+            free(conf->bt_cursor);
+            conf->bt_cursor = NULL;
+            abrt_journal_get_cursor(journal, &conf->bt_cursor);
         }
-        free(line);
     }
-    while (abrt_journal_next(journal) > 0);
-
-    log("Found crashes: %d", g_list_length(crash_info_list));
-
-    return crash_info_list;
+    /* Stop on signal received while throttling */
+    while (g_abrt_xorg_sleep_woke_up_on_signal <= 0 && abrt_journal_next(journal) > 0);
 }
 
-struct watch_journald_xorg_settings
+/* Saves the position of the pending backtrace's "Backtrace:" message to let
+ * the next run read the whole backtrace, or the current position.
+ */
+static void abrt_journal_save_xorg_position(abrt_journal_t *journal, struct xorg_journal_settings *conf)
 {
-    const char *dump_location;
-    int xorg_utils_flags;
-};
+    if (xorg_crash_extractor_in_backtrace(conf->extractor) && conf->bt_cursor)
+        abrt_journal_save_cursor(conf->bt_cursor, ABRT_JOURNAL_XORG_WATCH_STATE_FILE);
+    else
+        abrt_journal_save_current_position(journal, ABRT_JOURNAL_XORG_WATCH_STATE_FILE);
+}
 
 static void abrt_journal_watch_extract_xorg_crashes(abrt_journal_watch_t *watch, void *data)
 {
-    const struct watch_journald_xorg_settings *conf = (const struct watch_journald_xorg_settings *)data;
+    struct xorg_journal_settings *conf = (struct xorg_journal_settings *)data;
 
     abrt_journal_t *journal = abrt_journal_watch_get_journal(watch);
 
     /* Give systemd-journal one second to suck in all crash strings */
-    if (abrt_xorg_signaled_sleep(1) > 0)
+    if (!xorg_crash_extractor_in_backtrace(conf->extractor) && abrt_xorg_signaled_sleep(1) > 0)
     {
         abrt_journal_watch_stop(watch);
         return;
     }
 
-    GList *crashes = abrt_journal_extract_xorg_crashes(journal);
-    abrt_xorg_process_list_of_crashes(crashes, conf->dump_location, conf->xorg_utils_flags);
-    g_list_free_full(crashes, (GDestroyNotify)xorg_crash_info_free);
+    abrt_journal_extract_xorg_crashes(journal, conf);
 
     /* In case of disaster, lets make sure we won't read the journal messages */
     /* again. */
-    abrt_journal_save_current_position(journal, ABRT_JOURNAL_XORG_WATCH_STATE_FILE);
+    abrt_journal_save_xorg_position(journal, conf);
 
     if (g_abrt_xorg_sleep_woke_up_on_signal > 0)
         abrt_journal_watch_stop(watch);
 }
 
-static void watch_journald(abrt_journal_t *journal, const char *dump_location, int flags)
+struct watch_journald_xorg_filter
+{
+    struct xorg_journal_settings *conf;
+    struct abrt_journal_watch_notify_strings *notify_strings;
+};
+
+/* Messages following "Backtrace:" are passed to the extractor directly */
+static void abrt_journal_watch_filter_xorg_messages(abrt_journal_watch_t *watch, void *data)
+{
+    struct watch_journald_xorg_filter *filter = (struct watch_journald_xorg_filter *)data;
+
+    if (xorg_crash_extractor_in_backtrace(filter->conf->extractor))
+        abrt_journal_watch_extract_xorg_crashes(watch, filter->conf);
+    else
+        abrt_journal_watch_notify_strings(watch, filter->notify_strings);
+}
+
+static void watch_journald(abrt_journal_t *journal, struct xorg_journal_settings *conf)
 {
     GList *xorg_strings = NULL;
     xorg_strings = g_list_prepend(xorg_strings, (gpointer)XORG_SEARCH_STRING);
 
-    struct watch_journald_xorg_settings watch_conf = {
-        .dump_location = dump_location,
-        .xorg_utils_flags = flags,
-    };
-
     struct abrt_journal_watch_notify_strings notify_strings_conf = {
         .decorated_cb = abrt_journal_watch_extract_xorg_crashes,
-        .decorated_cb_data = &watch_conf,
+        .decorated_cb_data = conf,
         .strings = xorg_strings,
     };
 
+    struct watch_journald_xorg_filter filter = {
+        .conf = conf,
+        .notify_strings = &notify_strings_conf,
+    };
+
     abrt_journal_watch_t *watch = NULL;
-    if (abrt_journal_watch_new(&watch, journal, abrt_journal_watch_notify_strings, &notify_strings_conf) < 0)
+    if (abrt_journal_watch_new(&watch, journal, abrt_journal_watch_filter_xorg_messages, &filter) < 0)
         error_msg_and_die(_("Failed to initialize systemd-journal watch"));
 
     abrt_journal_watch_run_sync(watch);
@@ -290,6 +319,12 @@ int main(int argc, char *argv[])
     if ((opts & OPT_e) && abrt_journal_seek_tail(journal) < 0)
         error_msg_and_die(_("Cannot seek to the end of journal"));
 
+    struct xorg_journal_settings conf = {
+        .dump_location = dump_location,
+        .xorg_utils_flags = xorg_utils_flags,
+        .extractor = xorg_crash_extractor_new(),
+    };
+
     if ((opts & OPT_f))
     {
         if (!cursor)
@@ -297,9 +332,9 @@ int main(int argc, char *argv[])
         else if(abrt_journal_set_cursor(journal, cursor))
             error_msg_and_die(_("Failed to start watch from cursor '%s'"), cursor);
 
-        watch_journald(journal, dump_location, xorg_utils_flags);
+        watch_journald(journal, &conf);
 
-        abrt_journal_save_current_position(journal, ABRT_JOURNAL_XORG_WATCH_STATE_FILE);
+        abrt_journal_save_xorg_position(journal, &conf);
     }
     else
     {
@@ -310,11 +345,15 @@ int main(int argc, char *argv[])
          * to a next message.*/
         abrt_journal_next(journal);
 
-        GList *crashes = abrt_journal_extract_xorg_crashes(journal);
-        abrt_xorg_process_list_of_crashes(crashes, dump_location, xorg_utils_flags);
-        g_list_free_full(crashes, (GDestroyNotify)xorg_crash_info_free);
+        abrt_journal_extract_xorg_crashes(journal, &conf);
+        xorg_crash_extractor_finish(conf.extractor, abrt_xorg_process_crash, &conf);
+
+        log("Found crashes: %u", conf.crash_count);
     }
 
+    xorg_crash_extractor_free(conf.extractor);
+    free(conf.bt_cursor);
+
     abrt_journal_free(journal);
 
     return EXIT_SUCCESS;
@@ -19,6 +19,99 @@
 #include "libabrt.h"
 #include "xorg-utils.h"
 
+#define READ_CHUNK_SIZE (64 * 1024)
+
+enum {
+    OPT_v = 1 << 0,
+    OPT_s = 1 << 1,
+    OPT_o = 1 << 2,
+    OPT_d = 1 << 3,
+    OPT_D = 1 << 4,
+    OPT_x = 1 << 5,
+    OPT_m = 1 << 6,
+    OPT_P = 1 << 7,
+};
+
+/* The position is saved as "DEVICE INODE OFFSET" */
+static off_t load_position(const char *state_file, const struct stat *log_st)
+{
+    size_t maxsize = 128;
+    char *state = xmalloc_open_read_close(state_file, &maxsize);
+    if (!state)
+        return 0;
+
+    unsigned long long dev, ino, offset;
+    if (sscanf(state, "%llu %llu %llu", &dev, &ino, &offset) != 3)
+    {
+        error_msg(_("Ignoring malformed position in '%s'"), state_file);
+        offset = 0;
+    }
+    /* A rotated or truncated log is read from the beginning */
+    else if (dev != (unsigned long long)log_st->st_dev
+          || ino != (unsigned long long)log_st->st_ino
+          || offset > (unsigned long long)log_st->st_size)
+    {
+        log_notice("'%s' doesn't describe the log file, reading it from the beginning", state_file);
+        offset = 0;
+    }
+    free(state);
+
+    return offset;
+}
+
+static void save_position(const char *state_file, const struct stat *log_st, off_t offset)
+{
+    char *state = xasprintf("%llu %llu %llu\n",
+            (unsigned long long)log_st->st_dev,
+            (unsigned long long)log_st->st_ino,
+            (unsigned long long)offset);
+
+    char *tmp = xasprintf("%s.new", state_file);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    if (fd < 0 || full_write_str(fd, state) < 0 || close(fd) != 0)
+        perror_msg(_("Can't save the position to '%s'"), tmp);
+    else if (rename(tmp, state_file) != 0)
+        perror_msg(_("Can't rename '%s' to '%s'"), tmp, state_file);
+
+    free(tmp);
+    free(state);
+}
+
+struct dump_xorg_settings
+{
+    unsigned opts;
+    const char *dump_location;
+    int bt_count;
+    /* Position persistence, state_file is NULL if disabled */
+    const char *state_file;
+    struct stat log_st;
+    off_t start;
+    struct xorg_crash_extractor *extractor;
+};
+
+static void process_crash(struct xorg_crash_info *crash_info, void *data)
+{
+    struct dump_xorg_settings *conf = data;
+
+    if (!crash_info)
+    {
+        log_warning(_("Failed to parse Backtrace from log file"));
+        return;
+    }
+
+    if (conf->opts & OPT_o)
+        xorg_crash_info_print_crash(crash_info);
+    if (conf->opts & (OPT_d|OPT_D))
+        if (conf->bt_count++ <= ABRT_OOPS_MAX_DUMPED_COUNT)
+            xorg_crash_info_create_dump_dir(crash_info, conf->dump_location, (conf->opts & OPT_x));
+    xorg_crash_info_free(crash_info);
+
+    /* Don't report the crash again if we get killed before reaching the end */
+    if (conf->state_file)
+        save_position(conf->state_file, &conf->log_st,
+                conf->start + xorg_crash_extractor_resume_offset(conf->extractor));
+}
+
 int main(int argc, char **argv)
 {
     /* I18n */
@@ -32,20 +125,15 @@ int main(int argc, char **argv)
 
     /* Can't keep these strings/structs static: _() doesn't support that */
     const char *program_usage_string = _(
-        "& [-vsoxm] [-d DIR]/[-D] [FILE]\n"
+        "& [-vsoxm] [-d DIR]/[-D] [-P STATE_FILE FILE | FILE]\n"
+        "\n"
+        "Extract Xorg crash from FILE (or standard input)\n"
         "\n"
-        "Extract Xorg crash from FILE (or standard input)"
+        "With -P, reading of FILE resumes at the position saved in STATE_FILE\n"
+        "and the position reached is saved there"
     );
-    enum {
-        OPT_v = 1 << 0,
-        OPT_s = 1 << 1,
-        OPT_o = 1 << 2,
-        OPT_d = 1 << 3,
-        OPT_D = 1 << 4,
-        OPT_x = 1 << 5,
-        OPT_m = 1 << 6,
-    };
     char *dump_location = NULL;
+    const char *state_file = NULL;
     /* Keep OPT_z enums and order of options below in sync! */
     struct options program_options[] = {
         OPT__VERBOSE(&g_verbose),
@@ -55,6 +143,7 @@ int main(int argc, char **argv)
         OPT_BOOL(  'D', NULL, NULL, _("Same as -d DumpLocation, DumpLocation is specified in abrt.conf")),
         OPT_BOOL(  'x', NULL, NULL, _("Make the problem directory world readable")),
         OPT_BOOL(  'm', NULL, NULL, _("Print search string(s) to stdout and exit")),
+        OPT_STRING('P', NULL, &state_file, "STATE_FILE", _("Resume reading FILE at the position saved in STATE_FILE")),
         OPT_END()
     };
     unsigned opts = parse_opts(argc, argv, program_options, program_usage_string);
@@ -84,31 +173,55 @@ int main(int argc, char **argv)
     }
 
     argv += optind;
+    if ((opts & OPT_P) && !argv[0])
+        show_usage_and_die(program_usage_string, program_options);
+
+    struct dump_xorg_settings conf = {
+        .opts = opts,
+        .dump_location = dump_location,
+        .state_file = state_file,
+        .extractor = xorg_crash_extractor_new(),
+    };
+
     if (argv[0])
+    {
         xmove_fd(xopen(argv[0], O_RDONLY), STDIN_FILENO);
 
-    int bt_count = 0;
-    char *line = NULL;
-    while ((line = xmalloc_fgetline(stdin)) != NULL)
-    {
-        char *p = skip_pfx(line);
-        if (strcmp(p, "Backtrace:") == 0)
+        if (state_file)
         {
-            struct xorg_crash_info *crash_info = process_xorg_bt(&xorg_get_next_line_from_fd, stdin);
-            if (crash_info)
-            {
-                if (opts & OPT_o)
-                    xorg_crash_info_print_crash(crash_info);
-                if (opts & (OPT_d|OPT_D))
-                    if (bt_count++ <= ABRT_OOPS_MAX_DUMPED_COUNT)
-                        xorg_crash_info_create_dump_dir(crash_info, dump_location, (opts & OPT_x));
-                xorg_crash_info_free(crash_info);
-            }
-            else
-                log_warning(_("Failed to parse Backtrace from log file"));
+            if (fstat(STDIN_FILENO, &conf.log_st) != 0)
+                perror_msg_and_die("Can't stat '%s'", argv[0]);
+
+            conf.start = load_position(state_file, &conf.log_st);
+            if (conf.start > 0 && lseek(STDIN_FILENO, conf.start, SEEK_SET) < 0)
+                perror_msg_and_die("Can't seek in '%s'", argv[0]);
+
+            log_info("Reading '%s' from offset %llu", argv[0], (unsigned long long)conf.start);
         }
-        free(line);
     }
 
+    /* The log is fed to the extractor in chunks, so only the lines of one
+     * backtrace are kept in memory regardless of the log size
+     */
+    char *buf = xmalloc(READ_CHUNK_SIZE);
+    ssize_t len;
+    while ((len = safe_read(STDIN_FILENO, buf, READ_CHUNK_SIZE)) > 0)
+        xorg_crash_extractor_feed(conf.extractor, buf, len, process_crash, &conf);
+
+    if (len < 0)
+        perror_msg_and_die("Can't read '%s'", argv[0] ? argv[0] : "<stdin>");
+
+    /* Xorg may still be writing the backtrace at the end of the log, the
+     * next run re-reads it from the saved position
+     */
+    if (state_file)
+        save_position(state_file, &conf.log_st,
+                conf.start + xorg_crash_extractor_resume_offset(conf.extractor));
+    else
+        xorg_crash_extractor_finish(conf.extractor, process_crash, &conf);
+
+    xorg_crash_extractor_free(conf.extractor);
+    free(buf);
+
     return 0;
 }
@@ -275,6 +275,13 @@ int abrt_journal_save_current_position(abrt_journal_t *journal, const char *file
         return r;
     }
 
+    const int ret = abrt_journal_save_cursor(crsr, file_name);
+    free(crsr);
+    return ret;
+}
+
+int abrt_journal_save_cursor(const char *cursor, const char *file_name)
+{
     int state_fd = open(file_name,
             O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW,
             ABRT_JOURNAL_WATCH_STATE_FILE_MODE);
@@ -285,10 +292,9 @@ int abrt_journal_save_current_position(abrt_journal_t *journal, const char *file
         return -1;
     }
 
-    full_write_str(state_fd, crsr);
+    full_write_str(state_fd, cursor);
     close(state_fd);
 
-    free(crsr);
     return 0;
 }
 
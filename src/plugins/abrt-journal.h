@@ -81,6 +81,11 @@ int abrt_journal_next(abrt_journal_t *journal);
 int abrt_journal_save_current_position(abrt_journal_t *journal,
                                        const char *file_name);
 
+/* Saves the given cursor in the same format as
+ * abrt_journal_save_current_position() */
+int abrt_journal_save_cursor(const char *cursor,
+                             const char *file_name);
+
 int abrt_journal_restore_position(abrt_journal_t *journal,
                                   const char *file_name);
 
@@ -523,7 +523,7 @@ static int create(bool delete_temp_archive,
                             size, max_size);
     }
 
-    if (settings->supported_formats)
+    if (settings->supported_formats[0])
     {
         int i;
         bool supported = false;
@@ -556,8 +556,9 @@ static int create(bool delete_temp_archive,
         map_string_t *osinfo = new_map_string();
         problem_data_get_osinfo(pd, osinfo);
 
-        /* not needed for TASK_VMCORE - the information is kept in the vmcore itself */
-        if (settings->supported_releases)
+        /* not needed for TASK_VMCORE - the information is kept in the vmcore itself;
+         * abrt-retrace-local lists no releases, it retraces its own one only */
+        if (settings->supported_releases[0])
         {
             char *releaseid = get_release_id(osinfo, arch);
             if (!releaseid)
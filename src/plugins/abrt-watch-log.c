@@ -17,12 +17,62 @@
     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <sys/inotify.h>
+#include <glib-unix.h>
 #include "libabrt.h"
+#include "oops-utils.h"
+#include "xorg-utils.h"
 
 #define MAX_SCAN_BLOCK  (4*1024*1024)
 #define READ_AHEAD          (10*1024)
 
+/* Even if log file grows all the time, say, a new line every 5 ms,
+ * we don't want to scan it all the time. A change is scanned once the file
+ * has not been modified for DEBOUNCE_MS (so that we do not analyze a partial
+ * oops), but not later than MAX_DELAY_MS after the first change.
+ */
+#define DEBOUNCE_MS         50
+#define MAX_DELAY_MS      1000
+
+/* How often we try to open files which don't exist and whose directory
+ * can't be watched.
+ */
+#define RETRY_OPEN_SEC      59
+
+#define ABRT_DUMP_OOPS_ANALYZER "abrt-oops"
+
+enum scanner_type
+{
+    SCANNER_PROG,
+    SCANNER_OOPS,
+    SCANNER_XORG,
+};
+
+struct watched_file
+{
+    char *filename;
+    char *basename;
+    int fd;
+    /* Watch of the file */
+    int wd;
+    /* Watch of the directory, notifies us about creation of the file */
+    int dir_wd;
+    guint debounce_id;
+    gint64 first_change_us;
+    /* No scans until the timer fires, see throttle_scans() */
+    guint throttle_id;
+    /* The built-in Xorg scanner follows the file as one stream, a backtrace
+     * may span several scans */
+    struct xorg_crash_extractor *xorg_extractor;
+};
+
 static unsigned page_size;
+static int inotify_fd = -1;
+static GList *watched_files;
+
+static enum scanner_type scanner_type = SCANNER_PROG;
+static char **scanner_prog;
+static GList *match_list;
+static char *dump_location;
 
 static bool memstr(void *buf, unsigned size, const char *str)
 {
@@ -44,9 +94,173 @@ static bool memstr(void *buf, unsigned size, const char *str)
     return false;
 }
 
-static void run_scanner_prog(int fd, struct stat *statbuf, GList *match_list, char **prog)
+static void run_scanner_prog(int fd, off_t cur_pos, off_t size)
+{
+    fflush(NULL); /* paranoia */
+    pid_t pid = vfork();
+    if (pid < 0)
+        perror_msg_and_die("vfork");
+    if (pid == 0)
+    {
+        xmove_fd(fd, STDIN_FILENO);
+        log_debug("Execing '%s'", scanner_prog[0]);
+        execvp(scanner_prog[0], scanner_prog);
+        perror_msg_and_die("Can't execute '%s'", scanner_prog[0]);
+    }
+
+    safe_waitpid(pid, NULL, 0);
+
+    /* Check fd's position, and move to end if it wasn't advanced.
+     * This means that child failed to read its stdin.
+     * This is not supposed to happen, so warn about it.
+     */
+    if (lseek(fd, 0, SEEK_CUR) <= cur_pos)
+    {
+        log("Warning, '%s' did not process its input", scanner_prog[0]);
+        lseek(fd, size, SEEK_SET);
+    }
+}
+
+static void process_xorg_crash(struct xorg_crash_info *crash_info, void *data)
+{
+    int *bt_count = data;
+
+    if (crash_info)
+    {
+        if ((*bt_count)++ < ABRT_OOPS_MAX_DUMPED_COUNT)
+            xorg_crash_info_create_dump_dir(crash_info, dump_location, /*world readable*/true);
+        xorg_crash_info_free(crash_info);
+    }
+    else
+        log_warning(_("Failed to parse Backtrace from log file"));
+}
+
+static void scan_xorg_buffer(struct watched_file *wf, const char *buffer, size_t length)
+{
+    if (!wf->xorg_extractor)
+        wf->xorg_extractor = xorg_crash_extractor_new();
+
+    int bt_count = 0;
+    xorg_crash_extractor_feed(wf->xorg_extractor, buffer, length, process_xorg_crash, &bt_count);
+}
+
+/* The end of the stream: the file was closed, skipped or we are exiting */
+static void finish_xorg_scan(struct watched_file *wf)
+{
+    if (!wf->xorg_extractor)
+        return;
+
+    int bt_count = 0;
+    xorg_crash_extractor_finish(wf->xorg_extractor, process_xorg_crash, &bt_count);
+    xorg_crash_extractor_free(wf->xorg_extractor);
+    wf->xorg_extractor = NULL;
+}
+
+static void scan_file(struct watched_file *wf);
+
+static gboolean throttle_cb(gpointer user_data)
+{
+    struct watched_file *wf = user_data;
+    wf->throttle_id = 0;
+
+    log_debug("Scanning '%s' after the pause", wf->filename);
+    scan_file(wf);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* 'abrt-dump-oops -t' sleeps a second after every new problem directory and
+ * quadratically longer if there were more oopses than it saved, and the log
+ * watcher waited for it. Sleeping here would block all the watched files and
+ * the signals, hence only the next scan of this file is deferred for as long.
+ * The repeats of known oopses are counted too.
+ */
+static void throttle_scans(struct watched_file *wf, unsigned oops_cnt)
+{
+    if (oops_cnt == 0)
+        return;
+
+    unsigned pause = MIN(oops_cnt, ABRT_OOPS_MAX_DUMPED_COUNT);
+    if (oops_cnt > ABRT_OOPS_MAX_DUMPED_COUNT)
+    {
+        /* Quadratic throttle time growth, but careful to not overflow in "n*n" */
+        const unsigned n = MIN(oops_cnt - ABRT_OOPS_MAX_DUMPED_COUNT, 30);
+        pause += n * n;
+    }
+
+    if (pause > 9)
+        log(_("Pausing the scanning of '%s' for %u seconds"), wf->filename, pause);
+    wf->throttle_id = g_timeout_add_seconds(pause, throttle_cb, wf);
+}
+
+/* Does the same as 'abrt-dump-oops -xtD' or 'abrt-dump-xorg -xD' would do
+ * with the new part of the file, without fork and exec.
+ */
+static void run_builtin_scanner(struct watched_file *wf, off_t cur_pos, off_t size)
+{
+    const int fd = wf->fd;
+    size_t length = size - cur_pos;
+    if (length > MAX_SCAN_BLOCK)
+    {
+        cur_pos = size - MAX_SCAN_BLOCK;
+        length = MAX_SCAN_BLOCK;
+        lseek(fd, cur_pos, SEEK_SET);
+        /* The skipped data can't be joined with the pending one */
+        finish_xorg_scan(wf);
+    }
+
+    char *buffer = xmalloc(length + 1);
+    ssize_t r = full_read(fd, buffer, length);
+    if (r <= 0)
+    {
+        if (r < 0)
+            perror_msg("Read error");
+        lseek(fd, size, SEEK_SET);
+        free(buffer);
+        return;
+    }
+
+    /* The last line might not be complete yet. Leave it for the next run. */
+    char *eol = memrchr(buffer, '\n', r);
+    if (!eol)
+    {
+        /* A line filling the whole block would stall the scanning forever */
+        if (r == MAX_SCAN_BLOCK)
+        {
+            log_warning("Skipping a line longer than %d bytes", MAX_SCAN_BLOCK);
+            lseek(fd, cur_pos + r, SEEK_SET);
+            finish_xorg_scan(wf);
+        }
+        else
+            lseek(fd, cur_pos, SEEK_SET);
+        free(buffer);
+        return;
+    }
+    const size_t used = eol + 1 - buffer;
+    lseek(fd, cur_pos + used, SEEK_SET);
+    buffer[used] = '\0';
+
+    log_debug("Scanning %llu bytes", (long long)used);
+
+    if (scanner_type == SCANNER_OOPS)
+    {
+        GList *oops_list = NULL;
+        koops_extract_oopses(&oops_list, buffer, used);
+        abrt_oops_process_list(oops_list, dump_location, ABRT_DUMP_OOPS_ANALYZER,
+                               ABRT_OOPS_WORLD_READABLE);
+        throttle_scans(wf, g_list_length(oops_list));
+        list_free_with_free(oops_list);
+    }
+    else
+        scan_xorg_buffer(wf, buffer, used);
+
+    free(buffer);
+}
+
+static void run_scanner(struct watched_file *wf, struct stat *statbuf)
 {
     /* fstat(fd, &statbuf) was just done by caller */
+    const int fd = wf->fd;
 
     off_t cur_pos = lseek(fd, 0, SEEK_CUR);
     if (statbuf->st_size <= cur_pos)
@@ -64,7 +278,10 @@ static void run_scanner_prog(int fd, struct stat *statbuf, GList *match_list, ch
         (long long)(cur_pos),
         (long long)(statbuf->st_size));
 
-    if (match_list && (statbuf->st_size - cur_pos) < MAX_SCAN_BLOCK)
+    /* The rest of a pending backtrace doesn't contain the strings */
+    const bool in_backtrace = wf->xorg_extractor
+                              && xorg_crash_extractor_in_backtrace(wf->xorg_extractor);
+    if (match_list && !in_backtrace && (statbuf->st_size - cur_pos) < MAX_SCAN_BLOCK)
     {
         size_t length = statbuf->st_size - cur_pos;
 
@@ -97,29 +314,192 @@ static void run_scanner_prog(int fd, struct stat *statbuf, GList *match_list, ch
         }
     }
 
-    fflush(NULL); /* paranoia */
-    pid_t pid = vfork();
-    if (pid < 0)
-        perror_msg_and_die("vfork");
-    if (pid == 0)
+    if (scanner_type == SCANNER_PROG)
+        run_scanner_prog(fd, cur_pos, statbuf->st_size);
+    else
+        run_builtin_scanner(wf, cur_pos, statbuf->st_size);
+}
+
+static void add_file_watch(struct watched_file *wf)
+{
+    if (wf->wd >= 0)
+        return;
+
+    wf->wd = inotify_add_watch(inotify_fd, wf->filename, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+    if (wf->wd < 0)
+        perror_msg("inotify_add_watch failed on '%s'", wf->filename);
+    else
+        log_info("Added inotify watch for '%s'", wf->filename);
+}
+
+static void add_dir_watch(struct watched_file *wf)
+{
+    if (wf->dir_wd >= 0)
+        return;
+
+    char *dirname = g_path_get_dirname(wf->filename);
+    wf->dir_wd = inotify_add_watch(inotify_fd, dirname, IN_CREATE | IN_MOVED_TO);
+    if (wf->dir_wd < 0)
+        log_notice("Can't watch directory '%s': %s", dirname, strerror(errno));
+    free(dirname);
+}
+
+static void scan_file(struct watched_file *wf)
+{
+    struct stat statbuf;
+
+    /* If file is already opened, scan it from current pos */
+    if (wf->fd >= 0)
     {
-        xmove_fd(fd, STDIN_FILENO);
-        log_debug("Execing '%s'", prog[0]);
-        execvp(prog[0], prog);
-        perror_msg_and_die("Can't execute '%s'", prog[0]);
+        memset(&statbuf, 0, sizeof(statbuf));
+        if (fstat(wf->fd, &statbuf) != 0)
+            goto close_fd;
+        run_scanner(wf, &statbuf);
+
+        /* Was file deleted or replaced? */
+        ino_t fd_ino = statbuf.st_ino;
+        if (stat(wf->filename, &statbuf) != 0 || statbuf.st_ino != fd_ino) /* yes */
+        {
+            log_info("Inode# changed, closing fd");
+ close_fd:
+            finish_xorg_scan(wf);
+            close(wf->fd);
+            if (wf->wd >= 0)
+                inotify_rm_watch(inotify_fd, wf->wd);
+            wf->fd = -1;
+            wf->wd = -1;
+        }
     }
 
-    safe_waitpid(pid, NULL, 0);
+    /* If file isn't opened, try to open it and scan */
+    if (wf->fd < 0)
+    {
+        wf->fd = open(wf->filename, O_RDONLY);
+        if (wf->fd >= 0)
+        {
+            close_on_exec_on(wf->fd);
+            log_info("Opened '%s'", wf->filename);
+            add_file_watch(wf);
+            if (fstat(wf->fd, &statbuf) == 0)
+            {
+                /* If file is large, skip the beginning.
+                 * IOW: ignore old log messages because they are unlikely
+                 * to have sufficiently recent data to be useful.
+                 */
+                if (statbuf.st_size > (MAX_SCAN_BLOCK - READ_AHEAD))
+                    lseek(wf->fd, statbuf.st_size - (MAX_SCAN_BLOCK - READ_AHEAD), SEEK_SET);
+                /* Note that statbuf is filled by fstat by now,
+                 * run_scanner needs that
+                 */
+                run_scanner(wf, &statbuf);
+            }
+        }
+    }
+}
 
-    /* Check fd's position, and move to end if it wasn't advanced.
-     * This means that child failed to read its stdin.
-     * This is not supposed to happen, so warn about it.
+static gboolean debounce_cb(gpointer user_data)
+{
+    struct watched_file *wf = user_data;
+    wf->debounce_id = 0;
+
+    log_debug("Scanning '%s'", wf->filename);
+    scan_file(wf);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_scan(struct watched_file *wf)
+{
+    /* The changes are picked up by throttle_cb() */
+    if (wf->throttle_id != 0)
+        return;
+
+    const gint64 now_us = g_get_monotonic_time();
+    if (wf->debounce_id != 0)
+    {
+        /* The file is still being written to. Postpone the scan, but
+         * not forever.
+         */
+        if (now_us - wf->first_change_us >= MAX_DELAY_MS * 1000)
+            return;
+        g_source_remove(wf->debounce_id);
+    }
+    else
+        wf->first_change_us = now_us;
+
+    wf->debounce_id = g_timeout_add(DEBOUNCE_MS, debounce_cb, wf);
+}
+
+static gboolean handle_inotify_cb(GIOChannel *gio, GIOCondition condition, gpointer user_data)
+{
+    /* We don't actually check what happened to file -
+     * the scan will handle all possibilities.
      */
-    if (lseek(fd, 0, SEEK_CUR) <= cur_pos)
+    char buf[sizeof(struct inotify_event) + PATH_MAX + 1]
+            __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(inotify_fd, buf, sizeof(buf));
+    if (len < 0)
+    {
+        if (errno != EINTR && errno != EAGAIN) /* I saw EINTR here on strace attach */
+            perror_msg("Error reading inotify fd");
+        return TRUE;
+    }
+
+    for (char *p = buf; p < buf + len; )
+    {
+        struct inotify_event *event = (struct inotify_event *)p;
+        p += sizeof(*event) + event->len;
+
+        for (GList *l = watched_files; l; l = l->next)
+        {
+            struct watched_file *wf = l->data;
+            if (event->wd == wf->wd)
+            {
+                if (event->mask & IN_IGNORED)
+                    wf->wd = -1;
+                log_debug("Change in '%s' detected", wf->filename);
+                schedule_scan(wf);
+            }
+            else if (event->wd == wf->dir_wd)
+            {
+                if (event->mask & IN_IGNORED)
+                    wf->dir_wd = -1;
+                else if (event->len != 0 && strcmp(event->name, wf->basename) == 0)
+                {
+                    log_debug("'%s' appeared", wf->filename);
+                    schedule_scan(wf);
+                }
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean retry_open_cb(gpointer user_data)
+{
+    for (GList *l = watched_files; l; l = l->next)
     {
-        log("Warning, '%s' did not process its input", prog[0]);
-        lseek(fd, statbuf->st_size, SEEK_SET);
+        struct watched_file *wf = l->data;
+        add_dir_watch(wf);
+        if (wf->fd < 0 && wf->debounce_id == 0 && wf->throttle_id == 0)
+            scan_file(wf);
     }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void add_watched_file(const char *filename)
+{
+    struct watched_file *wf = xzalloc(sizeof(*wf));
+    wf->filename = xstrdup(filename);
+    wf->basename = g_path_get_basename(filename);
+    wf->fd = -1;
+    wf->wd = -1;
+    wf->dir_wd = -1;
+
+    add_dir_watch(wf);
+    watched_files = g_list_append(watched_files, wf);
 }
 
 int main(int argc, char **argv)
@@ -135,23 +515,35 @@ int main(int argc, char **argv)
 
     page_size = sysconf(_SC_PAGE_SIZE);
 
-    GList *match_list = NULL;
+    GList *extra_files = NULL;
+    const char *scanner_name = NULL;
 
     /* Can't keep these strings/structs static: _() doesn't support that */
     const char *program_usage_string = _(
-        "& [-vs] [-F STR]... FILE PROG [ARGS]\n"
+        "& [-vs] [-F STR]... [-w FILE]... FILE PROG [ARGS]\n"
+        "or:\n"
+        "& [-vs] [-F STR]... [-w FILE]... -S oops|xorg FILE\n"
+        "\n"
+        "Watch log file FILE, run PROG when it grows or is replaced.\n"
         "\n"
-        "Watch log file FILE, run PROG when it grows or is replaced"
+        "With -S, the new part of the file is searched for kernel oopses or Xorg\n"
+        "crashes in process and a problem directory is created in DumpLocation\n"
+        "(see abrt.conf) for every problem found."
     );
     enum {
         OPT_v = 1 << 0,
         OPT_s = 1 << 1,
+        OPT_F = 1 << 2,
+        OPT_w = 1 << 3,
+        OPT_S = 1 << 4,
     };
     /* Keep enum above and order of options below in sync! */
     struct options program_options[] = {
         OPT__VERBOSE(&g_verbose),
         OPT_BOOL('s', NULL, NULL              , _("Log to syslog")),
         OPT_LIST('F', NULL, &match_list, "STR", _("Don't run PROG if STRs aren't found")),
+        OPT_LIST('w', NULL, &extra_files, "FILE", _("Watch FILE as well")),
+        OPT_STRING('S', NULL, &scanner_name, "oops|xorg", _("Use built-in scanner instead of PROG")),
         OPT_END()
     };
     unsigned opts = parse_opts(argc, argv, program_options, program_usage_string);
@@ -165,9 +557,24 @@ int main(int argc, char **argv)
     }
 
     argv += optind;
-    if (!argv[0] || !argv[1])
+    if (!argv[0] || (!(opts & OPT_S) && !argv[1]) || ((opts & OPT_S) && argv[1]))
         show_usage_and_die(program_usage_string, program_options);
 
+    if (opts & OPT_S)
+    {
+        if (strcmp(scanner_name, "oops") == 0)
+            scanner_type = SCANNER_OOPS;
+        else if (strcmp(scanner_name, "xorg") == 0)
+            scanner_type = SCANNER_XORG;
+        else
+            error_msg_and_die(_("Unknown scanner '%s'"), scanner_name);
+
+        load_abrt_conf();
+        dump_location = g_settings_dump_location;
+        g_settings_dump_location = NULL;
+        free_abrt_conf_data();
+    }
+
     /* We want to support -F "`echo foo; echo bar`" -
      * need to split strings by newline, and be careful about
      * possible last empty string: "foo\nbar\n" = "foo", "bar",
@@ -185,99 +592,39 @@ int main(int argc, char **argv)
     }
 
     const char *filename = *argv++;
+    scanner_prog = argv;
 
-    int inotify_fd = inotify_init();
+    inotify_fd = inotify_init1(IN_NONBLOCK);
     if (inotify_fd == -1)
         perror_msg_and_die("inotify_init failed");
     close_on_exec_on(inotify_fd);
 
-    struct stat statbuf;
-    int file_fd = -1;
-    int wd = -1;
+    add_watched_file(filename);
+    for (GList *l = extra_files; l; l = l->next)
+        add_watched_file((char *)l->data);
 
-    while (1)
-    {
-        /* If file is already opened, scan it from current pos */
-        if (file_fd >= 0)
-        {
-            memset(&statbuf, 0, sizeof(statbuf));
-            if (fstat(file_fd, &statbuf) != 0)
-                goto close_fd;
-            run_scanner_prog(file_fd, &statbuf, match_list, argv);
-
-            /* Was file deleted or replaced? */
-            ino_t fd_ino = statbuf.st_ino;
-            if (stat(filename, &statbuf) != 0 || statbuf.st_ino != fd_ino) /* yes */
-            {
-                log_info("Inode# changed, closing fd");
- close_fd:
-                close(file_fd);
-                if (wd >= 0)
-                    inotify_rm_watch(inotify_fd, wd);
-                file_fd = -1;
-                wd = -1;
-            }
-        }
+    for (GList *l = watched_files; l; l = l->next)
+        scan_file(l->data);
 
-        /* If file isn't opened, try to open it and scan */
-        if (file_fd < 0)
-        {
-            file_fd = open(filename, O_RDONLY);
-            if (file_fd >= 0)
-            {
-                log_info("Opened '%s'", filename);
-                /* For -w case, if we don't have inotify watch yet, open one */
-                if (wd < 0)
-                {
-                    wd = inotify_add_watch(inotify_fd, filename, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
-                    if (wd < 0)
-                        perror_msg("inotify_add_watch failed on '%s'", filename);
-                    else
-                        log_info("Added inotify watch for '%s'", filename);
-                }
-                if (fstat(file_fd, &statbuf) == 0)
-                {
-                    /* If file is large, skip the beginning.
-                     * IOW: ignore old log messages because they are unlikely
-                     * to have sufficiently recent data to be useful.
-                     */
-                    if (statbuf.st_size > (MAX_SCAN_BLOCK - READ_AHEAD))
-                        lseek(file_fd, statbuf.st_size - (MAX_SCAN_BLOCK - READ_AHEAD), SEEK_SET);
-                    /* Note that statbuf is filled by fstat by now,
-                     * run_scanner_prog needs that
-                     */
-                    run_scanner_prog(file_fd, &statbuf, match_list, argv);
-                }
-            }
-        }
+    GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
 
-        /* Even if log file grows all the time, say, a new line every 5 ms,
-         * we don't want to scan it all the time. Sleep a bit and let it grow
-         * in bigger increments.
-         * Sleep longer if file does not exist.
-         */
-        sleep(file_fd >= 0 ? 1 : 59);
+    GIOChannel *channel = g_io_channel_unix_new(inotify_fd);
+    g_io_channel_set_encoding(channel, NULL, NULL);
+    g_io_add_watch(channel, G_IO_IN | G_IO_PRI, handle_inotify_cb, NULL);
 
-        /* Now wait for it to change, be moved or deleted */
-        if (wd >= 0)
-        {
-            char buf[4096];
-            log_debug("Waiting for '%s' to change", filename);
-            /* We block here: */
-            int len = read(inotify_fd, buf, sizeof(buf));
-            if (len < 0 && errno != EINTR) /* I saw EINTR here on strace attach */
-                perror_msg("Error reading inotify fd");
-            /* we don't actually check what happened to file -
-             * the code will handle all possibilities.
-             */
-            log_debug("Change in '%s' detected", filename);
-            /* Let them finish writing to the log file. otherwise
-             * we may end up trying to analyze partial oops.
-             */
-            sleep(1);
-        }
+    g_timeout_add_seconds(RETRY_OPEN_SEC, retry_open_cb, NULL);
+
+    g_unix_signal_add(SIGTERM, (GSourceFunc)g_main_loop_quit, main_loop);
+    g_unix_signal_add(SIGINT, (GSourceFunc)g_main_loop_quit, main_loop);
+
+    g_main_loop_run(main_loop);
+
+    /* Report the backtraces whose end we haven't seen yet */
+    for (GList *l = watched_files; l; l = l->next)
+        finish_xorg_scan(l->data);
 
-    } /* while (1) */
+    g_main_loop_unref(main_loop);
+    g_io_channel_unref(channel);
 
     return 0;
 }
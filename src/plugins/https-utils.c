@@ -173,8 +173,46 @@ static char *ssl_get_password(PK11SlotInfo *slot, PRBool retry, void *arg)
     return NULL;
 }
 
+/* abrt-retrace-local speaks plain HTTP; the socket permissions are the
+ * only protection the local connection needs.
+ */
+static void local_connect(struct https_cfg *cfg, PRFileDesc **tcp_sock, PRFileDesc **ssl_sock)
+{
+    PRNetAddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.local.family = PR_AF_LOCAL;
+    if (strlen(cfg->url) >= sizeof(addr.local.path))
+        error_msg_and_die(_("Socket path '%s' is too long."), cfg->url);
+    strcpy(addr.local.path, cfg->url);
+
+    *tcp_sock = PR_OpenTCPSocket(PR_AF_LOCAL);
+    if (!*tcp_sock)
+        error_msg_and_die(_("Can't create a socket. NSS error %d."), PR_GetError());
+
+    PRSocketOptionData sock_option;
+    sock_option.option = PR_SockOpt_Nonblocking;
+    sock_option.value.non_blocking = PR_FALSE;
+    if (PR_SUCCESS != PR_SetSocketOption(*tcp_sock, &sock_option))
+        error_msg_and_die(_("Failed to set socket blocking mode."));
+
+    if (PR_SUCCESS != PR_Connect(*tcp_sock, &addr, PR_INTERVAL_NO_TIMEOUT))
+    {
+        alert_connection_error(cfg->url);
+        error_msg_and_die(_("Can't connect to '%s'"), cfg->url);
+    }
+
+    *ssl_sock = *tcp_sock;
+}
+
 void ssl_connect(struct https_cfg *cfg, PRFileDesc **tcp_sock, PRFileDesc **ssl_sock)
 {
+    /* An absolute path is the Unix socket of a local retrace server */
+    if (cfg->url[0] == '/')
+    {
+        local_connect(cfg, tcp_sock, ssl_sock);
+        return;
+    }
+
     PRAddrInfo *addrinfo = PR_GetAddrInfoByName(cfg->url, PR_AF_UNSPEC, PR_AI_ADDRCONFIG);
     if (!addrinfo)
     {
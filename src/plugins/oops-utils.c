@@ -22,6 +22,7 @@ int abrt_oops_process_list(GList *oops_list, const char *dump_location, const ch
     unsigned errors = 0;
 
     int oops_cnt = g_list_length(oops_list);
+    unsigned unreported_cnt = oops_cnt > ABRT_OOPS_MAX_DUMPED_COUNT ? oops_cnt - ABRT_OOPS_MAX_DUMPED_COUNT : 0;
     if (oops_cnt != 0)
     {
         log("Found oopses: %d", oops_cnt);
@@ -42,7 +43,7 @@ int abrt_oops_process_list(GList *oops_list, const char *dump_location, const ch
         if (dump_location != NULL)
         {
             log("Creating problem directories");
-            errors = abrt_oops_create_dump_dirs(oops_list, dump_location, analyzer, flags);
+            errors = abrt_oops_create_dump_dirs(oops_list, dump_location, analyzer, flags, &unreported_cnt);
             if (errors)
                 log("%d errors while dumping oopses", errors);
             /*
@@ -61,8 +62,8 @@ int abrt_oops_process_list(GList *oops_list, const char *dump_location, const ch
     /* If we are run by a log watcher, this delays log rescan
      * (because log watcher waits to us to terminate)
      * and possibly prevents dreaded "abrt storm".
+     * Repeats of known oopses are cheap and don't count.
      */
-    int unreported_cnt = oops_cnt - ABRT_OOPS_MAX_DUMPED_COUNT;
     if (g_abrt_oops_sleep_woke_up_on_signal <= 0 &&
             (unreported_cnt > 0 && (flags & ABRT_OOPS_THROTTLE_CREATION)))
     {
@@ -77,36 +78,149 @@ int abrt_oops_process_list(GList *oops_list, const char *dump_location, const ch
     return errors;
 }
 
+/* Returns true if the oops is a repeat of a problem in the dump location,
+ * in which case its count and last occurrence are updated instead of
+ * creating a new problem directory which post-create would delete.
+ */
+static bool abrt_oops_fold_into_existing(const char *dump_location, const char *hash_str, time_t t)
+{
+    /* abrt-action-analyze-oops saves the hash as UUID, kernel oopses have
+     * neither uid nor executable */
+    GList *candidates = NULL;
+    if (dup_index_find_uuid(dump_location, NULL, "Kerneloops", NULL, hash_str, &candidates) != 0)
+        return false;
+
+    bool folded = false;
+    for (GList *iter = candidates; iter && !folded; iter = g_list_next(iter))
+    {
+        const char *dir_name = iter->data;
+
+        int sv_logmode = logmode;
+        /* Silently ignore any error in the silent log level. */
+        logmode = g_verbose == 0 ? 0 : sv_logmode;
+        /* Don't wait for post-create or a reporter, the oops gets its own
+         * directory and post-create finds the duplicate later. */
+        struct dump_dir *dd = dd_opendir(dir_name, /*flags:*/ DD_FAIL_QUIETLY_ENOENT | DD_DONT_WAIT_FOR_LOCK);
+        logmode = sv_logmode;
+        if (!dd)
+            continue;
+
+        const int load_flags = DD_FAIL_QUIETLY_ENOENT | DD_LOAD_TEXT_RETURN_NULL_ON_FAILURE;
+        char *type = dd_load_text_ext(dd, FILENAME_TYPE, load_flags);
+        char *uuid = dd_load_text_ext(dd, FILENAME_UUID, load_flags);
+        /* The problems without count are still being processed */
+        char *count_str = dd_load_text_ext(dd, FILENAME_COUNT, load_flags);
+
+        if (type && strcmp(type, "Kerneloops") == 0
+         && uuid && strcmp(uuid, hash_str) == 0
+         && count_str)
+        {
+            char new_count_str[sizeof(long)*3 + 2];
+            sprintf(new_count_str, "%lu", strtoul(count_str, NULL, 10) + 1);
+            dd_save_text(dd, FILENAME_COUNT, new_count_str);
+
+            char last_ocr[sizeof(long)*3 + 2];
+            sprintf(last_ocr, "%lu", (long)t);
+            dd_save_text(dd, FILENAME_LAST_OCCURRENCE, last_ocr);
+
+            log_notice("Oops is a repeat of '%s', count %s", dir_name, new_count_str);
+            folded = true;
+        }
+
+        free(count_str);
+        free(uuid);
+        free(type);
+        dd_close(dd);
+    }
+
+    g_list_free_full(candidates, free);
+    return folded;
+}
+
 /* returns number of errors */
-unsigned abrt_oops_create_dump_dirs(GList *oops_list, const char *dump_location, const char *analyzer, int flags)
+unsigned abrt_oops_create_dump_dirs(GList *oops_list, const char *dump_location, const char *analyzer, int flags,
+        unsigned *unreported_cnt)
 {
     const int oops_cnt = g_list_length(oops_list);
     unsigned countdown = ABRT_OOPS_MAX_DUMPED_COUNT; /* do not report hundreds of oopses */
 
-    log_notice("Saving %u oopses as problem dirs", oops_cnt >= countdown ? countdown : oops_cnt);
-
-    char *cmdline_str = xmalloc_fopen_fgetline_fclose("/proc/cmdline");
-    char *fips_enabled = xmalloc_fopen_fgetline_fclose("/proc/sys/crypto/fips_enabled");
-    char *proc_modules = xmalloc_open_read_close("/proc/modules", /*maxsize:*/ NULL);
-    char *suspend_stats = xmalloc_open_read_close("/sys/kernel/debug/suspend_stats", /*maxsize:*/ NULL);
+    char *cmdline_str = NULL;
+    char *fips_enabled = NULL;
+    char *proc_modules = NULL;
+    char *suspend_stats = NULL;
+    bool system_data_read = false;
 
     time_t t = time(NULL);
     const char *iso_date = iso_date_string(&t);
 
+    /* Hashes of the oopses handled in this run; post-create would delete
+     * the repeats as duplicates of the first one anyway */
+    GHashTable *hashes = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+
     pid_t my_pid = getpid();
     unsigned idx = 0;
     unsigned errors = 0;
+    unsigned saved = 0;
+    unsigned repeats = 0;
+    *unreported_cnt = 0;
     while (idx < oops_cnt)
     {
+        char *oops = (char*)g_list_nth_data(oops_list, idx++);
+
+        /* The first line is the kernel version, the backtrace follows, see
+         * abrt_oops_save_data_in_dump_dir() */
+        const char *backtrace = strchr(oops, '\n');
+        if (!backtrace)
+        {
+            error_msg("Oops %u has no backtrace, not saving it", idx);
+            errors++;
+            continue;
+        }
+
+        /* The same hash as abrt-action-analyze-oops computes of the backtrace */
+        char hash_str[SHA1_RESULT_LEN*2 + 1];
+        if (koops_hash_str(hash_str, backtrace + 1) == 0)
+        {
+            if (g_hash_table_contains(hashes, hash_str))
+            {
+                log_notice("Oops %u is a repeat of an earlier one", idx);
+                ++repeats;
+                continue;
+            }
+            g_hash_table_add(hashes, xstrdup(hash_str));
+
+            if (abrt_oops_fold_into_existing(dump_location, hash_str, t))
+            {
+                ++repeats;
+                continue;
+            }
+        }
+
+        if (countdown == 0)
+        {
+            ++*unreported_cnt;
+            continue;
+        }
+
+        /* Read only when needed, storms consist of repeats */
+        if (!system_data_read)
+        {
+            cmdline_str = xmalloc_fopen_fgetline_fclose("/proc/cmdline");
+            fips_enabled = xmalloc_fopen_fgetline_fclose("/proc/sys/crypto/fips_enabled");
+            proc_modules = xmalloc_open_read_close("/proc/modules", /*maxsize:*/ NULL);
+            suspend_stats = xmalloc_open_read_close("/sys/kernel/debug/suspend_stats", /*maxsize:*/ NULL);
+            system_data_read = true;
+        }
+
         char base[sizeof("oops-YYYY-MM-DD-hh:mm:ss-%lu-%lu") + 2 * sizeof(long)*3];
-        sprintf(base, "oops-%s-%lu-%lu", iso_date, (long)my_pid, (long)idx);
+        sprintf(base, "oops-%s-%lu-%lu", iso_date, (long)my_pid, (long)idx - 1);
         char *path = concat_path_file(dump_location, base);
 
         struct dump_dir *dd = dd_create(path, /*fs owner*/0, DEFAULT_DUMP_DIR_MODE);
         if (dd)
         {
             dd_create_basic_files(dd, /*no uid*/(uid_t)-1L, NULL);
-            abrt_oops_save_data_in_dump_dir(dd, (char*)g_list_nth_data(oops_list, idx++), proc_modules);
+            abrt_oops_save_data_in_dump_dir(dd, oops, proc_modules);
             dd_save_text(dd, FILENAME_ABRT_VERSION, VERSION);
             dd_save_text(dd, FILENAME_ANALYZER, "abrt-oops");
             dd_save_text(dd, FILENAME_TYPE, "Kerneloops");
@@ -122,20 +236,23 @@ unsigned abrt_oops_create_dump_dirs(GList *oops_list, const char *dump_location,
                 dd_set_no_owner(dd);
             dd_close(dd);
             notify_new_path(path);
+            ++saved;
         }
         else
             errors++;
 
         free(path);
 
-        if (--countdown == 0)
-            break;
+        --countdown;
 
         if (dd && (flags & ABRT_OOPS_THROTTLE_CREATION))
             if (abrt_oops_signaled_sleep(1) > 0)
                 break;
     }
 
+    log_notice("Saved %u oopses as problem dirs, %u were repeats", saved, repeats);
+
+    g_hash_table_destroy(hashes);
     free(cmdline_str);
     free(proc_modules);
     free(fips_enabled);
@@ -143,7 +143,7 @@ char *xorg_get_next_line_from_fd(void *fd)
 }
 
 
-/* Called after "Backtrace:" line was read.
+/* The lines following "Backtrace:" line.
  * Example (yes, stray newline before 'B' is real):
 [ 86985.879]<space>
 [ 60244.259] (EE) Backtrace:
@@ -165,91 +165,255 @@ char *xorg_get_next_line_from_fd(void *fd)
 [ 60244.273] (EE) Segmentation fault at address 0x7f61d93f6160
 [ 60244.273] (EE) 
  */
+struct xorg_bt_state
+{
+    GList *list;
+    unsigned cnt;
+    char *reason;
+    char *exe;
+};
+
+static void xorg_bt_state_clear(struct xorg_bt_state *state)
+{
+    list_free_with_free(state->list);
+    free(state->reason);
+    free(state->exe);
+    memset(state, 0, sizeof(*state));
+}
+
+/* Returns the crash info built from the lines added to state and resets the
+ * state, or NULL if no backtrace line was added.
+ */
+static struct xorg_crash_info *xorg_bt_state_finish(struct xorg_bt_state *state)
+{
+    struct xorg_crash_info *crash_info = NULL;
+    if (state->list)
+    {
+        crash_info = xmalloc(sizeof(struct xorg_crash_info));
+
+        crash_info->backtrace = list2lines(g_list_reverse(state->list)); /* frees list */
+        crash_info->reason = (state->reason ? state->reason : xstrdup(DEFAULT_XORG_CRASH_REASON));
+        crash_info->exe = state->exe;
+        memset(state, 0, sizeof(*state));
+    }
+    else
+        xorg_bt_state_clear(state);
+
+    return crash_info;
+}
+
+/* Adds one line following "Backtrace:" to state.
+ * Returns true if the line ended the backtrace (the line is consumed).
+ */
+static bool xorg_bt_state_add_line(struct xorg_bt_state *state, char *line)
+{
+    char *p = skip_pfx(line);
+
+    /* ignore empty lines
+     * [ 60244.273] (EE) 13: ? (?+0x29) [0x29]
+     * [ 60244.273] (EE) <---
+     * [ 60244.273] (EE) Segmentation fault at address 0x7f61d93f6160
+     */
+    if (*p == '\0')
+        return false;
+
+    /* xorg-server-1.12.0/os/osinit.c:
+     * if (sip->si_code == SI_USER) {
+     *     ErrorF("Recieved signal %d sent by process %ld, uid %ld\n",
+     *             ^^^^^^^^ yes, typo here! Can't grep for this word! :(
+     *            signo, (long) sip->si_pid, (long) sip->si_uid);
+     * } else {
+     *     switch (signo) {
+     *         case SIGSEGV:
+     *         case SIGBUS:
+     *         case SIGILL:
+     *         case SIGFPE:
+     *             ErrorF("%s at address %p\n", strsignal(signo), sip->si_addr);
+     */
+    if (*p < '0' || *p > '9')
+    {
+        if (strstr(p, " at address ") || strstr(p, " sent by process "))
+            state->reason = xstrdup(p);
+        /* Here you can place other cases of useful reason string */
+        return true;
+    }
+
+    errno = 0;
+    char *end;
+    IGNORE_RESULT(strtoul(p, &end, 10));
+    if (errno || end == p || *end != ':')
+        return true;
+
+    /* This looks like bt line */
+
+    /* Guess Xorg server's executable name from it */
+    if (!state->exe)
+    {
+        char *filename = skip_whitespace(end + 1);
+        char *filename_end = skip_non_whitespace(filename);
+        char sv = *filename_end;
+        *filename_end = '\0';
+        /* Does it look like "[/usr]/[s]bin/Xfoo"? */
+        if (strstr(filename, "bin/X"))
+            state->exe = xstrdup(filename);
+        *filename_end = sv;
+    }
+
+    /* Save it to list */
+    state->list = g_list_prepend(state->list, xstrdup(p));
+    /* prevent ridiculously large bts */
+    return ++state->cnt > 255;
+}
+
+/* Called after "Backtrace:" line was read. */
 struct xorg_crash_info *process_xorg_bt(char *(*get_next_line)(void *), void *data)
 {
-    char *reason = NULL;
-    char *exe = NULL;
-    GList *list = NULL;
-    unsigned cnt = 0;
+    struct xorg_bt_state state = { 0 };
     char *line = NULL;
     while ((line = get_next_line(data)) != NULL)
     {
-        char *p = skip_pfx(line);
-
-        /* ignore empty lines
-         * [ 60244.273] (EE) 13: ? (?+0x29) [0x29]
-         * [ 60244.273] (EE) <---
-         * [ 60244.273] (EE) Segmentation fault at address 0x7f61d93f6160
-         */
-        if (*p == '\0')
-            continue;
-
-        /* xorg-server-1.12.0/os/osinit.c:
-         * if (sip->si_code == SI_USER) {
-         *     ErrorF("Recieved signal %d sent by process %ld, uid %ld\n",
-         *             ^^^^^^^^ yes, typo here! Can't grep for this word! :(
-         *            signo, (long) sip->si_pid, (long) sip->si_uid);
-         * } else {
-         *     switch (signo) {
-         *         case SIGSEGV:
-         *         case SIGBUS:
-         *         case SIGILL:
-         *         case SIGFPE:
-         *             ErrorF("%s at address %p\n", strsignal(signo), sip->si_addr);
-         */
-        if (*p < '0' || *p > '9')
-        {
-            if (strstr(p, " at address ") || strstr(p, " sent by process "))
-            {
-                overlapping_strcpy(line, p);
-                reason = line;
-                line = NULL;
-            }
-            /* Here you can place other cases of useful reason string */
+        const bool done = xorg_bt_state_add_line(&state, line);
+        free(line);
+        if (done)
             break;
-        }
+    }
 
-        errno = 0;
-        char *end;
-        IGNORE_RESULT(strtoul(p, &end, 10));
-        if (errno || end == p || *end != ':')
-            break;
+    return xorg_bt_state_finish(&state);
+}
+
+/*
+ * Streaming extractor
+ */
+struct xorg_crash_extractor
+{
+    /* NULL while searching for "Backtrace:" line */
+    struct xorg_bt_state *bt;
+    /* The incomplete last line of the data fed so far, truncated to
+     * XORG_MAX_LINE_LEN bytes
+     */
+    char *line;
+    size_t line_len;
+    size_t line_alloc;
+    /* The length of the incomplete line before truncation */
+    size_t pending;
+    /* Bytes of the complete lines fed so far */
+    unsigned long long consumed;
+    /* Offset of the "Backtrace:" line of the pending backtrace */
+    unsigned long long bt_offset;
+};
+
+struct xorg_crash_extractor *xorg_crash_extractor_new(void)
+{
+    return xzalloc(sizeof(struct xorg_crash_extractor));
+}
 
-        /* This looks like bt line */
+void xorg_crash_extractor_free(struct xorg_crash_extractor *extractor)
+{
+    if (extractor == NULL)
+        return;
 
-        /* Guess Xorg server's executable name from it */
-        if (!exe)
-        {
-            char *filename = skip_whitespace(end + 1);
-            char *filename_end = skip_non_whitespace(filename);
-            char sv = *filename_end;
-            *filename_end = '\0';
-            /* Does it look like "[/usr]/[s]bin/Xfoo"? */
-            if (strstr(filename, "bin/X"))
-                exe = xstrdup(filename);
-            *filename_end = sv;
-        }
+    if (extractor->bt)
+    {
+        xorg_bt_state_clear(extractor->bt);
+        free(extractor->bt);
+    }
+    free(extractor->line);
+    free(extractor);
+}
 
-        /* Save it to list */
-        overlapping_strcpy(line, p);
-        list = g_list_prepend(list, line);
-        line = NULL;
-        if (++cnt > 255) /* prevent ridiculously large bts */
-            break;
+bool xorg_crash_extractor_in_backtrace(struct xorg_crash_extractor *extractor)
+{
+    return extractor->bt != NULL;
+}
+
+unsigned long long xorg_crash_extractor_resume_offset(struct xorg_crash_extractor *extractor)
+{
+    return extractor->bt ? extractor->bt_offset : extractor->consumed;
+}
+
+static void xorg_crash_extractor_emit(struct xorg_crash_extractor *extractor,
+        xorg_crash_extractor_callback callback, void *data)
+{
+    struct xorg_crash_info *crash_info = xorg_bt_state_finish(extractor->bt);
+    free(extractor->bt);
+    extractor->bt = NULL;
+
+    callback(crash_info, data);
+}
+
+void xorg_crash_extractor_feed_line(struct xorg_crash_extractor *extractor, char *line,
+        xorg_crash_extractor_callback callback, void *data)
+{
+    if (extractor->bt == NULL)
+    {
+        if (strcmp(skip_pfx(line), XORG_SEARCH_STRING) == 0)
+            extractor->bt = xzalloc(sizeof(*extractor->bt));
+        return;
     }
-    free(line);
 
-    if (list)
+    if (xorg_bt_state_add_line(extractor->bt, line))
+        xorg_crash_extractor_emit(extractor, callback, data);
+}
+
+static void xorg_crash_extractor_feed_buffered_line(struct xorg_crash_extractor *extractor,
+        size_t len, xorg_crash_extractor_callback callback, void *data)
+{
+    const unsigned long long offset = extractor->consumed;
+    extractor->consumed += len;
+
+    extractor->line[extractor->line_len] = '\0';
+    extractor->line_len = 0;
+
+    const bool searching = (extractor->bt == NULL);
+    xorg_crash_extractor_feed_line(extractor, extractor->line, callback, data);
+    if (searching && extractor->bt)
+        extractor->bt_offset = offset;
+}
+
+void xorg_crash_extractor_feed(struct xorg_crash_extractor *extractor,
+        const char *buf, size_t len,
+        xorg_crash_extractor_callback callback, void *data)
+{
+    while (len > 0)
     {
-        struct xorg_crash_info *crash_info = xmalloc(sizeof(struct xorg_crash_info));
+        const char *eol = memchr(buf, '\n', len);
+        const size_t seg_len = eol ? (size_t)(eol - buf) : len;
 
-        list = g_list_reverse(list);
-        crash_info->backtrace = list2lines(list); /* frees list */
-        crash_info->reason = (reason ? reason : xstrdup(DEFAULT_XORG_CRASH_REASON));
-        crash_info->exe = exe;
+        /* Lines are truncated to keep memory usage constant, the length of
+         * the whole line still counts to the consumed bytes.
+         */
+        const size_t keep = MIN(seg_len, XORG_MAX_LINE_LEN - extractor->line_len);
+        if (extractor->line_len + keep + 1 > extractor->line_alloc)
+        {
+            extractor->line_alloc = MIN(XORG_MAX_LINE_LEN + 1,
+                                        MAX(extractor->line_alloc * 2, extractor->line_len + keep + 1));
+            extractor->line = xrealloc(extractor->line, extractor->line_alloc);
+        }
+        memcpy(extractor->line + extractor->line_len, buf, keep);
+        extractor->line_len += keep;
+        extractor->pending += seg_len;
+
+        if (!eol)
+            return;
+
+        xorg_crash_extractor_feed_buffered_line(extractor, extractor->pending + 1, callback, data);
+        extractor->pending = 0;
 
-        return crash_info;
+        buf = eol + 1;
+        len -= seg_len + 1;
+    }
+}
+
+void xorg_crash_extractor_finish(struct xorg_crash_extractor *extractor,
+        xorg_crash_extractor_callback callback, void *data)
+{
+    /* The last line without the trailing '\n' */
+    if (extractor->pending > 0)
+    {
+        xorg_crash_extractor_feed_buffered_line(extractor, extractor->pending, callback, data);
+        extractor->pending = 0;
     }
-    return NULL;
 
+    if (extractor->bt)
+        xorg_crash_extractor_emit(extractor, callback, data);
 }
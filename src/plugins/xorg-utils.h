@@ -29,6 +29,9 @@ extern "C" {
 
 #define XORG_SEARCH_STRING "Backtrace:"
 
+/* Longer log lines are truncated by the streaming extractor */
+#define XORG_MAX_LINE_LEN (4 * 1024)
+
 enum {
     ABRT_XORG_THROTTLE_CREATION = 1 << 0,
     ABRT_XORG_WORLD_READABLE    = 1 << 1,
@@ -93,6 +96,64 @@ char *xorg_get_next_line_from_fd(void *fd);
  */
 struct xorg_crash_info *process_xorg_bt(char *(*get_next_line)(void *), void *data);
 
+/*
+ * Streaming Xorg crash extractor
+ *
+ * The extractor is fed arbitrary chunks of a log (or whole log lines) and
+ * reports every found crash through a callback. A backtrace split between
+ * chunks is remembered until its last line arrives, so logs of any size can
+ * be processed in constant memory.
+ */
+struct xorg_crash_extractor;
+
+/*
+ * Called for every found crash
+ *
+ * @param crash_info extracted xorg crash information owned by the callee or
+ *                   NULL if the lines following "Backtrace:" are not a backtrace
+ * @param data user data passed to the feeding function
+ */
+typedef void (*xorg_crash_extractor_callback)(struct xorg_crash_info *crash_info, void *data);
+
+struct xorg_crash_extractor *xorg_crash_extractor_new(void);
+
+void xorg_crash_extractor_free(struct xorg_crash_extractor *extractor);
+
+/*
+ * Feeds a chunk of log data, lines may span several chunks
+ */
+void xorg_crash_extractor_feed(struct xorg_crash_extractor *extractor,
+                               const char *buf, size_t len,
+                               xorg_crash_extractor_callback callback, void *data);
+
+/*
+ * Feeds one complete log line without trailing \n
+ *
+ * @param line is not stored but may be modified
+ */
+void xorg_crash_extractor_feed_line(struct xorg_crash_extractor *extractor, char *line,
+                                    xorg_crash_extractor_callback callback, void *data);
+
+/*
+ * Processes the incomplete last line and reports the pending backtrace
+ * (end of the log)
+ */
+void xorg_crash_extractor_finish(struct xorg_crash_extractor *extractor,
+                                 xorg_crash_extractor_callback callback, void *data);
+
+/*
+ * @returns true if the lines of a backtrace are expected
+ */
+bool xorg_crash_extractor_in_backtrace(struct xorg_crash_extractor *extractor);
+
+/*
+ * Returns the offset in the data passed to xorg_crash_extractor_feed() from
+ * which a new extractor must be fed to get into the current state, i.e. the
+ * offset of the pending "Backtrace:" line or the end of the last complete
+ * line.
+ */
+unsigned long long xorg_crash_extractor_resume_offset(struct xorg_crash_extractor *extractor);
+
 /*
  * Saves Xorg crash details in the dump directory
  *
@@ -0,0 +1,8 @@
+import problem
+
+# load time and pid of all problems in a single request
+for prob in problem.list(prefetch=['time', 'pid']):
+    print(prob)
+    print(repr(prob.time))
+    if hasattr(prob, 'pid'):
+        print(prob.pid)
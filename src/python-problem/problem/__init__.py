@@ -108,8 +108,8 @@ class Problem(object):
         if attr in self._data:
             val = self._data[attr]
 
-        # try to fetch the item
-        if self._persisted:
+        # try to fetch the item unless it was prefetched
+        elif self._persisted:
             val = self._proxy.get_item(self._probdir, attr)
             self._data[attr] = val
 
@@ -176,11 +176,25 @@ class Problem(object):
         if not self._persisted:
             return
 
-        for field in PREFETCH_FIELDS:
-            try:
-                self.__getattr__(field)
-            except AttributeError:
-                pass
+        fields = [f for f in PREFETCH_FIELDS if f not in self._data]
+        data = _get_items(self._proxy, [self._probdir], fields)
+        if data is None:
+            for field in fields:
+                try:
+                    self.__getattr__(field)
+                except AttributeError:
+                    pass
+            return
+
+        self._prefill(data.get(self._probdir, {}), fields)
+
+    def _prefill(self, data, fields=None):
+        # Store values loaded in bulk; elements not present in
+        # ``data`` but listed in ``fields`` are known not to exist
+        # and are cached as such to avoid another round trip.
+        for field in (fields or data.keys()):
+            if field not in self._data and field not in self._dirty_data:
+                self._data[field] = data.get(field)
 
     @property
     def path(self):
@@ -340,7 +354,19 @@ class Unknown(Problem):
         super(Unknown, self).__init__('libreport', reason)
 
 
-def list(auth=False, __proxy=proxies.get_proxy()):
+def _get_items(proxy, probdirs, fields):
+    # Return ``None`` if the proxy can't load elements in bulk
+    get_items = getattr(proxy, 'get_items', None)
+    if get_items is None:
+        return None
+
+    try:
+        return get_items(probdirs, fields)
+    except NotImplementedError:
+        return None
+
+
+def list(auth=False, __proxy=proxies.get_proxy(), prefetch=None):
     ''' Return the list of the problems
 
     Use ``auth=True`` if authentication should be attempted.
@@ -348,12 +374,66 @@ def list(auth=False, __proxy=proxies.get_proxy()):
     If authentication via polkit fails, function behaves
     as if ``auth=False`` was specified (only users problems are
     returned).
+
+    ``prefetch`` is a list of element names (e.g. ``['time',
+    'component']``) which are loaded for all problems at once
+    instead of one request per problem and attribute.
     '''
     fun = __proxy.list
     if auth:
         fun = __proxy.list_all
 
-    return [tools.problemify(prob, __proxy) for prob in fun()]
+    probdirs = [prob for prob in fun()]
+    if prefetch is None:
+        return [tools.problemify(prob, __proxy) for prob in probdirs]
+
+    fields = ['type', 'reason'] + [f for f in prefetch
+                                   if f not in ('type', 'reason')]
+    data = _get_items(__proxy, probdirs, fields)
+    if data is None:
+        return [tools.problemify(prob, __proxy) for prob in probdirs]
+
+    result = []
+    for prob in probdirs:
+        if prob not in data:
+            # not loaded in bulk (e.g. locked at the time), load it
+            # the same way as without prefetch
+            result.append(tools.problemify(prob, __proxy))
+            continue
+
+        obj = tools.problemify(prob, __proxy, data[prob])
+        obj._prefill(data[prob], fields)
+        result.append(obj)
+
+    return result
+
+
+def prefetch(problems, fields):
+    ''' Load ``fields`` of all ``problems`` at once
+
+    Useful before accessing the same attribute of many problems
+    returned by ``list`` (e.g. when sorting them), the attributes
+    are otherwise loaded one by one on first access.
+
+    '''
+    by_proxy = dict()
+    for prob in problems:
+        if not prob._persisted:
+            continue
+
+        if all(f in prob._data for f in fields):
+            continue
+
+        by_proxy.setdefault(prob._proxy, []).append(prob)
+
+    for proxy, probs in by_proxy.items():
+        data = _get_items(proxy, [p._probdir for p in probs], fields)
+        if data is None:
+            continue
+
+        for prob in probs:
+            if prob._probdir in data:
+                prob._prefill(data[prob._probdir], fields)
 
 
 def get(identifier, auth=False, __proxy=proxies.get_proxy()):
@@ -22,3 +22,4 @@
 PyObject *p_notify_new_path(PyObject *pself, PyObject *args);
 PyObject *p_load_conf_file(PyObject *pself, PyObject *args);
 PyObject *p_load_plugin_conf_file(PyObject *pself, PyObject *args);
+PyObject *p_load_problems_data(PyObject *pself, PyObject *args);
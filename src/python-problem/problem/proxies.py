@@ -72,6 +72,26 @@ class DBusProxy(object):
 
         return str(val[name])
 
+    def get_items(self, dump_dirs, names):
+        try:
+            val = self._dbus_call('GetInfoForProblems', dump_dirs, names)
+        except self.dbus.exceptions.DBusException as e:
+            if e.get_dbus_name() != 'org.freedesktop.DBus.Error.UnknownMethod':
+                raise
+
+            # older daemon, fall back to one call per problem
+            logging.debug('GetInfoForProblems not supported: {0}'.format(e))
+            val = dict()
+            for dump_dir in dump_dirs:
+                try:
+                    val[dump_dir] = self._dbus_call('GetInfo', dump_dir, names)
+                except problem.exception.InvalidProblem:
+                    pass
+
+        return dict((str(dump_dir), dict((str(k), str(v))
+                                         for k, v in items.items()))
+                    for dump_dir, items in val.items())
+
     def set_item(self, dump_dir, name, value):
         return self._dbus_call('SetElement', dump_dir, name, str(value))
 
@@ -120,6 +140,9 @@ class SocketProxy(object):
     def get_item(self, *args):
         raise NotImplementedError
 
+    def get_items(self, *args):
+        raise NotImplementedError
+
     def set_item(self, *args):
         raise NotImplementedError
 
@@ -178,6 +201,9 @@ class FsProxy(object):
         ddir.close()
         return val
 
+    def get_items(self, dump_dirs, names):
+        return problem.load_problems_data(dump_dirs, names)
+
     def set_item(self, dump_dir, name, value):
         ddir = self._open_ddir(dump_dir)
         ddir.save_text(name, str(value))
@@ -91,3 +91,144 @@ PyObject *p_load_plugin_conf_file(PyObject *pself, PyObject *args)
     }
     return load_settings_to_dict(file, load_abrt_plugin_conf_file);
 }
+
+/* Returns a sequence of borrowed C strings pointing to the items of seq
+ * (a result of PySequence_Fast()) or NULL with a Python exception set.
+ */
+static const char **sequence_to_strv(PyObject *seq, Py_ssize_t *len)
+{
+    *len = PySequence_Fast_GET_SIZE(seq);
+    const char **strv = xmalloc(sizeof(strv[0]) * (*len + 1));
+    for (Py_ssize_t i = 0; i < *len; ++i)
+    {
+        if (!PyArg_Parse(PySequence_Fast_GET_ITEM(seq, i), "s", &strv[i]))
+        {
+            free(strv);
+            return NULL;
+        }
+    }
+    strv[*len] = NULL;
+    return strv;
+}
+
+static PyObject *string_from_element(const char *value)
+{
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_DecodeUTF8(value, strlen(value), "replace");
+#else
+    return PyString_FromString(value);
+#endif
+}
+
+/* Loads element_names of all problem_dirs and returns them as
+ * {problem_dir: {element_name: value}}. Problem directories which can't be
+ * opened and elements which don't exist are silently omitted, so a single
+ * broken problem doesn't fail the whole batch.
+ *
+ * Every directory is opened only once and the Python interpreter lock is
+ * released while reading the files.
+ */
+PyObject *p_load_problems_data(PyObject *pself, PyObject *args)
+{
+    PyObject *py_dirs;
+    PyObject *py_names;
+    if (!PyArg_ParseTuple(args, "OO", &py_dirs, &py_names))
+    {
+        return NULL;
+    }
+
+    PyObject *result = NULL;
+    const char **dirs = NULL;
+    const char **names = NULL;
+    char **values = NULL;
+    bool *opened = NULL;
+    Py_ssize_t dir_cnt = 0;
+    Py_ssize_t name_cnt = 0;
+
+    PyObject *dir_seq = PySequence_Fast(py_dirs, "problem directories must be a sequence");
+    PyObject *name_seq = PySequence_Fast(py_names, "element names must be a sequence");
+    if (dir_seq == NULL || name_seq == NULL)
+        goto lpd_cleanup;
+
+    dirs = sequence_to_strv(dir_seq, &dir_cnt);
+    if (dirs == NULL)
+        goto lpd_cleanup;
+
+    names = sequence_to_strv(name_seq, &name_cnt);
+    if (names == NULL)
+        goto lpd_cleanup;
+
+    values = xzalloc(sizeof(values[0]) * (dir_cnt * name_cnt + 1));
+    opened = xzalloc(sizeof(opened[0]) * (dir_cnt + 1));
+
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t d = 0; d < dir_cnt; ++d)
+    {
+        struct dump_dir *dd = dd_opendir(dirs[d], DD_OPEN_READONLY
+                | DD_FAIL_QUIETLY_EACCES | DD_FAIL_QUIETLY_ENOENT);
+        if (!dd)
+            continue;
+
+        opened[d] = true;
+        for (Py_ssize_t n = 0; n < name_cnt; ++n)
+            values[d * name_cnt + n] = dd_load_text_ext(dd, names[n],
+                    DD_FAIL_QUIETLY_ENOENT | DD_FAIL_QUIETLY_EACCES
+                    | DD_LOAD_TEXT_RETURN_NULL_ON_FAILURE);
+
+        dd_close(dd);
+    }
+    Py_END_ALLOW_THREADS
+
+    result = PyDict_New();
+    if (result == NULL)
+        goto lpd_cleanup;
+
+    for (Py_ssize_t d = 0; d < dir_cnt; ++d)
+    {
+        if (!opened[d])
+            continue;
+
+        PyObject *elements = PyDict_New();
+        if (elements == NULL
+            || PyDict_SetItem(result, PySequence_Fast_GET_ITEM(dir_seq, d), elements) != 0)
+        {
+            Py_XDECREF(elements);
+            goto lpd_error;
+        }
+        Py_DECREF(elements);
+
+        for (Py_ssize_t n = 0; n < name_cnt; ++n)
+        {
+            const char *value = values[d * name_cnt + n];
+            if (value == NULL)
+                continue;
+
+            PyObject *py_value = string_from_element(value);
+            if (py_value == NULL
+                || PyDict_SetItem(elements, PySequence_Fast_GET_ITEM(name_seq, n), py_value) != 0)
+            {
+                Py_XDECREF(py_value);
+                goto lpd_error;
+            }
+            Py_DECREF(py_value);
+        }
+    }
+    goto lpd_cleanup;
+
+lpd_error:
+    Py_CLEAR(result);
+
+lpd_cleanup:
+    if (values != NULL)
+    {
+        for (Py_ssize_t i = 0; i < dir_cnt * name_cnt; ++i)
+            free(values[i]);
+        free(values);
+    }
+    free(opened);
+    free(names);
+    free(dirs);
+    Py_XDECREF(name_seq);
+    Py_XDECREF(dir_seq);
+    return result;
+}
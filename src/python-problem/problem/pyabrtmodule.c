@@ -44,6 +44,8 @@ static PyMethodDef module_methods[] = {
     { "notify_new_path"           , p_notify_new_path         , METH_VARARGS },
     { "load_conf_file"            , p_load_conf_file          , METH_VARARGS },
     { "load_plugin_conf_file"     , p_load_plugin_conf_file   , METH_VARARGS },
+    /* for include/dump_dir.h */
+    { "load_problems_data"        , p_load_problems_data      , METH_VARARGS },
     { NULL }
 };
 
@@ -1,12 +1,16 @@
 import problem
 
 
-def problemify(probdir, proxy):
+def problemify(probdir, proxy, data=None):
     by_typ = dict(zip(problem.PROBLEM_TYPES.values(),
                       problem.PROBLEM_TYPES.keys()))
 
-    typ = proxy.get_item(probdir, 'type')
-    reason = proxy.get_item(probdir, 'reason')
+    if data is None:
+        typ = proxy.get_item(probdir, 'type')
+        reason = proxy.get_item(probdir, 'reason')
+    else:
+        typ = data.get('type')
+        reason = data.get('reason')
 
     if typ not in by_typ:
         class_name = 'Unknown'
@@ -18,4 +22,7 @@ def problemify(probdir, proxy):
     prob._persisted = True
     prob._proxy = proxy
 
+    if data is not None:
+        prob._prefill(data)
+
     return prob
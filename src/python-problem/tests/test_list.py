@@ -36,6 +36,48 @@ class ListTestCase(ProblematicTestCase):
 
         prob.delete()
 
+    def test_list_prefetch(self):
+        prob = self.create_problem()
+        prob.add_current_process_data()
+        ident = prob.save()
+
+        calls = self.proxy.bulk_calls
+        probs = problem.list(False, self.proxy, prefetch=['pid', 'component'])
+        tools.eq_(self.proxy.bulk_calls, calls + 1)
+
+        listed = [p for p in probs if p._probdir == ident][0]
+        tools.eq_(listed.reason, 'Front fell off')
+        tools.ok_('pid' in listed._data)
+
+        # prefetched elements must not be fetched again
+        self.proxy.get_item = None
+        tools.eq_(listed.pid, os.getpid())
+        tools.ok_(not hasattr(listed, 'component'))
+        del self.proxy.get_item
+
+        prob.delete()
+
+    def test_list_prefetch_missing(self):
+        prob = self.create_problem()
+        prob.add_current_process_data()
+        ident = prob.save()
+
+        # the bulk reply may lack a problem, it is loaded one by one
+        get_items = self.proxy.get_items
+        self.proxy.get_items = lambda dump_dirs, names: dict(
+            (k, v) for k, v in get_items(dump_dirs, names).items()
+            if k != ident)
+
+        probs = problem.list(False, self.proxy, prefetch=['pid'])
+        del self.proxy.get_items
+
+        listed = [p for p in probs if p._probdir == ident]
+        tools.eq_(len(listed), 1)
+        tools.eq_(listed[0].reason, 'Front fell off')
+        tools.eq_(listed[0].pid, os.getpid())
+
+        prob.delete()
+
 if __name__ == '__main__':
     logging.basicConfig(level=logging.DEBUG)
     unittest.main()
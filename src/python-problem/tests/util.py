@@ -4,6 +4,7 @@ import problem
 
 class FakeProxy(object):
     data = dict()
+    bulk_calls = 0
 
     def get_item(self, dump_dir, name):
         if dump_dir not in self.data:
@@ -14,6 +15,13 @@ class FakeProxy(object):
         except KeyError:
             return None
 
+    def get_items(self, dump_dirs, names):
+        self.bulk_calls += 1
+        return dict((dump_dir, dict((name, self.data[dump_dir][name])
+                                    for name in names
+                                    if name in self.data[dump_dir]))
+                    for dump_dir in dump_dirs if dump_dir in self.data)
+
     def set_item(self, dump_dir, name, value):
         self.data[dump_dir][name] = value
 
@@ -0,0 +1,135 @@
+#!/bin/bash
+# vim: dict+=/usr/share/beakerlib/dictionary.vim cpt=.,w,b,u,t,i,k
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   runtest.sh of abrt-action-install-debuginfo-concurrent
+#   Description: Concurrent installations into one cache download every debuginfo once
+#   Author: ABRT team
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   Copyright (c) 2017 Red Hat, Inc.
+#
+#   This copyrighted material is made available to anyone wishing
+#   to use, modify, copy, or redistribute it subject to the terms
+#   and conditions of the GNU General Public License version 2.
+#
+#   This program is distributed in the hope that it will be
+#   useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+#   PURPOSE. See the GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public
+#   License along with this program; if not, write to the Free
+#   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#   Boston, MA 02110-1301, USA.
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+# Include Beaker environment
+. /usr/share/beakerlib/beakerlib.sh || exit 1
+. ../aux/lib.sh || exit 1
+
+TEST="abrt-action-install-debuginfo-concurrent"
+
+PACKAGES=${PACKAGES:-"abrt createrepo_c rpm-build"}
+
+INSTANCES=6
+MIRROR_PORT=8642
+BUILD_ID_DIR="ab"
+BUILD_ID_FILE="cdef0123456789abcdef0123456789abcdef01"
+BUILD_ID="$BUILD_ID_DIR$BUILD_ID_FILE"
+DEBUGINFO="usr/lib/debug/.build-id/$BUILD_ID_DIR/$BUILD_ID_FILE.debug"
+PACKAGE_RPM="abrt-test-debuginfo-1-1.noarch.rpm"
+
+rlJournalStart
+    rlPhaseStartSetup
+        rlAssertRpm --all
+
+        rlRun "TmpDir=\$(mktemp -d)" 0 "Creating tmp directory"
+        rlRun "pushd $TmpDir"
+
+cat > abrt-test-debuginfo.spec <<SPEC
+%global debug_package %{nil}
+%global __os_install_post %{nil}
+Name: abrt-test-debuginfo
+Version: 1
+Release: 1
+Summary: Fake debuginfo for abrt tests
+License: GPLv2+
+BuildArch: noarch
+
+%description
+Fake debuginfo for abrt tests
+
+%install
+mkdir -p %{buildroot}/usr/lib/debug/.build-id/$BUILD_ID_DIR
+echo "abrt test" > %{buildroot}/$DEBUGINFO
+
+%files
+/$DEBUGINFO
+SPEC
+        rlRun "rpmbuild --define '_topdir $TmpDir/rpmbuild' -bb abrt-test-debuginfo.spec" 0 "Build fake debuginfo package"
+        rlRun "mkdir mirror && cp rpmbuild/RPMS/noarch/$PACKAGE_RPM mirror/"
+        rlRun "createrepo_c mirror" 0 "Create the mirror"
+
+        # The local mirror stand-in logs every request it serves
+        python3 -m http.server $MIRROR_PORT --bind 127.0.0.1 --directory mirror > mirror.log 2>&1 &
+        MIRROR_PID=$!
+        sleep 2
+
+cat > /etc/yum.repos.d/abrt-test-debuginfo.repo <<REPO
+[abrt-test-debuginfo]
+name=abrt-test-debuginfo
+baseurl=http://127.0.0.1:$MIRROR_PORT/
+enabled=0
+gpgcheck=0
+metadata_expire=0
+REPO
+
+        rlRun "echo $BUILD_ID > build_ids"
+        rlRun "mkdir cache"
+    rlPhaseEnd
+
+    rlPhaseStartTest "Concurrent installations download the package once"
+        PIDS=""
+        for i in $(seq $INSTANCES); do
+            abrt-action-install-debuginfo -y --ids=build_ids --cache=$TmpDir/cache \
+                --tmpdir=$TmpDir/tmp$i --repo=abrt-test-debuginfo > install$i.log 2>&1 &
+            PIDS="$PIDS $!"
+        done
+
+        FAILED=0
+        for pid in $PIDS; do
+            wait $pid || FAILED=$((FAILED+1))
+        done
+        rlAssertEquals "All instances succeeded" "_$FAILED" "_0"
+
+        for i in $(seq $INSTANCES); do
+            rlAssertGrep "All debuginfo files are available" install$i.log
+        done
+        rlAssertExists "cache/$DEBUGINFO"
+        rlAssertEquals "The debuginfo is in the build-id index" \
+            "$(readlink cache/.build-id-index/.build-id/$BUILD_ID_DIR/$BUILD_ID_FILE.debug)" "$TmpDir/cache/$DEBUGINFO"
+
+        cat mirror.log
+        rlAssertEquals "The mirror served the package once" \
+            "_$(grep -c "GET /$PACKAGE_RPM" mirror.log)" "_1"
+    rlPhaseEnd
+
+    rlPhaseStartTest "Used debuginfos are marked as recently used"
+        rlRun "touch -d '2001-01-01' cache/$DEBUGINFO"
+        rlRun "abrt-action-install-debuginfo -y --ids=build_ids --cache=$TmpDir/cache --tmpdir=$TmpDir/tmp --repo=abrt-test-debuginfo"
+        rlAssertGreater "The debuginfo was touched" $(stat -c %Y cache/$DEBUGINFO) $(date -d '2001-01-02' +%s)
+        rlAssertEquals "Nothing was downloaded" \
+            "_$(grep -c "GET /$PACKAGE_RPM" mirror.log)" "_1"
+    rlPhaseEnd
+
+    rlPhaseStartCleanup
+        kill $MIRROR_PID
+        rlRun "rm -f /etc/yum.repos.d/abrt-test-debuginfo.repo"
+        rlRun "popd"
+        rlRun "rm -r $TmpDir" 0 "Removing tmp directory"
+    rlPhaseEnd
+rlJournalPrintText
+rlJournalEnd
@@ -0,0 +1,141 @@
+#!/bin/bash
+# vim: dict+=/usr/share/beakerlib/dictionary.vim cpt=.,w,b,u,t,i,k
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   runtest.sh of abrt-retrace-local
+#   Description: abrt-retrace-client retraces crashes on the local retrace server
+#   Author: ABRT team
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   Copyright (c) 2017 Red Hat, Inc.
+#
+#   This copyrighted material is made available to anyone wishing
+#   to use, modify, copy, or redistribute it subject to the terms
+#   and conditions of the GNU General Public License version 2.
+#
+#   This program is distributed in the hope that it will be
+#   useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+#   PURPOSE. See the GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public
+#   License along with this program; if not, write to the Free
+#   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#   Boston, MA 02110-1301, USA.
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+# Include Beaker environment
+. /usr/share/beakerlib/beakerlib.sh || exit 1
+. ../aux/lib.sh || exit 1
+
+TEST="abrt-retrace-local"
+PACKAGE="abrt"
+
+INSTANCES=4
+WORKERS=2
+
+rlJournalStart
+    rlPhaseStartSetup
+        check_prior_crashes
+
+        rlRun "TmpDir=\$(mktemp -d)" 0 "Creating tmp directory"
+        rlRun "pushd $TmpDir"
+
+        # The server refuses to run as root
+        rlRun "chmod 0755 $TmpDir"
+        rlRun "mkdir run tasks && chown abrt-retrace:abrt-retrace run tasks"
+        rlRun "abrt-retrace-local -w $WORKERS -S $TmpDir/run/root.socket -t $TmpDir/tasks" 1
+
+        SOCKET=$TmpDir/run/retrace.socket
+        runuser -u abrt-retrace -- abrt-retrace-local -vvv -w $WORKERS -S $SOCKET -t $TmpDir/tasks > server.log 2>&1 &
+        SERVER_PID=$!
+        for I in `seq 100`; do
+            [ -S $SOCKET ] && break
+            sleep 0.1
+        done
+        rlAssertExists "$SOCKET"
+
+        prepare
+        generate_crash
+        wait_for_hooks
+        get_crash_path
+    rlPhaseEnd
+
+    rlPhaseStartTest "Concurrent retraces"
+        PIDS=""
+        for i in $(seq $INSTANCES); do
+            rlRun "cp -r $crash_PATH crash$i"
+            rlRun "rm -f crash$i/backtrace"
+            abrt-retrace-client batch --url $SOCKET --no-pkgcheck -l 1 -d crash$i > client$i.log 2>&1 &
+            PIDS="$PIDS $!"
+        done
+
+        FAILED=0
+        for pid in $PIDS; do
+            wait $pid || FAILED=$((FAILED+1))
+        done
+        rlAssertEquals "All clients succeeded" "_$FAILED" "_0"
+
+        for i in $(seq $INSTANCES); do
+            rlAssertExists "crash$i/backtrace"
+            rlAssertGrep "main" "crash$i/backtrace"
+        done
+
+        rlAssertEquals "All tasks finished" \
+            "_$(cat tasks/*/status | grep -c FINISHED_SUCCESS)" "_$INSTANCES"
+        rlAssertNotGrep "Running workers: $((WORKERS+1))" server.log
+    rlPhaseEnd
+
+    rlPhaseStartTest "Tasks require their passwords"
+        TASK_ID=$(ls tasks | head -n1)
+        rlRun "abrt-retrace-client status --url $SOCKET -t $TASK_ID -p wrongpassword" 1
+        rlRun "abrt-retrace-client status --url $SOCKET -t $TASK_ID -p $(cat tasks/$TASK_ID/password)" 0
+    rlPhaseEnd
+
+    rlPhaseStartTest "Only the members of the group may connect"
+        rlAssertEquals "The socket is not world accessible" "_$(stat -c %a $SOCKET)" "_660"
+        rlRun "runuser -u nobody -- abrt-retrace-client status --url $SOCKET -t $TASK_ID -p $(cat tasks/$TASK_ID/password)" 1-255
+    rlPhaseEnd
+
+    rlPhaseStartTest "The service installs debuginfos into its cache"
+        kill $SERVER_PID
+        SERVER_PID=
+
+        # The debuginfos must be downloaded by the server
+        rlRun "mkdir debug-backup"
+        rlRun "mv /usr/lib/debug/usr debug-backup/system" 0,1 "Make sure there are no system debuginfos"
+        rlRun "mv /var/cache/abrt-di/usr debug-backup/abrt-di" 0,1 "Make sure there are no debuginfos in ABRT cache"
+        rlRun "rm -rf /var/cache/abrt-retrace-di/* /var/spool/abrt-retrace/*"
+
+        rlServiceStart abrt-retrace-local
+        UNIT_SOCKET=/var/run/abrt-retrace/retrace.socket
+        for I in `seq 100`; do
+            [ -S $UNIT_SOCKET ] && break
+            sleep 0.1
+        done
+
+        rlRun "cp -r $crash_PATH crash-unit"
+        rlRun "rm -f crash-unit/backtrace"
+        rlRun "abrt-retrace-client batch --url $UNIT_SOCKET --no-pkgcheck -l 1 -d crash-unit > client-unit.log 2>&1"
+        rlAssertGrep "main" "crash-unit/backtrace"
+
+        rlAssertGreater "A debuginfo landed in the cache of the service" \
+            "$(find /var/cache/abrt-retrace-di -name '*.debug' | wc -l)" 0
+        rlRun "grep -l 'Continuing without debuginfos' /var/spool/abrt-retrace/*/retrace_log" 1 \
+            "The tasks did not run without debuginfos"
+
+        rlServiceRestore abrt-retrace-local
+        rlRun "mv debug-backup/system /usr/lib/debug/usr" 0,1
+        rlRun "mv debug-backup/abrt-di /var/cache/abrt-di/usr" 0,1
+    rlPhaseEnd
+
+    rlPhaseStartCleanup
+        [ -n "$SERVER_PID" ] && kill $SERVER_PID
+        rlRun "abrt-cli rm $crash_PATH" 0 "Remove crash directory"
+        rlRun "popd"
+        rlRun "rm -r $TmpDir" 0 "Removing tmp directory"
+    rlPhaseEnd
+rlJournalPrintText
+rlJournalEnd
@@ -0,0 +1,106 @@
+#!/bin/bash
+# vim: dict=/usr/share/beakerlib/dictionary.vim cpt=.,w,b,u,t,i,k
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   runtest.sh of abrt-watch-log
+#   Description: Tests abrt-watch-log
+#   Author: ABRT team
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   Copyright (c) 2016 Red Hat, Inc. All rights reserved.
+#
+#   This copyrighted material is made available to anyone wishing
+#   to use, modify, copy, or redistribute it subject to the terms
+#   and conditions of the GNU General Public License version 2.
+#
+#   This program is distributed in the hope that it will be
+#   useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+#   PURPOSE. See the GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public
+#   License along with this program; if not, write to the Free
+#   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#   Boston, MA 02110-1301, USA.
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+. /usr/share/beakerlib/beakerlib.sh
+. ../aux/lib.sh
+
+TEST="abrt-watch-log"
+PACKAGE="abrt"
+EXAMPLES_PATH="../../../examples"
+
+# wait_for_file FILE PATTERN - waits at most 2s for PATTERN to appear in FILE
+function wait_for_file() {
+    local c=0
+    while ! grep -q "$2" "$1" 2>/dev/null; do
+        sleep 0.1
+        let c=$c+1
+        if [ $c -gt 20 ]; then
+            return 1
+        fi
+    done
+    return 0
+}
+
+rlJournalStart
+    rlPhaseStartSetup
+        check_prior_crashes
+
+        TmpDir=$(mktemp -d)
+        cp $EXAMPLES_PATH/oops1.test $TmpDir
+        rlRun "pushd $TmpDir"
+    rlPhaseEnd
+
+    rlPhaseStartTest "PROG for several files"
+        touch first.log second.log
+
+        abrt-watch-log -F MATCH -w second.log first.log sh -c 'cat >> scanned.log' &
+        WATCH_PID=$!
+        sleep 1
+
+        echo "first MATCH" >> first.log
+        rlRun "wait_for_file scanned.log 'first MATCH'" 0 "Change of the first file scanned"
+
+        echo "second MATCH" >> second.log
+        rlRun "wait_for_file scanned.log 'second MATCH'" 0 "Change of the second file scanned"
+
+        echo "ignored" >> second.log
+        sleep 1
+        rlAssertNotGrep "ignored" scanned.log
+
+        echo "created MATCH" > first.log.new
+        mv first.log.new first.log
+        rlRun "wait_for_file scanned.log 'created MATCH'" 0 "Replaced file scanned"
+
+        kill $WATCH_PID
+    rlPhaseEnd
+
+    rlPhaseStartTest "built-in oops scanner"
+        prepare
+        touch messages
+
+        abrt-watch-log -S oops messages &
+        WATCH_PID=$!
+        sleep 1
+
+        cat oops1.test >> messages
+        wait_for_hooks
+        get_crash_path
+
+        rlAssertGrep "Kerneloops" "$crash_PATH/type"
+        rlAssertGrep "abrt-oops" "$crash_PATH/analyzer"
+
+        kill $WATCH_PID
+        rlRun "abrt-cli rm $crash_PATH" 0 "Remove crash directory"
+    rlPhaseEnd
+
+    rlPhaseStartCleanup
+        rlRun "popd"
+        rlRun "rm -r $TmpDir" 0 "Removing tmp directory"
+    rlPhaseEnd
+    rlJournalPrintText
+rlJournalEnd
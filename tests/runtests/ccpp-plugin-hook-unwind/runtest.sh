@@ -64,6 +64,11 @@ rlJournalStart
 
         rlRun "./verify_core_backtrace.py $crash_PATH/core_backtrace" 0 "All frames must have required members"
 
+        rlAssertExists "$crash_PATH/hook_timing"
+        for phase in setup unwind core total; do
+            rlAssertGrep "^$phase [0-9]\+$" "$crash_PATH/hook_timing"
+        done
+
         rlRun "abrt-cli rm $crash_PATH" 0 "Remove crash directory"
     rlPhaseEnd
 
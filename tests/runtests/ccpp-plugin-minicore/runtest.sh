@@ -0,0 +1,87 @@
+#!/bin/bash
+# vim: dict=/usr/share/beakerlib/dictionary.vim cpt=.,w,b,u,t,i,k
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   runtest.sh of ccpp-plugin-minicore
+#   Description: Tests ccpp-plugin's mini coredumps
+#   Author: ABRT team
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   Copyright (c) 2016 Red Hat, Inc. All rights reserved.
+#
+#   This copyrighted material is made available to anyone wishing
+#   to use, modify, copy, or redistribute it subject to the terms
+#   and conditions of the GNU General Public License version 2.
+#
+#   This program is distributed in the hope that it will be
+#   useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+#   PURPOSE. See the GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public
+#   License along with this program; if not, write to the Free
+#   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+#   Boston, MA 02110-1301, USA.
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+. /usr/share/beakerlib/beakerlib.sh
+. ../aux/lib.sh
+
+TEST="ccpp-plugin-minicore"
+PACKAGE="abrt"
+
+CFG_FILE="/etc/abrt/plugins/CCpp.conf"
+
+rlJournalStart
+    rlPhaseStartSetup
+        check_prior_crashes
+
+        old_ulimit=$(ulimit -c)
+        rlRun "ulimit -c unlimited" 0
+
+        TmpDir=$(mktemp -d)
+        pushd $TmpDir
+
+        rlFileBackup $CFG_FILE
+    rlPhaseEnd
+
+    rlPhaseStartTest "SaveMiniCore enabled"
+        rlRun "echo 'SaveMiniCore = yes' > $CFG_FILE" 0 "Set SaveMiniCore = yes"
+        rlRun "echo 'MakeCompatCore = yes' >> $CFG_FILE" 0 "Set MakeCompatCore = yes"
+
+        prepare
+        generate_crash
+        wait_for_hooks
+        get_crash_path
+
+        rlAssertExists "$crash_PATH/coredump"
+        user_core=$(ls core* | head -n1)
+        rlAssertExists "$user_core"
+
+        rlAssertEquals "Mini core has the size of the full core" \
+            "_$(stat -c %s $crash_PATH/coredump)" "_$(stat -c %s $user_core)"
+        rlAssertGreater "Mini core occupies less disk space than the full core" \
+            $(du -k $user_core | cut -f1) $(du -k $crash_PATH/coredump | cut -f1)
+
+        rlRun "gdb -batch -ex bt $(which will_segfault) $crash_PATH/coredump > gdb.log 2>&1"
+        rlAssertGrep "main" gdb.log
+
+        rlRun "abrt-action-generate-backtrace -d $crash_PATH" 0 "Generate backtrace from mini core"
+        rlAssertExists "$crash_PATH/backtrace"
+
+        rlRun "abrt-cli rm $crash_PATH" 0 "Remove crash directory"
+        rm -f core*
+    rlPhaseEnd
+
+    rlPhaseStartCleanup
+        rlFileRestore # CFG_FILE
+
+        rlRun "ulimit -c $old_ulimit" 0
+
+        popd # TmpDir
+        rm -rf $TmpDir
+    rlPhaseEnd
+    rlJournalPrintText
+rlJournalEnd
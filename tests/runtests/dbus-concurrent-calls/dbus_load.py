@@ -0,0 +1,163 @@
+#!/usr/bin/python3
+"""
+Mixed D-Bus load against org.freedesktop.problems
+
+Creates a synthetic spool of problems with large elements and runs several
+kinds of clients in parallel processes:
+ - scanners calling GetAllProblems and GetProblemData
+ - readers calling GetInfo and TestElementExists
+ - writers calling SetElement on the same few problems
+ - a reporter calling NewProblem and measuring its latency
+
+Exits with non-zero status if a call fails, if an element written
+concurrently ends up with a value no writer has written or if NewProblem
+takes longer than the allowed latency.
+"""
+
+import sys
+import time
+import random
+import argparse
+import multiprocessing
+
+import dbus
+
+BUS_NAME = 'org.freedesktop.problems'
+OBJECT_PATH = '/org/freedesktop/problems'
+
+
+def get_iface():
+    bus = dbus.SystemBus(private=True)
+    proxy = bus.get_object(BUS_NAME, OBJECT_PATH)
+    return dbus.Interface(proxy, BUS_NAME)
+
+
+def new_problem(iface, tag, size=0):
+    data = {
+        'analyzer': 'libreport',
+        'type': 'libreport',
+        'reason': 'dbus-concurrent-calls ' + tag,
+        'executable': '/usr/bin/true',
+        'uuid': '{0}-{1}'.format(tag, time.time()),
+    }
+    if size:
+        data['backtrace'] = ('x' * 79 + '\n') * (size // 80)
+
+    return str(iface.NewProblem(data, timeout=120))
+
+
+def scanner(problems, deadline, result):
+    iface = get_iface()
+    calls = 0
+    while time.time() < deadline:
+        iface.GetAllProblems(timeout=120)
+        iface.GetProblemData(random.choice(problems), timeout=120)
+        calls += 2
+    result.put(('scanner', calls, []))
+
+
+def reader(problems, deadline, result):
+    iface = get_iface()
+    calls = 0
+    while time.time() < deadline:
+        problem = random.choice(problems)
+        iface.GetInfo(problem, ['reason', 'uuid'], timeout=120)
+        iface.TestElementExists(problem, 'backtrace', timeout=120)
+        calls += 2
+    result.put(('reader', calls, []))
+
+
+def writer(wid, problems, deadline, result):
+    iface = get_iface()
+    calls = 0
+    while time.time() < deadline:
+        problem = problems[calls % len(problems)]
+        iface.SetElement(problem, 'load_test', 'writer-{0}-{1}'.format(wid, calls), timeout=120)
+        calls += 1
+    result.put(('writer', calls, []))
+
+
+def reporter(deadline, result):
+    iface = get_iface()
+    latencies = []
+    created = []
+    while time.time() < deadline:
+        start = time.time()
+        created.append(new_problem(iface, 'reporter'))
+        latencies.append(time.time() - start)
+        time.sleep(0.5)
+
+    iface.DeleteProblem(created, timeout=120)
+    result.put(('reporter', len(latencies), latencies))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--problems', type=int, default=100)
+    parser.add_argument('--element-size', type=int, default=1024 * 1024)
+    parser.add_argument('--duration', type=int, default=30)
+    parser.add_argument('--scanners', type=int, default=4)
+    parser.add_argument('--readers', type=int, default=8)
+    parser.add_argument('--writers', type=int, default=4)
+    parser.add_argument('--max-latency', type=float, default=5.0)
+    args = parser.parse_args()
+
+    iface = get_iface()
+    print('Creating {0} problems'.format(args.problems))
+    problems = [new_problem(iface, 'spool-{0}'.format(i), args.element_size)
+                for i in range(args.problems)]
+    contended = problems[:3]
+
+    deadline = time.time() + args.duration
+    result = multiprocessing.Queue()
+    procs = [multiprocessing.Process(target=scanner, args=(problems, deadline, result))
+             for _ in range(args.scanners)]
+    procs += [multiprocessing.Process(target=reader, args=(problems, deadline, result))
+              for _ in range(args.readers)]
+    procs += [multiprocessing.Process(target=writer, args=(i, contended, deadline, result))
+              for i in range(args.writers)]
+    procs.append(multiprocessing.Process(target=reporter, args=(deadline, result)))
+
+    for proc in procs:
+        proc.start()
+
+    failed = False
+    for proc in procs:
+        proc.join()
+        if proc.exitcode != 0:
+            print('Client {0} failed'.format(proc.name))
+            failed = True
+
+    stats = {}
+    latencies = []
+    while not result.empty():
+        kind, calls, lat = result.get()
+        stats[kind] = stats.get(kind, 0) + calls
+        latencies += lat
+
+    for kind, calls in sorted(stats.items()):
+        print('{0}: {1} calls ({2:.1f}/s)'.format(kind, calls, calls / float(args.duration)))
+
+    if latencies:
+        print('NewProblem latency: avg {0:.3f}s max {1:.3f}s'.format(
+              sum(latencies) / len(latencies), max(latencies)))
+        if max(latencies) > args.max_latency:
+            print('NewProblem took longer than {0}s'.format(args.max_latency))
+            failed = True
+    else:
+        print('No NewProblem call finished')
+        failed = True
+
+    for problem in contended:
+        value = iface.GetInfo(problem, ['load_test'])['load_test']
+        if not value.startswith('writer-'):
+            print("Unexpected value of 'load_test' in {0}: {1}".format(problem, value))
+            failed = True
+
+    iface.DeleteProblem(problems, timeout=120)
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
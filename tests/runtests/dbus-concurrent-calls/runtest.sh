@@ -0,0 +1,58 @@
+#!/bin/bash
+# vim: dict=/usr/share/beakerlib/dictionary.vim cpt=.,w,b,u,t,i,k
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   runtest.sh of dbus-concurrent-calls
+#   Description: Drives mixed D-Bus traffic against a synthetic spool and checks that slow calls don't block the others
+#   Author: ABRT team
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+#   Copyright (c) 2016 Red Hat, Inc. All rights reserved.
+#
+#   This program is free software: you can redistribute it and/or
+#   modify it under the terms of the GNU General Public License as
+#   published by the Free Software Foundation, either version 3 of
+#   the License, or (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be
+#   useful, but WITHOUT ANY WARRANTY; without even the implied
+#   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+#   PURPOSE.  See the GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program. If not, see http://www.gnu.org/licenses/.
+#
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+. /usr/share/beakerlib/beakerlib.sh
+. ../aux/lib.sh
+
+TEST="dbus-concurrent-calls"
+PACKAGE="abrt"
+
+rlJournalStart
+    rlPhaseStartSetup
+        check_prior_crashes
+
+        TmpDir=$(mktemp -d)
+        cp dbus_load.py $TmpDir
+        pushd $TmpDir
+    rlPhaseEnd
+
+    rlPhaseStartTest "Mixed traffic"
+        # 100 problems with 512KiB backtraces fit into the default MaxCrashReportsSize
+        rlRun "./dbus_load.py --problems 100 --element-size 524288 --duration 30 --max-latency 5 &> dbus_load.log" 0 "Mixed D-Bus traffic"
+        cat dbus_load.log
+
+        rlAssertGrep "NewProblem latency" dbus_load.log
+        rlAssertNotGrep "Unexpected value" dbus_load.log
+    rlPhaseEnd
+
+    rlPhaseStartCleanup
+        rlBundleLogs abrt *.log
+        popd # TmpDir
+        rm -rf $TmpDir
+    rlPhaseEnd
+    rlJournalPrintText
+rlJournalEnd
@@ -41,6 +41,10 @@ function confDBusSetProperty() {
     echo "import dbus; bus = dbus.SystemBus(); proxy = bus.get_object(\"com.redhat.problems.configuration\", \"/com/redhat/problems/configuration/$1\"); problems = dbus.Interface(proxy, dbus_interface=\"org.freedesktop.DBus.Properties\"); problems.Set(\"com.redhat.problems.configuration.$1\", \"$2\", $4)" | python
 }
 
+function confDBusSetProperties() {
+    echo "import dbus; bus = dbus.SystemBus(); proxy = bus.get_object(\"com.redhat.problems.configuration\", \"/com/redhat/problems/configuration/$1\"); conf = dbus.Interface(proxy, dbus_interface=\"com.redhat.problems.configuration\"); conf.SetProperties($2)" | python
+}
+
 function confDBusSetPropertyDefault() {
     dbus-send --system --type=method_call --print-reply \
               --dest=com.redhat.problems.configuration /com/redhat/problems/configuration/$1 com.redhat.problems.configuration.SetDefault \
@@ -364,6 +368,21 @@ rlJournalStart
         rlAssertEquals "Reset 'VerboseLog' value" "_$(confDBusGetProperty ccpp VerboseLog)" "_"
     rlPhaseEnd
 
+    rlPhaseStartTest "Set several properties at once"
+        rlRun "confDBusSetProperties abrt '{\"MaxCrashReportsSize\": dbus.Int32(4321), \"AutoreportingEvent\": \"report_Bugzilla\", \"ProcessUnpackaged\": dbus.Boolean(False)}'" 0
+        rlAssertEquals "Set 'MaxCrashReportsSize' value" "_$(confDBusGetProperty abrt MaxCrashReportsSize)" "_4321"
+        rlAssertEquals "Set 'AutoreportingEvent' value" "_$(confDBusGetProperty abrt AutoreportingEvent)" "_\"report_Bugzilla\""
+        rlAssertEquals "Set 'ProcessUnpackaged' value" "_$(confDBusGetProperty abrt ProcessUnpackaged)" "_false"
+
+        # nothing is written if one of the values has a wrong type
+        rlRun "confDBusSetProperties abrt '{\"MaxCrashReportsSize\": dbus.Int32(1234), \"AutoreportingEvent\": dbus.Int32(1)}'" 1
+        rlAssertEquals "Unchanged 'MaxCrashReportsSize' value" "_$(confDBusGetProperty abrt MaxCrashReportsSize)" "_4321"
+
+        rlRun "confDBusSetPropertyDefault abrt MaxCrashReportsSize" 0
+        rlRun "confDBusSetPropertyDefault abrt AutoreportingEvent" 0
+        rlRun "confDBusSetPropertyDefault abrt ProcessUnpackaged" 0
+    rlPhaseEnd
+
     rlPhaseStartTest "Read/Write Python configuration"
         rlAssertEquals "Get 'RequireAbsolutePath' value" "_$(confDBusGetProperty python RequireAbsolutePath)" "_"
         rlRun "confDBusSetProperty python RequireAbsolutePath boolean False" 0